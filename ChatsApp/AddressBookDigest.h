@@ -0,0 +1,70 @@
+//
+//  AddressBookDigest.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 11/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/** Persistent digest of the address book identifiers already uploaded.
+
+ Every phone number and email address is normalized and stored as a 64-bit hash in a sorted table,
+ so an address book of 10k contacts takes 80 KB. Comparing the current address book with the digest
+ gives the identifiers added since the last upload and the number of identifiers removed,
+ independent of the number of address book records.
+ */
+@interface AddressBookDigest : NSObject
+
+/** Number of identifiers in the digest. */
+@property(nonatomic, readonly) NSUInteger count;
+
+/** NO until the first digest has been committed. */
+@property(nonatomic, readonly) BOOL hasDigest;
+
+/** Initialize with the digest file, the file is read if it exists.
+
+ @param path - Path of the digest file
+ */
+-(id) initWithPath:(NSString *) path;
+
+/** Compare identifiers with the digest.
+
+ @param identifiers - Normalized identifiers of the current address book
+ @param removedCount - Number of digest entries not in identifiers on return, can be NULL
+ @return Identifiers not in the digest, without duplicates
+ */
+-(NSArray *) addedIdentifiers:(NSArray *) identifiers removedCount:(NSUInteger *) removedCount;
+
+/** YES if the identifier is in the digest. */
+-(BOOL) containsIdentifier:(NSString *) identifier;
+
+/** Replace the digest with the identifiers and write it to the file.
+
+ @param identifiers - Normalized identifiers which have been uploaded
+ @return YES on success
+ */
+-(BOOL) commitIdentifiers:(NSArray *) identifiers;
+
+/** Remove the digest, the next upload is a full upload. */
+-(void) reset;
+
+/** Normalize a phone number or email address.
+
+ Emails are trimmed and lowercased. Phone numbers are reduced to digits, a leading + or 00 is kept
+ as + for international numbers.
+
+ @param identifier - Phone number or email address
+ @return Normalized identifier or nil if it is not a valid identifier
+ */
++(NSString *) normalizedIdentifier:(NSString *) identifier;
+
+/** Hash of a normalized identifier as stored in the digest, the first 64 bits of its SHA-256.
+
+ @param identifier - Normalized identifier
+ @return The hash
+ */
++(uint64_t) hashOfIdentifier:(NSString *) identifier;
+
+@end
@@ -0,0 +1,185 @@
+//
+//  AddressBookDigest.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 11/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <CommonCrypto/CommonDigest.h>
+
+#import "AddressBookDigest.h"
+
+#define MIN_PHONE_DIGITS    5
+
+static uint64_t identifierHash(NSString *identifier)
+{
+    NSData *data = [identifier dataUsingEncoding:NSUTF8StringEncoding];
+    uint8_t digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256([data bytes], (CC_LONG) [data length], digest);
+
+    uint64_t hash = 0;
+    for (int i = 0; i < 8; i++) {
+        hash = (hash << 8) | digest[i];
+    }
+    return hash;
+}
+
+static int compareHash(const void *a, const void *b)
+{
+    uint64_t left = *(const uint64_t *) a, right = *(const uint64_t *) b;
+    return left < right ? -1 : (left > right ? 1 : 0);
+}
+
+@interface AddressBookDigest ()
+
+// Sorted uint64_t hashes
+@property(nonatomic, strong) NSData *hashes;
+@property(nonatomic, strong) NSString *path;
+@property(nonatomic, readwrite) BOOL hasDigest;
+
+@end
+
+@implementation AddressBookDigest
+
+-(id) initWithPath:(NSString *) path
+{
+    self = [super init];
+    if (self) {
+        self.path = path;
+        self.hashes = [NSData dataWithContentsOfFile:path];
+        self.hasDigest = self.hashes != nil && [self.hashes length] % sizeof(uint64_t) == 0;
+        if (!self.hasDigest)
+            self.hashes = [NSData data];
+    }
+    return self;
+}
+
+-(NSUInteger) count
+{
+    return [self.hashes length] / sizeof(uint64_t);
+}
+
+-(BOOL) containsHash:(uint64_t) hash
+{
+    return bsearch(&hash, [self.hashes bytes], self.count, sizeof(uint64_t), compareHash) != NULL;
+}
+
+-(BOOL) containsIdentifier:(NSString *) identifier
+{
+    return identifier && [self containsHash:identifierHash(identifier)];
+}
+
+-(NSData *) sortedHashesForIdentifiers:(NSArray *) identifiers
+{
+    NSMutableData *data = [NSMutableData dataWithLength:[identifiers count] * sizeof(uint64_t)];
+    uint64_t *hashes = [data mutableBytes];
+
+    NSUInteger count = 0;
+    for (NSString *identifier in identifiers) {
+        hashes[count++] = identifierHash(identifier);
+    }
+    qsort(hashes, count, sizeof(uint64_t), compareHash);
+
+    // Remove duplicates
+    NSUInteger unique = 0;
+    for (NSUInteger i = 0; i < count; i++) {
+        if (unique == 0 || hashes[unique - 1] != hashes[i])
+            hashes[unique++] = hashes[i];
+    }
+    [data setLength:unique * sizeof(uint64_t)];
+    return data;
+}
+
+-(NSArray *) addedIdentifiers:(NSArray *) identifiers removedCount:(NSUInteger *) removedCount
+{
+    NSMutableArray *added = [NSMutableArray array];
+    NSMutableSet *seen = [NSMutableSet setWithCapacity:[identifiers count]];
+
+    for (NSString *identifier in identifiers) {
+        if ([seen containsObject:identifier])
+            continue;
+
+        [seen addObject:identifier];
+        if (![self containsIdentifier:identifier])
+            [added addObject:identifier];
+    }
+
+    if (removedCount) {
+        // Both tables are sorted, count the old hashes missing in the new table
+        NSData *current = [self sortedHashesForIdentifiers:identifiers];
+        const uint64_t *oldHashes = [self.hashes bytes], *newHashes = [current bytes];
+        NSUInteger oldCount = self.count, newCount = [current length] / sizeof(uint64_t);
+        NSUInteger i = 0, j = 0, removed = 0;
+
+        while (i < oldCount) {
+            if (j >= newCount || oldHashes[i] < newHashes[j]) {
+                removed++;
+                i++;
+            } else if (oldHashes[i] == newHashes[j]) {
+                i++;
+                j++;
+            } else {
+                j++;
+            }
+        }
+        *removedCount = removed;
+    }
+    return added;
+}
+
+-(BOOL) commitIdentifiers:(NSArray *) identifiers
+{
+    NSData *hashes = [self sortedHashesForIdentifiers:identifiers];
+    if (self.path && ![hashes writeToFile:self.path atomically:YES])
+        return NO;
+
+    self.hashes = hashes;
+    self.hasDigest = YES;
+    return YES;
+}
+
+-(void) reset
+{
+    if (self.path)
+        [[NSFileManager defaultManager] removeItemAtPath:self.path error:nil];
+
+    self.hashes = [NSData data];
+    self.hasDigest = NO;
+}
+
++(uint64_t) hashOfIdentifier:(NSString *) identifier
+{
+    return identifierHash(identifier);
+}
+
++(NSString *) normalizedIdentifier:(NSString *) identifier
+{
+    NSString *trimmed = [identifier stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+    if ([trimmed length] == 0)
+        return nil;
+
+    NSRange at = [trimmed rangeOfString:@"@"];
+    if (at.location != NSNotFound)
+        return (at.location > 0 && NSMaxRange(at) < [trimmed length]) ? [trimmed lowercaseString] : nil;
+
+    NSMutableString *digits = [NSMutableString stringWithCapacity:[trimmed length]];
+    for (NSUInteger i = 0; i < [trimmed length]; i++) {
+        unichar c = [trimmed characterAtIndex:i];
+        if (c >= '0' && c <= '9')
+            [digits appendFormat:@"%C", c];
+    }
+
+    if ([digits length] < MIN_PHONE_DIGITS)
+        return nil;
+
+    if ([trimmed hasPrefix:@"+"])
+        return [@"+" stringByAppendingString:digits];
+
+    if ([digits hasPrefix:@"00"])
+        return [@"+" stringByAppendingString:[digits substringFromIndex:2]];
+
+    return digits;
+}
+
+@end
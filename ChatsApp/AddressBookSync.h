@@ -0,0 +1,48 @@
+//
+//  AddressBookSync.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 11/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class AddressBookDigest;
+
+/** Incremental friend discovery from the iOS address book.
+
+ [C2CallPhone transferAddressBook:] uploads the whole address book, hashed, whenever the number of
+ records has changed: also when contacts have only been removed, but not when a number has been
+ added to an existing contact. AddressBookSync keeps an AddressBookDigest of the uploaded identifiers
+ and lets the digest decide instead. The address book is transferred only when it contains identifiers
+ not in the digest, removals alone update the digest without a transfer.
+
+ Every upload goes through the hashed SDK transfer. The SDK cannot transfer only the added identifiers,
+ and [C2CallPhone findFriends:] would send them in plain text, so a sync with additions transfers the
+ whole address book.
+ */
+@interface AddressBookSync : NSObject
+
+/** Digest of the uploaded identifiers. */
+@property(nonatomic, readonly) AddressBookDigest *digest;
+
+/** Identifiers added to the address book since the sync before the last one. */
+@property(nonatomic, readonly) NSUInteger lastAddedCount;
+
+/** Address book transfers started by the syncs, including the first upload. */
+@property(nonatomic, readonly) NSUInteger transferCount;
+
+/** Digest entries no longer in the address book at the last sync. */
+@property(nonatomic, readonly) NSUInteger lastRemovedCount;
+
+/** Read the address book in the background and transfer it if identifiers have been added. Does nothing without address book access. */
+-(void) synchronize;
+
+/** Forget the digest, the next sync will transfer the whole address book. */
+-(void) reset;
+
+/** @return shared instance */
++(AddressBookSync *) instance;
+
+@end
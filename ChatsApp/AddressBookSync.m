@@ -0,0 +1,143 @@
+//
+//  AddressBookSync.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 11/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <AddressBook/AddressBook.h>
+#import <SocialCommunication/C2CallPhone.h>
+#import <SocialCommunication/debug.h>
+
+#import "AddressBookSync.h"
+#import "AddressBookDigest.h"
+
+#define DIGEST_FILE     @"AddressBookDigest.bin"
+
+@interface AddressBookSync ()
+
+@property(nonatomic, strong) dispatch_queue_t queue;
+@property(nonatomic, readwrite) AddressBookDigest *digest;
+@property(nonatomic, readwrite) NSUInteger lastAddedCount;
+@property(nonatomic, readwrite) NSUInteger transferCount;
+@property(nonatomic, readwrite) NSUInteger lastRemovedCount;
+
+@end
+
+@implementation AddressBookSync
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        NSString *directory = [NSSearchPathForDirectoriesInDomains(NSApplicationSupportDirectory, NSUserDomainMask, YES) firstObject];
+        [[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil];
+
+        self.digest = [[AddressBookDigest alloc] initWithPath:[directory stringByAppendingPathComponent:DIGEST_FILE]];
+        self.queue = dispatch_queue_create("AddressBookSync", DISPATCH_QUEUE_SERIAL);
+    }
+    return self;
+}
+
+-(void) addValuesOfProperty:(ABPropertyID) property ofPerson:(ABRecordRef) person toIdentifiers:(NSMutableArray *) identifiers
+{
+    ABMultiValueRef values = ABRecordCopyValue(person, property);
+    if (!values)
+        return;
+
+    CFIndex count = ABMultiValueGetCount(values);
+    for (CFIndex i = 0; i < count; i++) {
+        NSString *value = (__bridge_transfer NSString *) ABMultiValueCopyValueAtIndex(values, i);
+        NSString *identifier = [AddressBookDigest normalizedIdentifier:value];
+        if (identifier)
+            [identifiers addObject:identifier];
+    }
+    CFRelease(values);
+}
+
+-(NSArray *) addressBookIdentifiers
+{
+    CFErrorRef error = NULL;
+    ABAddressBookRef addressBook = ABAddressBookCreateWithOptions(NULL, &error);
+    if (!addressBook) {
+        if (error)
+            CFRelease(error);
+        return nil;
+    }
+
+    NSArray *people = (__bridge_transfer NSArray *) ABAddressBookCopyArrayOfAllPeople(addressBook);
+    NSMutableArray *identifiers = [NSMutableArray arrayWithCapacity:[people count] * 2];
+
+    for (id person in people) {
+        [self addValuesOfProperty:kABPersonPhoneProperty ofPerson:(__bridge ABRecordRef) person toIdentifiers:identifiers];
+        [self addValuesOfProperty:kABPersonEmailProperty ofPerson:(__bridge ABRecordRef) person toIdentifiers:identifiers];
+    }
+
+    CFRelease(addressBook);
+    return identifiers;
+}
+
+-(void) synchronize
+{
+    if (ABAddressBookGetAuthorizationStatus() != kABAuthorizationStatusAuthorized)
+        return;
+
+    dispatch_async(self.queue, ^{
+        NSArray *identifiers = [self addressBookIdentifiers];
+        if (!identifiers)
+            return;
+
+        if (!self.digest.hasDigest) {
+            // First upload
+            self.lastAddedCount = [identifiers count];
+            self.lastRemovedCount = 0;
+            [self transferAddressBook];
+            [self.digest commitIdentifiers:identifiers];
+            return;
+        }
+
+        NSUInteger removed = 0;
+        NSArray *added = [self.digest addedIdentifiers:identifiers removedCount:&removed];
+        self.lastAddedCount = [added count];
+        self.lastRemovedCount = removed;
+
+        if ([added count] == 0 && removed == 0)
+            return;
+
+        DLog(@"AddressBookSync: %lu added, %lu removed", (unsigned long) [added count], (unsigned long) removed);
+
+        // Removed identifiers cannot turn up new friends, only additions are worth a transfer
+        if ([added count] > 0)
+            [self transferAddressBook];
+        [self.digest commitIdentifiers:identifiers];
+    });
+}
+
+-(void) transferAddressBook
+{
+    // Forced, the SDK would skip the transfer if the number of records is unchanged
+    self.transferCount++;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [[C2CallPhone currentPhone] transferAddressBook:YES];
+    });
+}
+
+-(void) reset
+{
+    dispatch_async(self.queue, ^{
+        [self.digest reset];
+    });
+}
+
++(AddressBookSync *) instance
+{
+    static AddressBookSync *sync = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sync = [[AddressBookSync alloc] init];
+    });
+    return sync;
+}
+
+@end
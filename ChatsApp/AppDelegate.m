@@ -7,40 +7,260 @@
 //
 
 #import "AppDelegate.h"
+#import "AddressBookSync.h"
+#import "CallHandoverMonitor.h"
+#import "CallStatsCollector.h"
+#import "CallTraceRecorder.h"
+#import "DisplayNameCache.h"
+#import "EncoderLoadController.h"
+#import "FriendDiscovery.h"
+#import "KeyframePolicy.h"
+#import "PresenceCoalescer.h"
+#import "StoreMigrator.h"
+#import "VideoVisibilityPolicy.h"
 
-@implementation AppDelegate
+@interface SPAppDelegate ()
+
+// The storyboard window while the migration window is shown
+@property(nonatomic, strong) UIWindow *storyboardWindow;
+@property(nonatomic, weak) UIProgressView *migrationProgressView;
+@property(nonatomic) BOOL migratingStores;
+
+// Delegate callbacks received during the migration, forwarded when the SDK has been initialized
+@property(nonatomic, strong) NSMutableArray *deferredEvents;
+
+@end
+
+@implementation SPAppDelegate
 
 - (BOOL)application:(UIApplication *)application didFinishLaunchingWithOptions:(NSDictionary *)launchOptions
 {
-    // Override point for customization after application launch.
+    // An SDK store of an old model version is migrated before the SDK opens it
+    StoreMigrator *migrator = [StoreMigrator instance];
+    NSArray *stores = [migrator storesRequiringMigration];
+
+    if ([migrator canMigrateStoresSynchronously:stores]) {
+        [migrator migrateStores:stores progress:nil];
+
+        // C2CallAppDelegate initializes the SDK
+        return [super application:application didFinishLaunchingWithOptions:launchOptions];
+    }
+
+    // Too large for the launch time limit, the SDK is initialized when the migration has completed
+    self.migratingStores = YES;
+    [self showMigrationProgress];
+
+    // An interrupted migration continues on the next launch
+    __block UIBackgroundTaskIdentifier task = UIBackgroundTaskInvalid;
+    task = [application beginBackgroundTaskWithExpirationHandler:^{
+        [application endBackgroundTask:task];
+        task = UIBackgroundTaskInvalid;
+    }];
+
+    [migrator migrateStoresInBackground:stores progress:^(float progress) {
+        self.migrationProgressView.progress = progress;
+    } completion:^(BOOL success) {
+        self.migratingStores = NO;
+        [self hideMigrationProgress];
+        [super application:application didFinishLaunchingWithOptions:launchOptions];
+
+        // Activation has been reported before the SDK was initialized
+        if (application.applicationState == UIApplicationStateActive)
+            [self applicationDidBecomeActive:application];
+
+        for (dispatch_block_t event in self.deferredEvents) {
+            event();
+        }
+        self.deferredEvents = nil;
+
+        if (task != UIBackgroundTaskInvalid) {
+            [application endBackgroundTask:task];
+            task = UIBackgroundTaskInvalid;
+        }
+    }];
     return YES;
 }
-							
+
+-(void) showMigrationProgress
+{
+    UIViewController *controller = [[UIViewController alloc] init];
+    UIView *view = controller.view;
+    view.backgroundColor = [UIColor whiteColor];
+    CGRect bounds = view.bounds;
+
+    UILabel *label = [[UILabel alloc] initWithFrame:CGRectMake(20, CGRectGetMidY(bounds) - 40, bounds.size.width - 40, 20)];
+    label.text = NSLocalizedString(@"Updating your messages", @"Store Migration");
+    label.textAlignment = NSTextAlignmentCenter;
+    label.autoresizingMask = UIViewAutoresizingFlexibleWidth | UIViewAutoresizingFlexibleTopMargin | UIViewAutoresizingFlexibleBottomMargin;
+    [view addSubview:label];
+
+    UIProgressView *progressView = [[UIProgressView alloc] initWithProgressViewStyle:UIProgressViewStyleDefault];
+    progressView.frame = CGRectMake(40, CGRectGetMidY(bounds), bounds.size.width - 80, 2);
+    progressView.autoresizingMask = UIViewAutoresizingFlexibleWidth | UIViewAutoresizingFlexibleTopMargin | UIViewAutoresizingFlexibleBottomMargin;
+    [view addSubview:progressView];
+    self.migrationProgressView = progressView;
+
+    // UIKit shows the delegate window after launch, the storyboard window is shown again after the migration
+    UIWindow *window = [[UIWindow alloc] initWithFrame:[[UIScreen mainScreen] bounds]];
+    window.rootViewController = controller;
+    self.storyboardWindow = self.window;
+    self.window = window;
+    [window makeKeyAndVisible];
+}
+
+-(void) hideMigrationProgress
+{
+    self.window = self.storyboardWindow;
+    self.storyboardWindow = nil;
+    [self.window makeKeyAndVisible];
+}
+
+#pragma mark Application State
+
+// C2CallAppDelegate expects the SDK to be initialized, state changes during a migration are not forwarded
+
+- (void)applicationDidBecomeActive:(UIApplication *)application
+{
+    if (!self.migratingStores && [C2CallAppDelegate instancesRespondToSelector:_cmd])
+        [super applicationDidBecomeActive:application];
+}
+
 - (void)applicationWillResignActive:(UIApplication *)application
 {
-    // Sent when the application is about to move from active to inactive state. This can occur for certain types of temporary interruptions (such as an incoming phone call or SMS message) or when the user quits the application and it begins the transition to the background state.
-    // Use this method to pause ongoing tasks, disable timers, and throttle down OpenGL ES frame rates. Games should use this method to pause the game.
+    if (!self.migratingStores && [C2CallAppDelegate instancesRespondToSelector:_cmd])
+        [super applicationWillResignActive:application];
 }
 
 - (void)applicationDidEnterBackground:(UIApplication *)application
 {
-    // Use this method to release shared resources, save user data, invalidate timers, and store enough application state information to restore your application to its current state in case it is terminated later. 
-    // If your application supports background execution, this method is called instead of applicationWillTerminate: when the user quits.
+    if (!self.migratingStores && [C2CallAppDelegate instancesRespondToSelector:_cmd])
+        [super applicationDidEnterBackground:application];
 }
 
 - (void)applicationWillEnterForeground:(UIApplication *)application
 {
-    // Called as part of the transition from the background to the inactive state; here you can undo many of the changes made on entering the background.
+    if (!self.migratingStores && [C2CallAppDelegate instancesRespondToSelector:_cmd])
+        [super applicationWillEnterForeground:application];
 }
 
-- (void)applicationDidBecomeActive:(UIApplication *)application
+- (void)applicationWillTerminate:(UIApplication *)application
 {
-    // Restart any tasks that were paused (or not yet started) while the application was inactive. If the application was previously in the background, optionally refresh the user interface.
+    if (!self.migratingStores && [C2CallAppDelegate instancesRespondToSelector:_cmd])
+        [super applicationWillTerminate:application];
 }
 
-- (void)applicationWillTerminate:(UIApplication *)application
+#pragma mark Deferred Events
+
+// Push registration, notifications and URLs are only delivered once, during a migration they are
+// kept and forwarded to C2CallAppDelegate when the migration has completed
+
+-(BOOL) deferEvent:(dispatch_block_t) event
 {
-    // Called when the application is about to terminate. Save data if appropriate. See also applicationDidEnterBackground:.
+    if (!self.migratingStores)
+        return NO;
+
+    if (!self.deferredEvents)
+        self.deferredEvents = [NSMutableArray array];
+
+    [self.deferredEvents addObject:[event copy]];
+    return YES;
+}
+
+- (void)application:(UIApplication *)application didRegisterForRemoteNotificationsWithDeviceToken:(NSData *)deviceToken
+{
+    if (![C2CallAppDelegate instancesRespondToSelector:_cmd])
+        return;
+
+    if (![self deferEvent:^{ [super application:application didRegisterForRemoteNotificationsWithDeviceToken:deviceToken]; }])
+        [super application:application didRegisterForRemoteNotificationsWithDeviceToken:deviceToken];
+}
+
+- (void)application:(UIApplication *)application didFailToRegisterForRemoteNotificationsWithError:(NSError *)error
+{
+    if (![C2CallAppDelegate instancesRespondToSelector:_cmd])
+        return;
+
+    if (![self deferEvent:^{ [super application:application didFailToRegisterForRemoteNotificationsWithError:error]; }])
+        [super application:application didFailToRegisterForRemoteNotificationsWithError:error];
+}
+
+- (void)application:(UIApplication *)application didReceiveRemoteNotification:(NSDictionary *)userInfo
+{
+    if (![C2CallAppDelegate instancesRespondToSelector:_cmd])
+        return;
+
+    if (![self deferEvent:^{ [super application:application didReceiveRemoteNotification:userInfo]; }])
+        [super application:application didReceiveRemoteNotification:userInfo];
+}
+
+- (void)application:(UIApplication *)application didReceiveLocalNotification:(UILocalNotification *)notification
+{
+    if (![C2CallAppDelegate instancesRespondToSelector:_cmd])
+        return;
+
+    if (![self deferEvent:^{ [super application:application didReceiveLocalNotification:notification]; }])
+        [super application:application didReceiveLocalNotification:notification];
+}
+
+- (BOOL)application:(UIApplication *)application handleOpenURL:(NSURL *)url
+{
+    if (![C2CallAppDelegate instancesRespondToSelector:_cmd])
+        return NO;
+
+    // The URL is opened after the migration
+    if ([self deferEvent:^{ [super application:application handleOpenURL:url]; }])
+        return YES;
+
+    return [super application:application handleOpenURL:url];
+}
+
+- (BOOL)application:(UIApplication *)application openURL:(NSURL *)url sourceApplication:(NSString *)sourceApplication annotation:(id)annotation
+{
+    if (![C2CallAppDelegate instancesRespondToSelector:_cmd])
+        return NO;
+
+    // The URL is opened after the migration
+    if ([self deferEvent:^{ [super application:application openURL:url sourceApplication:sourceApplication annotation:annotation]; }])
+        return YES;
+
+    return [super application:application openURL:url sourceApplication:sourceApplication annotation:annotation];
+}
+
+#pragma mark SDK Events
+
+-(void) c2callLoginSuccess
+{
+    [super c2callLoginSuccess];
+
+    [[CallHandoverMonitor instance] start];
+    [[PresenceCoalescer instance] start];
+    [[DisplayNameCache instance] start];
+    [[FriendDiscovery instance] start];
+    [[AddressBookSync instance] synchronize];
+}
+
+-(void) connected:(SIPPhone *) phone
+{
+    [super connected:phone];
+
+    [[CallStatsCollector instance] start];
+    [[CallTraceRecorder instance] start];
+
+    if (phone.videoCall) {
+        [[EncoderLoadController instance] start];
+        [[KeyframePolicy instance] start];
+    }
+}
+
+-(void) hangUp:(SIPPhone *) phone
+{
+    [[EncoderLoadController instance] stop];
+    [[KeyframePolicy instance] stop];
+    [[CallStatsCollector instance] stop];
+    [[CallTraceRecorder instance] stopAndFlush];
+    [[VideoVisibilityPolicy instance] restoreVideoFrame];
+
+    [super hangUp:phone];
 }
 
 @end
@@ -0,0 +1,94 @@
+//
+//  AttachmentStreamCipher.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 09/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#define ATTACHMENT_STREAM_KEY_LENGTH        64
+#define ATTACHMENT_STREAM_CHUNK_SIZE        65536
+#define ATTACHMENT_STREAM_TAG_LENGTH        16
+
+extern NSString * const AttachmentStreamCipherErrorDomain;
+
+typedef enum {
+    AttachmentStreamErrorIO = 1,            // Reading or writing a file failed
+    AttachmentStreamErrorFormat,            // Not an encrypted attachment
+    AttachmentStreamErrorAuthentication,    // A chunk has been modified, reordered or the file has been truncated
+    AttachmentStreamErrorRandom             // No random nonce could be generated
+} AttachmentStreamErrorT;
+
+/** Chunked authenticated encryption for large attachments.
+
+ Attachments are encrypted and decrypted in fixed size chunks, so peak memory is two chunks,
+ independent of the attachment size. Every chunk is encrypted with AES-256-CTR and authenticated
+ with a truncated HMAC-SHA256 over the file header, the chunk index, a final chunk flag and the
+ ciphertext (STREAM construction). Reordered or modified chunks fail authentication, and so does a
+ file truncated at a chunk boundary, because the new last chunk has not been sealed as final.
+
+ Chunks are at fixed offsets, so any range of the attachment can be decrypted without reading
+ the chunks before, e.g. for video playback.
+
+ Not used by the app yet: attachments are uploaded and downloaded by the SDK, which encrypts them
+ itself, and the keys would have to be exchanged with MessageEnvelope, which has no key provider.
+ */
+@interface AttachmentStreamCipher : NSObject
+
+/** Plain bytes per chunk. */
+@property(nonatomic, readonly) NSUInteger chunkSize;
+
+/** Initialize with a key and ATTACHMENT_STREAM_CHUNK_SIZE.
+
+ @param key - Key of ATTACHMENT_STREAM_KEY_LENGTH bytes
+ */
+-(id) initWithKey:(NSData *) key;
+
+/** Initialize with a key and chunk size.
+
+ @param key - Key of ATTACHMENT_STREAM_KEY_LENGTH bytes
+ @param chunkSize - Plain bytes per chunk, only used for encryption, decryption reads it from the file
+ */
+-(id) initWithKey:(NSData *) key chunkSize:(NSUInteger) chunkSize;
+
+/** Encrypt a file.
+
+ @param source - Plain file
+ @param target - Encrypted file, will be overwritten
+ @param error - Error on return
+ @return YES on success
+ */
+-(BOOL) encryptFile:(NSString *) source toFile:(NSString *) target error:(NSError **) error;
+
+/** Decrypt a file. The plain data is written to a temporary file next to the target, which replaces
+ the target only after every chunk has been authenticated. On error the target is left unchanged.
+
+ @param source - Encrypted file
+ @param target - Plain file, will be replaced
+ @param error - Error on return
+ @return YES on success
+ */
+-(BOOL) decryptFile:(NSString *) source toFile:(NSString *) target error:(NSError **) error;
+
+/** Decrypt a range of an encrypted file, only the chunks covering the range are read.
+
+ @param range - Range of the plain data
+ @param source - Encrypted file
+ @param error - Error on return
+ @return The plain data of the range, shorter if the range exceeds the plain data, or nil on error
+ */
+-(NSData *) decryptRange:(NSRange) range ofFile:(NSString *) source error:(NSError **) error;
+
+/** Plain size of an encrypted file.
+
+ @param source - Encrypted file
+ @return Size of the plain data or -1 if the file is not an encrypted attachment
+ */
+-(long long) plainSizeOfFile:(NSString *) source;
+
+/** @return A new random key */
++(NSData *) generateKey;
+
+@end
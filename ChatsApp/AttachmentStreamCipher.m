@@ -0,0 +1,364 @@
+//
+//  AttachmentStreamCipher.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 09/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <CommonCrypto/CommonCryptor.h>
+#import <CommonCrypto/CommonHMAC.h>
+#import <Security/Security.h>
+#import <sys/stat.h>
+
+#import "AttachmentStreamCipher.h"
+
+#define STREAM_MAGIC                "SCS1"
+#define STREAM_NONCE_LENGTH         8
+#define STREAM_HEADER_LENGTH        (4 + STREAM_NONCE_LENGTH + 4)
+#define STREAM_ENCRYPTION_KEY       kCCKeySizeAES256
+#define STREAM_MAX_CHUNK_SIZE       (16 * 1024 * 1024)
+
+NSString * const AttachmentStreamCipherErrorDomain = @"AttachmentStreamCipher";
+
+// magic | nonce prefix | chunk size (32 bit big endian) | chunk 0 | chunk 1 | ...
+// chunk: AES-CTR ciphertext | HMAC(header | index | final flag | ciphertext) truncated to ATTACHMENT_STREAM_TAG_LENGTH
+typedef struct {
+    uint8_t     bytes[STREAM_HEADER_LENGTH];
+    NSUInteger  chunkSize;
+    uint64_t    chunkCount;
+    uint64_t    plainSize;
+} StreamHeader;
+
+static void writeUInt32(uint8_t *bytes, uint32_t value)
+{
+    bytes[0] = (value >> 24) & 0xff;
+    bytes[1] = (value >> 16) & 0xff;
+    bytes[2] = (value >> 8) & 0xff;
+    bytes[3] = value & 0xff;
+}
+
+static uint32_t readUInt32(const uint8_t *bytes)
+{
+    return ((uint32_t) bytes[0] << 24) | ((uint32_t) bytes[1] << 16) | ((uint32_t) bytes[2] << 8) | bytes[3];
+}
+
+@interface AttachmentStreamCipher () {
+    uint8_t     key[ATTACHMENT_STREAM_KEY_LENGTH];
+}
+
+@end
+
+@implementation AttachmentStreamCipher
+
+-(id) initWithKey:(NSData *) streamKey
+{
+    return [self initWithKey:streamKey chunkSize:ATTACHMENT_STREAM_CHUNK_SIZE];
+}
+
+-(id) initWithKey:(NSData *) streamKey chunkSize:(NSUInteger) chunkSize
+{
+    if ([streamKey length] != ATTACHMENT_STREAM_KEY_LENGTH || chunkSize == 0 || chunkSize > STREAM_MAX_CHUNK_SIZE)
+        return nil;
+
+    self = [super init];
+    if (self) {
+        [streamKey getBytes:key length:ATTACHMENT_STREAM_KEY_LENGTH];
+        _chunkSize = chunkSize;
+    }
+    return self;
+}
+
+-(void) dealloc
+{
+    memset(key, 0, sizeof(key));
+}
+
++(NSData *) generateKey
+{
+    NSMutableData *streamKey = [NSMutableData dataWithLength:ATTACHMENT_STREAM_KEY_LENGTH];
+    if (SecRandomCopyBytes(kSecRandomDefault, ATTACHMENT_STREAM_KEY_LENGTH, [streamKey mutableBytes]) != 0)
+        return nil;
+    return streamKey;
+}
+
+-(BOOL) failWithCode:(AttachmentStreamErrorT) code error:(NSError **) error
+{
+    if (error)
+        *error = [NSError errorWithDomain:AttachmentStreamCipherErrorDomain code:code userInfo:nil];
+    return NO;
+}
+
+#pragma mark Chunks
+
+-(void) tag:(uint8_t *) tag header:(const StreamHeader *) header index:(uint64_t) index final:(BOOL) final ciphertext:(const uint8_t *) ciphertext length:(size_t) length
+{
+    uint8_t chunkInfo[9];
+    writeUInt32(chunkInfo, (uint32_t) (index >> 32));
+    writeUInt32(chunkInfo + 4, (uint32_t) index);
+    chunkInfo[8] = final ? 1 : 0;
+
+    uint8_t digest[CC_SHA256_DIGEST_LENGTH];
+    CCHmacContext context;
+    CCHmacInit(&context, kCCHmacAlgSHA256, key + STREAM_ENCRYPTION_KEY, ATTACHMENT_STREAM_KEY_LENGTH - STREAM_ENCRYPTION_KEY);
+    CCHmacUpdate(&context, header->bytes, STREAM_HEADER_LENGTH);
+    CCHmacUpdate(&context, chunkInfo, sizeof(chunkInfo));
+    CCHmacUpdate(&context, ciphertext, length);
+    CCHmacFinal(&context, digest);
+
+    memcpy(tag, digest, ATTACHMENT_STREAM_TAG_LENGTH);
+}
+
+-(BOOL) crypt:(const StreamHeader *) header index:(uint64_t) index input:(const uint8_t *) input length:(size_t) length output:(uint8_t *) output
+{
+    if (length == 0)
+        return YES;
+
+    // Counter block: nonce prefix | chunk index | block counter, unique per chunk and file
+    uint8_t counter[kCCBlockSizeAES128];
+    memcpy(counter, header->bytes + 4, STREAM_NONCE_LENGTH);
+    writeUInt32(counter + STREAM_NONCE_LENGTH, (uint32_t) index);
+    writeUInt32(counter + STREAM_NONCE_LENGTH + 4, 0);
+
+    CCCryptorRef cryptor = NULL;
+    if (CCCryptorCreateWithMode(kCCEncrypt, kCCModeCTR, kCCAlgorithmAES, ccNoPadding, counter, key, STREAM_ENCRYPTION_KEY, NULL, 0, 0, kCCModeOptionCTR_BE, &cryptor) != kCCSuccess)
+        return NO;
+
+    size_t moved = 0;
+    CCCryptorStatus status = CCCryptorUpdate(cryptor, input, length, output, length, &moved);
+    CCCryptorRelease(cryptor);
+    return status == kCCSuccess && moved == length;
+}
+
+-(BOOL) openChunk:(const StreamHeader *) header index:(uint64_t) index input:(const uint8_t *) input length:(size_t) length output:(uint8_t *) output
+{
+    if (length < ATTACHMENT_STREAM_TAG_LENGTH)
+        return NO;
+
+    size_t ciphertextLength = length - ATTACHMENT_STREAM_TAG_LENGTH;
+    uint8_t expected[ATTACHMENT_STREAM_TAG_LENGTH];
+    [self tag:expected header:header index:index final:index == header->chunkCount - 1 ciphertext:input length:ciphertextLength];
+
+    uint8_t difference = 0;
+    for (int i = 0; i < ATTACHMENT_STREAM_TAG_LENGTH; i++) {
+        difference |= expected[i] ^ input[ciphertextLength + i];
+    }
+    if (difference != 0)
+        return NO;
+
+    return [self crypt:header index:index input:input length:ciphertextLength output:output];
+}
+
+#pragma mark Header
+
+-(BOOL) readHeader:(StreamHeader *) header fromFile:(FILE *) file
+{
+    struct stat info;
+    if (fstat(fileno(file), &info) != 0 || fread(header->bytes, 1, STREAM_HEADER_LENGTH, file) != STREAM_HEADER_LENGTH)
+        return NO;
+
+    if (memcmp(header->bytes, STREAM_MAGIC, 4) != 0)
+        return NO;
+
+    header->chunkSize = readUInt32(header->bytes + 4 + STREAM_NONCE_LENGTH);
+    if (header->chunkSize == 0 || header->chunkSize > STREAM_MAX_CHUNK_SIZE)
+        return NO;
+
+    // Every file has at least one chunk, only the last one may be short
+    if (info.st_size < STREAM_HEADER_LENGTH + ATTACHMENT_STREAM_TAG_LENGTH)
+        return NO;
+
+    uint64_t encryptedSize = info.st_size - STREAM_HEADER_LENGTH;
+    uint64_t encryptedChunk = header->chunkSize + ATTACHMENT_STREAM_TAG_LENGTH;
+
+    header->chunkCount = (encryptedSize + encryptedChunk - 1) / encryptedChunk;
+    if (encryptedSize - (header->chunkCount - 1) * encryptedChunk < ATTACHMENT_STREAM_TAG_LENGTH)
+        return NO;
+
+    header->plainSize = encryptedSize - header->chunkCount * ATTACHMENT_STREAM_TAG_LENGTH;
+    return YES;
+}
+
+-(long long) plainSizeOfFile:(NSString *) source
+{
+    FILE *file = fopen([source fileSystemRepresentation], "rb");
+    if (!file)
+        return -1;
+
+    StreamHeader header;
+    BOOL valid = [self readHeader:&header fromFile:file];
+    fclose(file);
+    return valid ? (long long) header.plainSize : -1;
+}
+
+#pragma mark Files
+
+-(BOOL) encryptFile:(NSString *) source toFile:(NSString *) target error:(NSError **) error
+{
+    // A predictable nonce would reuse the CTR keystream of another file with the same key
+    StreamHeader header;
+    memcpy(header.bytes, STREAM_MAGIC, 4);
+    if (SecRandomCopyBytes(kSecRandomDefault, STREAM_NONCE_LENGTH, header.bytes + 4) != 0)
+        return [self failWithCode:AttachmentStreamErrorRandom error:error];
+
+    FILE *input = fopen([source fileSystemRepresentation], "rb");
+    if (!input)
+        return [self failWithCode:AttachmentStreamErrorIO error:error];
+
+    FILE *output = fopen([target fileSystemRepresentation], "wb");
+    struct stat info;
+    if (!output || fstat(fileno(input), &info) != 0) {
+        fclose(input);
+        if (output)
+            fclose(output);
+        return [self failWithCode:AttachmentStreamErrorIO error:error];
+    }
+
+    writeUInt32(header.bytes + 4 + STREAM_NONCE_LENGTH, (uint32_t) self.chunkSize);
+    header.chunkSize = self.chunkSize;
+    header.plainSize = info.st_size;
+    header.chunkCount = MAX(1, (header.plainSize + self.chunkSize - 1) / self.chunkSize);
+
+    uint8_t *plain = malloc(self.chunkSize);
+    uint8_t *sealed = malloc(self.chunkSize + ATTACHMENT_STREAM_TAG_LENGTH);
+    BOOL success = plain && sealed && fwrite(header.bytes, 1, STREAM_HEADER_LENGTH, output) == STREAM_HEADER_LENGTH;
+
+    for (uint64_t index = 0; success && index < header.chunkCount; index++) {
+        BOOL final = index == header.chunkCount - 1;
+        size_t length = final ? (size_t) (header.plainSize - index * self.chunkSize) : self.chunkSize;
+
+        if (fread(plain, 1, length, input) != length || ![self crypt:&header index:index input:plain length:length output:sealed]) {
+            success = NO;
+            break;
+        }
+
+        [self tag:sealed + length header:&header index:index final:final ciphertext:sealed length:length];
+        success = fwrite(sealed, 1, length + ATTACHMENT_STREAM_TAG_LENGTH, output) == length + ATTACHMENT_STREAM_TAG_LENGTH;
+    }
+
+    if (plain)
+        memset(plain, 0, self.chunkSize);
+    free(plain);
+    free(sealed);
+    fclose(input);
+    success = fclose(output) == 0 && success;
+
+    if (!success) {
+        [[NSFileManager defaultManager] removeItemAtPath:target error:nil];
+        return [self failWithCode:AttachmentStreamErrorIO error:error];
+    }
+    return YES;
+}
+
+-(BOOL) decryptFile:(NSString *) source toFile:(NSString *) target error:(NSError **) error
+{
+    FILE *input = fopen([source fileSystemRepresentation], "rb");
+    if (!input)
+        return [self failWithCode:AttachmentStreamErrorIO error:error];
+
+    StreamHeader header;
+    if (![self readHeader:&header fromFile:input]) {
+        fclose(input);
+        return [self failWithCode:AttachmentStreamErrorFormat error:error];
+    }
+
+    // Plaintext only appears at target once every chunk has been authenticated
+    NSString *partial = [target stringByAppendingFormat:@".%@.partial", [[NSUUID UUID] UUIDString]];
+    FILE *output = fopen([partial fileSystemRepresentation], "wb");
+    if (!output) {
+        fclose(input);
+        return [self failWithCode:AttachmentStreamErrorIO error:error];
+    }
+
+    size_t encryptedChunk = header.chunkSize + ATTACHMENT_STREAM_TAG_LENGTH;
+    uint8_t *sealed = malloc(encryptedChunk);
+    uint8_t *plain = malloc(header.chunkSize);
+    AttachmentStreamErrorT failure = (sealed && plain) ? 0 : AttachmentStreamErrorIO;
+
+    for (uint64_t index = 0; !failure && index < header.chunkCount; index++) {
+        size_t length = fread(sealed, 1, encryptedChunk, input);
+        if (length < ATTACHMENT_STREAM_TAG_LENGTH || (length < encryptedChunk && index != header.chunkCount - 1)) {
+            failure = AttachmentStreamErrorIO;
+        } else if (![self openChunk:&header index:index input:sealed length:length output:plain]) {
+            failure = AttachmentStreamErrorAuthentication;
+        } else if (fwrite(plain, 1, length - ATTACHMENT_STREAM_TAG_LENGTH, output) != length - ATTACHMENT_STREAM_TAG_LENGTH) {
+            failure = AttachmentStreamErrorIO;
+        }
+    }
+
+    if (plain)
+        memset(plain, 0, header.chunkSize);
+    free(plain);
+    free(sealed);
+    fclose(input);
+    if (fclose(output) != 0 && !failure)
+        failure = AttachmentStreamErrorIO;
+
+    // Same directory, so the rename replaces target atomically
+    if (!failure && rename([partial fileSystemRepresentation], [target fileSystemRepresentation]) != 0)
+        failure = AttachmentStreamErrorIO;
+
+    // Never leave partially decrypted data behind
+    if (failure) {
+        [[NSFileManager defaultManager] removeItemAtPath:partial error:nil];
+        return [self failWithCode:failure error:error];
+    }
+    return YES;
+}
+
+-(NSData *) decryptRange:(NSRange) range ofFile:(NSString *) source error:(NSError **) error
+{
+    FILE *input = fopen([source fileSystemRepresentation], "rb");
+    if (!input) {
+        [self failWithCode:AttachmentStreamErrorIO error:error];
+        return nil;
+    }
+
+    StreamHeader header;
+    if (![self readHeader:&header fromFile:input]) {
+        fclose(input);
+        [self failWithCode:AttachmentStreamErrorFormat error:error];
+        return nil;
+    }
+
+    uint64_t start = MIN((uint64_t) range.location, header.plainSize);
+    uint64_t end = MIN((uint64_t) NSMaxRange(range), header.plainSize);
+    NSMutableData *result = [NSMutableData dataWithCapacity:(NSUInteger) (end - start)];
+    if (start == end) {
+        fclose(input);
+        return result;
+    }
+
+    size_t encryptedChunk = header.chunkSize + ATTACHMENT_STREAM_TAG_LENGTH;
+    uint8_t *sealed = malloc(encryptedChunk);
+    uint8_t *plain = malloc(header.chunkSize);
+    AttachmentStreamErrorT failure = (sealed && plain) ? 0 : AttachmentStreamErrorIO;
+
+    for (uint64_t index = start / header.chunkSize; !failure && index <= (end - 1) / header.chunkSize; index++) {
+        size_t length = 0;
+        if (fseeko(input, STREAM_HEADER_LENGTH + index * encryptedChunk, SEEK_SET) != 0) {
+            failure = AttachmentStreamErrorIO;
+        } else if ((length = fread(sealed, 1, encryptedChunk, input)) < ATTACHMENT_STREAM_TAG_LENGTH) {
+            failure = AttachmentStreamErrorIO;
+        } else if (![self openChunk:&header index:index input:sealed length:length output:plain]) {
+            failure = AttachmentStreamErrorAuthentication;
+        } else {
+            uint64_t chunkStart = index * header.chunkSize;
+            uint64_t from = MAX(start, chunkStart) - chunkStart;
+            uint64_t to = MIN(end, chunkStart + length - ATTACHMENT_STREAM_TAG_LENGTH) - chunkStart;
+            [result appendBytes:plain + from length:(NSUInteger) (to - from)];
+        }
+    }
+
+    free(plain);
+    free(sealed);
+    fclose(input);
+
+    if (failure) {
+        [self failWithCode:failure error:error];
+        return nil;
+    }
+    return result;
+}
+
+@end
@@ -0,0 +1,26 @@
+//
+//  C2CallPhone+CallStatistics.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 30/05/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <SocialCommunication/C2CallPhone.h>
+
+/** getStats style access to the metrics of the current or last call.
+
+    NSDictionary *stats = [[C2CallPhone currentPhone] callStatistics];
+    NSLog(@"Receive fps p50: %@", stats[@"histograms"][@"receiveFrameRate"][@"p50"]);
+
+ @see CallStatsCollector
+ */
+@interface C2CallPhone (CallStatistics)
+
+/** Snapshot of the call metrics as property list. */
+-(NSDictionary *) callStatistics;
+
+/** Snapshot of the call metrics as JSON. */
+-(NSData *) callStatisticsJSON;
+
+@end
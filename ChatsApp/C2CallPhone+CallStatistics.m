@@ -0,0 +1,24 @@
+//
+//  C2CallPhone+CallStatistics.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 30/05/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import "C2CallPhone+CallStatistics.h"
+#import "CallStatsCollector.h"
+
+@implementation C2CallPhone (CallStatistics)
+
+-(NSDictionary *) callStatistics
+{
+    return [[CallStatsCollector instance] snapshot];
+}
+
+-(NSData *) callStatisticsJSON
+{
+    return [[CallStatsCollector instance] JSONSnapshot];
+}
+
+@end
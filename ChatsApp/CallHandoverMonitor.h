@@ -0,0 +1,57 @@
+//
+//  CallHandoverMonitor.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 26/05/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/** Keeps an active call alive while the device switches network interfaces.
+
+ On a Wi-Fi to cellular switch the media path is silent until the SDK has re-registered
+ on the new interface. With the default connection timeout the call is hung up before
+ that happens. The monitor watches the reachability of the default route and, while a
+ call is connected, widens the connection timeout for the duration of the handover.
+ The regular timeout is restored as soon as packets are received again.
+
+ The gap between C2Call:ConnectionStalling and C2Call:ConnectionResume is measured
+ for every handover, so the time to resume can be checked on the device.
+ */
+@interface CallHandoverMonitor : NSObject
+
+/** Connection timeout applied outside of a handover. Default is 10s. */
+@property(nonatomic) NSTimeInterval defaultConnectionTimeout;
+
+/** Connection timeout applied while a handover is in progress. Default is 30s. */
+@property(nonatomic) NSTimeInterval handoverConnectionTimeout;
+
+/** Stalling timeout used to detect the start of a media gap. Default is 0.5s. */
+@property(nonatomic) NSTimeInterval stallingTimeout;
+
+/** YES while an interface change is being bridged for the active call. */
+@property(nonatomic, readonly) BOOL handoverInProgress;
+
+/** Number of interface changes bridged during calls since start. */
+@property(nonatomic, readonly) NSUInteger handoverCount;
+
+/** Media gap of the last completed handover in seconds, 0 if none was measured.
+
+ A handover which timed out reports handoverConnectionTimeout.
+ */
+@property(nonatomic, readonly) NSTimeInterval lastHandoverGap;
+
+/** YES if the media path did not resume within handoverConnectionTimeout during the last handover. */
+@property(nonatomic, readonly) BOOL lastHandoverTimedOut;
+
+/** Start watching the network interface. Safe to call more than once. */
+-(void) start;
+
+/** Stop watching and restore the default connection timeout, ends a handover in progress. */
+-(void) stop;
+
+/** @return shared instance */
++(CallHandoverMonitor *) instance;
+
+@end
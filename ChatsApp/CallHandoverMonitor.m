@@ -0,0 +1,220 @@
+//
+//  CallHandoverMonitor.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 26/05/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <SystemConfiguration/SystemConfiguration.h>
+#import <netinet/in.h>
+#import <SocialCommunication/SocialCommunication.h>
+#import <SocialCommunication/debug.h>
+
+#import "CallHandoverMonitor.h"
+
+typedef enum {
+    NetworkInterfaceNone,
+    NetworkInterfaceWiFi,
+    NetworkInterfaceCellular
+} NetworkInterfaceT;
+
+@interface CallHandoverMonitor () {
+    SCNetworkReachabilityRef    reachability;
+    NetworkInterfaceT           currentInterface;
+    CFAbsoluteTime              stallStart;
+    BOOL                        started, hangupOnTimeout;
+}
+
+@property(nonatomic, readwrite) BOOL handoverInProgress;
+@property(nonatomic, readwrite) NSUInteger handoverCount;
+@property(nonatomic, readwrite) NSTimeInterval lastHandoverGap;
+@property(nonatomic, readwrite) BOOL lastHandoverTimedOut;
+
+-(void) reachabilityChanged:(SCNetworkReachabilityFlags) flags;
+
+@end
+
+static NetworkInterfaceT interfaceForFlags(SCNetworkReachabilityFlags flags)
+{
+    if ((flags & kSCNetworkReachabilityFlagsReachable) == 0)
+        return NetworkInterfaceNone;
+
+    if ((flags & kSCNetworkReachabilityFlagsIsWWAN) != 0)
+        return NetworkInterfaceCellular;
+
+    return NetworkInterfaceWiFi;
+}
+
+static void reachabilityCallback(SCNetworkReachabilityRef target, SCNetworkReachabilityFlags flags, void *info)
+{
+    CallHandoverMonitor *monitor = (__bridge CallHandoverMonitor *) info;
+    [monitor reachabilityChanged:flags];
+}
+
+@implementation CallHandoverMonitor
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.defaultConnectionTimeout = 10.;
+        self.handoverConnectionTimeout = 30.;
+        self.stallingTimeout = 0.5;
+        currentInterface = NetworkInterfaceNone;
+    }
+    return self;
+}
+
+-(void) dealloc
+{
+    [self stop];
+}
+
+-(void) start
+{
+    if (started)
+        return;
+
+    struct sockaddr_in zeroAddress;
+    bzero(&zeroAddress, sizeof(zeroAddress));
+    zeroAddress.sin_len = sizeof(zeroAddress);
+    zeroAddress.sin_family = AF_INET;
+
+    reachability = SCNetworkReachabilityCreateWithAddress(kCFAllocatorDefault, (const struct sockaddr *) &zeroAddress);
+    if (!reachability)
+        return;
+
+    SCNetworkReachabilityContext context = {0, (__bridge void *) self, NULL, NULL, NULL};
+    SCNetworkReachabilitySetCallback(reachability, reachabilityCallback, &context);
+    SCNetworkReachabilityScheduleWithRunLoop(reachability, CFRunLoopGetMain(), kCFRunLoopDefaultMode);
+
+    SCNetworkReachabilityFlags flags = 0;
+    if (SCNetworkReachabilityGetFlags(reachability, &flags))
+        currentInterface = interfaceForFlags(flags);
+
+    NSNotificationCenter *nc = [NSNotificationCenter defaultCenter];
+    [nc addObserver:self selector:@selector(connectionStalling:) name:@"C2Call:ConnectionStalling" object:nil];
+    [nc addObserver:self selector:@selector(connectionResume:) name:@"C2Call:ConnectionResume" object:nil];
+
+    C2CallPhone *phone = [C2CallPhone currentPhone];
+    [phone setConnectionStallingTimeout:self.stallingTimeout];
+    [phone setConnectionTimeout:self.defaultConnectionTimeout];
+
+    started = YES;
+}
+
+-(void) stop
+{
+    if (!started)
+        return;
+
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+
+    if (reachability) {
+        SCNetworkReachabilityUnscheduleFromRunLoop(reachability, CFRunLoopGetMain(), kCFRunLoopDefaultMode);
+        SCNetworkReachabilitySetCallback(reachability, NULL, NULL);
+        CFRelease(reachability);
+        reachability = NULL;
+    }
+
+    if (self.handoverInProgress)
+        [self finishHandover];
+    else
+        [[C2CallPhone currentPhone] setConnectionTimeout:self.defaultConnectionTimeout];
+
+    started = NO;
+}
+
+#pragma mark Handover
+
+-(BOOL) callActive
+{
+    return [SIPPhone currentPhone].callStatus == SCCallStatusConnected;
+}
+
+-(void) reachabilityChanged:(SCNetworkReachabilityFlags) flags
+{
+    NetworkInterfaceT newInterface = interfaceForFlags(flags);
+    if (newInterface == currentInterface)
+        return;
+
+    DLog(@"CallHandoverMonitor: interface %d -> %d", currentInterface, newInterface);
+    currentInterface = newInterface;
+
+    if (![self callActive] || self.handoverInProgress)
+        return;
+
+    // Also bridge a temporary loss of all interfaces, the call may recover
+    // when the same interface comes back.
+    [self beginHandover];
+}
+
+-(void) beginHandover
+{
+    C2CallPhone *phone = [C2CallPhone currentPhone];
+
+    self.handoverInProgress = YES;
+    self.handoverCount++;
+    self.lastHandoverGap = 0;
+    self.lastHandoverTimedOut = NO;
+
+    hangupOnTimeout = phone.hangupOnConnectionTimeout;
+    phone.hangupOnConnectionTimeout = NO;
+    [phone setConnectionTimeout:self.handoverConnectionTimeout];
+
+    // Give up on the handover if the media path does not come back in time
+    NSUInteger handover = self.handoverCount;
+    dispatch_time_t popTime = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.handoverConnectionTimeout * NSEC_PER_SEC));
+    dispatch_after(popTime, dispatch_get_main_queue(), ^(void){
+        if (self.handoverInProgress && self.handoverCount == handover) {
+            DLog(@"CallHandoverMonitor: handover %lu timed out", (unsigned long) handover);
+            self.lastHandoverGap = self.handoverConnectionTimeout;
+            self.lastHandoverTimedOut = YES;
+            [self finishHandover];
+        }
+    });
+}
+
+-(void) finishHandover
+{
+    C2CallPhone *phone = [C2CallPhone currentPhone];
+
+    [phone setConnectionTimeout:self.defaultConnectionTimeout];
+    phone.hangupOnConnectionTimeout = hangupOnTimeout;
+
+    self.handoverInProgress = NO;
+    stallStart = 0;
+}
+
+-(void) connectionStalling:(NSNotification *) notification
+{
+    if (stallStart == 0)
+        stallStart = CFAbsoluteTimeGetCurrent();
+}
+
+-(void) connectionResume:(NSNotification *) notification
+{
+    if (stallStart > 0 && self.handoverInProgress) {
+        // The stalling timeout elapses before the notification is sent
+        self.lastHandoverGap = CFAbsoluteTimeGetCurrent() - stallStart + self.stallingTimeout;
+        DLog(@"CallHandoverMonitor: media resumed after %.3fs", self.lastHandoverGap);
+    }
+
+    if (self.handoverInProgress)
+        [self finishHandover];
+
+    stallStart = 0;
+}
+
++(CallHandoverMonitor *) instance
+{
+    static CallHandoverMonitor *monitor = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        monitor = [[CallHandoverMonitor alloc] init];
+    });
+    return monitor;
+}
+
+@end
@@ -0,0 +1,45 @@
+//
+//  CallStatsCollector.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 30/05/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "CallStatsHistogram.h"
+
+/** Collects call metrics into counters and histograms while a call is active.
+
+ The metrics are sampled once per second from the video handler, the call state
+ notifications and the app's media controllers (EncoderLoadController, KeyframePolicy,
+ CallHandoverMonitor). Snapshots are cheap and don't block the sampling,
+ so the app can poll them every second.
+
+ Use [[C2CallPhone currentPhone] callStatistics] to access the current snapshot.
+ */
+@interface CallStatsCollector : NSObject
+
+@property(nonatomic, readonly) CallStatsHistogram *encodeTime;
+@property(nonatomic, readonly) CallStatsHistogram *sendFrameRate;
+@property(nonatomic, readonly) CallStatsHistogram *receiveFrameRate;
+@property(nonatomic, readonly) CallStatsHistogram *connectionQuality;
+@property(nonatomic, readonly) CallStatsHistogram *stallDuration;
+@property(nonatomic, readonly) CallStatsHistogram *handoverGap;
+
+/** Start collecting for a new call, all metrics are reset. */
+-(void) start;
+
+/** Stop collecting, the last values remain available. */
+-(void) stop;
+
+/** Snapshot of all metrics as property list. */
+-(NSDictionary *) snapshot;
+
+/** Snapshot of all metrics as JSON. */
+-(NSData *) JSONSnapshot;
+
+/** @return shared instance */
++(CallStatsCollector *) instance;
+
+@end
@@ -0,0 +1,232 @@
+//
+//  CallStatsCollector.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 30/05/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <libkern/OSAtomic.h>
+#import <SocialCommunication/SocialCommunication.h>
+#import <SocialCommunication/RTPVideoHandler.h>
+#import <SocialCommunication/DDXMLElement.h>
+#import <SocialCommunication/debug.h>
+
+#import "CallStatsCollector.h"
+#import "CallHandoverMonitor.h"
+#import "EncoderLoadController.h"
+#import "KeyframePolicy.h"
+#import "RTPVideoHandler+EncoderMeasurements.h"
+
+#define SAMPLE_INTERVAL     1.0
+
+@interface CallStatsCollector () {
+    volatile int32_t    connectionStalls, videoStalls, encoderAdjustments;
+    NSUInteger          keyframeRecoveriesAtStart, handoversAtStart, lastHandoverCount;
+    CFAbsoluteTime      callStart, callEnd, connectionStallStart;
+}
+
+@property(nonatomic, readwrite) CallStatsHistogram *encodeTime;
+@property(nonatomic, readwrite) CallStatsHistogram *sendFrameRate;
+@property(nonatomic, readwrite) CallStatsHistogram *receiveFrameRate;
+@property(nonatomic, readwrite) CallStatsHistogram *connectionQuality;
+@property(nonatomic, readwrite) CallStatsHistogram *stallDuration;
+@property(nonatomic, readwrite) CallStatsHistogram *handoverGap;
+@property(nonatomic, strong) NSTimer *sampleTimer;
+
+// Written on the main thread only, replaced as a whole on every sample
+@property(atomic, strong) NSDictionary *videoInfo;
+@property(atomic, strong) NSArray *streams;
+
+@end
+
+@implementation CallStatsCollector
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.encodeTime = [[CallStatsHistogram alloc] initWithUnit:@"ms"];
+        self.sendFrameRate = [[CallStatsHistogram alloc] initWithUnit:@"fps"];
+        self.receiveFrameRate = [[CallStatsHistogram alloc] initWithUnit:@"fps"];
+        self.connectionQuality = [[CallStatsHistogram alloc] initWithUnit:@""];
+        self.stallDuration = [[CallStatsHistogram alloc] initWithUnit:@"ms"];
+        self.handoverGap = [[CallStatsHistogram alloc] initWithUnit:@"ms"];
+    }
+    return self;
+}
+
+-(NSArray *) histograms
+{
+    return @[self.encodeTime, self.sendFrameRate, self.receiveFrameRate, self.connectionQuality, self.stallDuration, self.handoverGap];
+}
+
+-(void) start
+{
+    [self stop];
+
+    for (CallStatsHistogram *histogram in [self histograms]) {
+        [histogram reset];
+    }
+
+    connectionStalls = 0;
+    videoStalls = 0;
+    encoderAdjustments = 0;
+    keyframeRecoveriesAtStart = [KeyframePolicy instance].recoveryCount;
+    handoversAtStart = lastHandoverCount = [CallHandoverMonitor instance].handoverCount;
+    callStart = CFAbsoluteTimeGetCurrent();
+    callEnd = 0;
+    connectionStallStart = 0;
+    self.videoInfo = nil;
+    self.streams = nil;
+
+    NSNotificationCenter *nc = [NSNotificationCenter defaultCenter];
+    [nc addObserver:self selector:@selector(connectionStalling:) name:@"C2Call:ConnectionStalling" object:nil];
+    [nc addObserver:self selector:@selector(connectionResume:) name:@"C2Call:ConnectionResume" object:nil];
+    [nc addObserver:self selector:@selector(videoStalling:) name:@"C2Call:VideoStalling" object:nil];
+    [nc addObserver:self selector:@selector(encoderAdjusted:) name:EncoderLoadControllerDidAdjustNotification object:nil];
+
+    self.sampleTimer = [NSTimer scheduledTimerWithTimeInterval:SAMPLE_INTERVAL target:self selector:@selector(sample:) userInfo:nil repeats:YES];
+}
+
+-(void) stop
+{
+    if (!self.sampleTimer)
+        return;
+
+    [self sample:nil];
+
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [self.sampleTimer invalidate];
+    self.sampleTimer = nil;
+    callEnd = CFAbsoluteTimeGetCurrent();
+}
+
+#pragma mark Sampling
+
+-(void) sample:(NSTimer *) timer
+{
+    CallHandoverMonitor *monitor = [CallHandoverMonitor instance];
+    if (monitor.handoverCount != lastHandoverCount && !monitor.handoverInProgress) {
+        lastHandoverCount = monitor.handoverCount;
+        [self.handoverGap addValue:monitor.lastHandoverGap * 1000.];
+    }
+
+    RTPVideoHandler *handler = [RTPVideoHandler videoHandler];
+    if (!handler || ![handler isActive] || handler.disposed)
+        return;
+
+    // Measured by the encoder, independent of the state of EncoderLoadController
+    int frameRate = [handler frameRate];
+    NSTimeInterval encodingTime = [handler measuredEncodingTime];
+    if (encodingTime > 0.)
+        [self.encodeTime addValue:encodingTime * 1000.];
+
+    [self.sendFrameRate addValue:[handler fpsWrite]];
+    [self.receiveFrameRate addValue:[handler fpsRead]];
+    [self.connectionQuality addValue:handler.connectionQuality];
+
+    self.videoInfo = @{@"receiveResolution" : [handler currentReceiveRes] ? [handler currentReceiveRes] : @"",
+                       @"sendResolution" : [handler currentSendRes] ? [handler currentSendRes] : @"",
+                       @"frameRate" : @(frameRate),
+                       @"keyframeDistance" : @([handler keyframeDistance])};
+
+    NSMutableArray *streamList = [NSMutableArray array];
+    for (VStream *stream in [handler.vstreams copy]) {
+        NSMutableDictionary *info = [NSMutableDictionary dictionary];
+        info[@"ssrc"] = @(stream.ssrc);
+        info[@"active"] = @([handler isStreamActive:stream.ssrc]);
+
+        DDXMLElement *streamInfo = [handler streamInfoForSsrc:stream.ssrc];
+        if (streamInfo)
+            info[@"info"] = [streamInfo XMLString];
+
+        [streamList addObject:info];
+    }
+    self.streams = streamList;
+}
+
+-(void) connectionStalling:(NSNotification *) notification
+{
+    OSAtomicIncrement32(&connectionStalls);
+    if (connectionStallStart == 0)
+        connectionStallStart = CFAbsoluteTimeGetCurrent();
+}
+
+-(void) connectionResume:(NSNotification *) notification
+{
+    if (connectionStallStart > 0)
+        [self.stallDuration addValue:(CFAbsoluteTimeGetCurrent() - connectionStallStart) * 1000.];
+
+    connectionStallStart = 0;
+}
+
+-(void) videoStalling:(NSNotification *) notification
+{
+    OSAtomicIncrement32(&videoStalls);
+}
+
+-(void) encoderAdjusted:(NSNotification *) notification
+{
+    OSAtomicIncrement32(&encoderAdjustments);
+}
+
+#pragma mark Snapshot
+
+-(NSDictionary *) snapshot
+{
+    CFAbsoluteTime end = callEnd > 0 ? callEnd : CFAbsoluteTimeGetCurrent();
+    NSMutableDictionary *stats = [NSMutableDictionary dictionary];
+
+    stats[@"timestamp"] = @([[NSDate date] timeIntervalSince1970]);
+    stats[@"duration"] = @(callStart > 0 ? end - callStart : 0.);
+
+    NSString *remoteParty = [[C2CallPhone currentPhone] remotePartyInActiveCall];
+    if (remoteParty)
+        stats[@"remoteParty"] = remoteParty;
+
+    stats[@"counters"] = @{@"connectionStalls" : @(connectionStalls),
+                           @"videoStalls" : @(videoStalls),
+                           @"encoderAdjustments" : @(encoderAdjustments),
+                           @"keyframeRecoveries" : @([KeyframePolicy instance].recoveryCount - keyframeRecoveriesAtStart),
+                           @"handovers" : @([CallHandoverMonitor instance].handoverCount - handoversAtStart)};
+
+    stats[@"histograms"] = @{@"encodeTime" : [self.encodeTime snapshot],
+                             @"sendFrameRate" : [self.sendFrameRate snapshot],
+                             @"receiveFrameRate" : [self.receiveFrameRate snapshot],
+                             @"connectionQuality" : [self.connectionQuality snapshot],
+                             @"stallDuration" : [self.stallDuration snapshot],
+                             @"handoverGap" : [self.handoverGap snapshot]};
+
+    NSDictionary *videoInfo = self.videoInfo;
+    if (videoInfo)
+        stats[@"video"] = videoInfo;
+
+    NSArray *streams = self.streams;
+    if (streams)
+        stats[@"streams"] = streams;
+
+    return stats;
+}
+
+-(NSData *) JSONSnapshot
+{
+    NSError *error = nil;
+    NSData *json = [NSJSONSerialization dataWithJSONObject:[self snapshot] options:0 error:&error];
+    if (!json)
+        DLog(@"CallStatsCollector: JSON export failed: %@", error);
+
+    return json;
+}
+
++(CallStatsCollector *) instance
+{
+    static CallStatsCollector *collector = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        collector = [[CallStatsCollector alloc] init];
+    });
+    return collector;
+}
+
+@end
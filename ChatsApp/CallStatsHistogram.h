@@ -0,0 +1,41 @@
+//
+//  CallStatsHistogram.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 30/05/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#define CALLSTATS_HISTOGRAM_BUCKETS     32
+
+/** Lock-free histogram with power of two buckets.
+
+ Bucket 0 counts values below 1, bucket n counts values in [2^(n-1), 2^n).
+ Values can be added from any thread without locking, a snapshot
+ can be taken at any time and is consistent for each counter.
+ */
+@interface CallStatsHistogram : NSObject
+
+/** Unit name reported in the snapshot, e.g. "ms". */
+@property(nonatomic, readonly) NSString *unit;
+
+- (id)initWithUnit:(NSString *) unit;
+
+/** Add a value. Negative values are ignored. */
+-(void) addValue:(double) value;
+
+/** Number of values added. */
+-(int64_t) count;
+
+/** Approximated percentile (0-100) from the bucket boundaries. */
+-(double) percentile:(double) percentile;
+
+/** Snapshot as dictionary with the keys unit, count, mean, min, max, p50, p95 and buckets. */
+-(NSDictionary *) snapshot;
+
+/** Reset all counters. */
+-(void) reset;
+
+@end
@@ -0,0 +1,137 @@
+//
+//  CallStatsHistogram.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 30/05/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <libkern/OSAtomic.h>
+#import <math.h>
+
+#import "CallStatsHistogram.h"
+
+// Sum, min and max are kept in fixed point with 3 decimals
+#define FIXED_POINT_SCALE   1000.
+
+@interface CallStatsHistogram () {
+    volatile int64_t    buckets[CALLSTATS_HISTOGRAM_BUCKETS];
+    volatile int64_t    count, sum, min, max;
+}
+
+@property(nonatomic, readwrite) NSString *unit;
+
+@end
+
+static int bucketForValue(double value)
+{
+    if (value < 1.)
+        return 0;
+
+    int exponent = 0;
+    frexp(value, &exponent);
+    return MIN(exponent, CALLSTATS_HISTOGRAM_BUCKETS - 1);
+}
+
+@implementation CallStatsHistogram
+
+- (id)initWithUnit:(NSString *) unit
+{
+    self = [super init];
+    if (self) {
+        self.unit = unit;
+        [self reset];
+    }
+    return self;
+}
+
+- (id)init
+{
+    return [self initWithUnit:@""];
+}
+
+-(void) addValue:(double) value
+{
+    if (value < 0. || isnan(value))
+        return;
+
+    int64_t fixed = (int64_t) (value * FIXED_POINT_SCALE);
+
+    OSAtomicIncrement64(&buckets[bucketForValue(value)]);
+    OSAtomicAdd64(fixed, &sum);
+
+    int64_t current = min;
+    while (fixed < current && !OSAtomicCompareAndSwap64(current, fixed, &min))
+        current = min;
+
+    current = max;
+    while (fixed > current && !OSAtomicCompareAndSwap64(current, fixed, &max))
+        current = max;
+
+    // Count last, so a snapshot never reports more values than summed up
+    OSAtomicIncrement64Barrier(&count);
+}
+
+-(int64_t) count
+{
+    return count;
+}
+
+-(double) percentile:(double) percentile
+{
+    int64_t total = count;
+    if (total == 0)
+        return 0.;
+
+    int64_t rank = (int64_t) ceil(total * percentile / 100.);
+    int64_t seen = 0;
+    for (int i = 0; i < CALLSTATS_HISTOGRAM_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            // Upper bound of the bucket, limited by the largest value seen
+            double upper = i == 0 ? 1. : ldexp(1., i);
+            return MIN(upper, max / FIXED_POINT_SCALE);
+        }
+    }
+    return max / FIXED_POINT_SCALE;
+}
+
+-(NSDictionary *) snapshot
+{
+    int64_t total = count;
+    OSMemoryBarrier();
+
+    NSMutableArray *bucketList = [NSMutableArray arrayWithCapacity:CALLSTATS_HISTOGRAM_BUCKETS];
+    int last = 0;
+    for (int i = 0; i < CALLSTATS_HISTOGRAM_BUCKETS; i++) {
+        [bucketList addObject:@(buckets[i])];
+        if (buckets[i] > 0)
+            last = i;
+    }
+
+    // Don't report the empty tail
+    NSArray *reported = [bucketList subarrayWithRange:NSMakeRange(0, last + 1)];
+
+    return @{@"unit" : self.unit ? self.unit : @"",
+             @"count" : @(total),
+             @"mean" : @(total > 0 ? sum / FIXED_POINT_SCALE / total : 0.),
+             @"min" : @(total > 0 ? min / FIXED_POINT_SCALE : 0.),
+             @"max" : @(total > 0 ? max / FIXED_POINT_SCALE : 0.),
+             @"p50" : @([self percentile:50.]),
+             @"p95" : @([self percentile:95.]),
+             @"buckets" : reported};
+}
+
+-(void) reset
+{
+    for (int i = 0; i < CALLSTATS_HISTOGRAM_BUCKETS; i++)
+        buckets[i] = 0;
+
+    count = 0;
+    sum = 0;
+    min = INT64_MAX;
+    max = 0;
+    OSMemoryBarrier();
+}
+
+@end
@@ -0,0 +1,92 @@
+//
+//  CallTraceRecorder.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 02/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+typedef enum {
+    CallTraceCallConnected = 1,
+    CallTraceCallHangUp,
+    CallTraceConnectionStalling,
+    CallTraceConnectionResume,
+    CallTraceVideoStalling,
+    CallTraceVideoResume,
+    CallTraceEncoderAdjusted,       // frameRate, resolution, encode load in 1/1000
+    CallTraceStatsSample,           // fpsWrite, fpsRead, connectionQuality
+    CallTraceKeyframeDistance,      // keyframe distance
+    CallTraceHandover               // handover count, gap in ms, 1 if timed out
+} CallTraceEventT;
+
+/** Fixed size trace record, 20 bytes in host byte order. */
+typedef struct {
+    uint32_t    timeOffset;         // ms since trace start
+    uint16_t    type;               // CallTraceEventT
+    uint16_t    reserved;
+    int32_t     values[3];
+} CallTraceRecord;
+
+/** Opt-in recorder for a compact binary trace of a call.
+
+ Call events, encoder setting changes, stalls and a per second media sample are
+ written into a preallocated ring buffer, so recording never allocates during a call.
+ On hang up the ring is written to <traceDirectory>/<timestamp>.ctrace,
+ only the newest maxTraceFiles traces are kept there.
+ Use recordsFromTraceFile: to read a trace back for offline analysis.
+
+ Recording is enabled with the user default "CallTraceEnabled".
+ */
+@interface CallTraceRecorder : NSObject
+
+/** Enables the recorder for the next calls, stored in NSUserDefaults. */
+@property(nonatomic) BOOL enabled;
+
+/** Number of records kept in the ring. Default is 16384. */
+@property(nonatomic) NSUInteger capacity;
+
+/** Directory of the trace files. Default is Library/Caches/CallTraces. */
+@property(nonatomic, copy) NSString *traceDirectory;
+
+/** Number of trace files kept in traceDirectory. Default is 20. */
+@property(nonatomic) NSUInteger maxTraceFiles;
+
+/** Path of the last written trace file. */
+@property(nonatomic, readonly) NSString *lastTracePath;
+
+/** Start a new trace for the call. Does nothing unless enabled. */
+-(void) start;
+
+/** Stop the trace and write it to disk in background. */
+-(void) stopAndFlush;
+
+/** Add a record to the current trace. Can be called from any thread. */
+-(void) recordEvent:(CallTraceEventT) type value:(int32_t) v0 value:(int32_t) v1 value:(int32_t) v2;
+
+/** Write the current trace to a file.
+
+ @param path - The target file
+ @return YES on success
+ */
+-(BOOL) writeTraceToFile:(NSString *) path;
+
+/** Delete all but the newest trace files in a directory.
+
+ @param dir - The trace directory
+ @param count - Number of trace files to keep
+ */
++(void) pruneTraceFilesInDirectory:(NSString *) dir keepingNewest:(NSUInteger) count;
+
+/** Decode a trace file.
+
+ @param path - The trace file
+ @return Array of dictionaries with the keys time (seconds since trace start), type and values, or nil if the file is not a valid trace.
+ */
++(NSArray *) recordsFromTraceFile:(NSString *) path;
+
+/** @return shared instance */
++(CallTraceRecorder *) instance;
+
+@end
@@ -0,0 +1,342 @@
+//
+//  CallTraceRecorder.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 02/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <SocialCommunication/RTPVideoHandler.h>
+#import <SocialCommunication/debug.h>
+
+#import "CallTraceRecorder.h"
+#import "CallHandoverMonitor.h"
+#import "EncoderLoadController.h"
+
+#define SAMPLE_INTERVAL             1.0
+#define DEFAULT_TRACE_CAPACITY      16384
+#define DEFAULT_MAX_TRACE_FILES     20
+#define TRACE_MAGIC                 "CTRC"
+#define TRACE_VERSION               1
+
+static NSString * const CallTraceEnabledKey = @"CallTraceEnabled";
+static void *CallTraceQueueKey = &CallTraceQueueKey;
+
+typedef struct {
+    char        magic[4];
+    uint16_t    version;
+    uint16_t    recordSize;
+    uint32_t    count;
+    uint32_t    reserved;
+    double      startTime;          // CFAbsoluteTime of the trace start
+} CallTraceHeader;
+
+@interface CallTraceRecorder () {
+    CallTraceRecord     *ring;
+    NSUInteger          ringCapacity;
+    int64_t             writeIndex;
+    CFAbsoluteTime      traceStart;
+    BOOL                recording;
+    int                 lastKeyframeDistance;
+    NSUInteger          lastHandoverCount;
+}
+
+@property(nonatomic, strong) dispatch_queue_t queue;
+@property(nonatomic, strong) NSTimer *sampleTimer;
+@property(nonatomic, readwrite) NSString *lastTracePath;
+
+@end
+
+@implementation CallTraceRecorder
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.capacity = DEFAULT_TRACE_CAPACITY;
+        self.maxTraceFiles = DEFAULT_MAX_TRACE_FILES;
+
+        NSString *caches = [NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES) lastObject];
+        self.traceDirectory = [caches stringByAppendingPathComponent:@"CallTraces"];
+        self.queue = dispatch_queue_create("CallTraceRecorder", DISPATCH_QUEUE_SERIAL);
+        dispatch_queue_set_specific(self.queue, CallTraceQueueKey, CallTraceQueueKey, NULL);
+    }
+    return self;
+}
+
+-(void) dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    free(ring);
+}
+
+-(BOOL) enabled
+{
+    return [[NSUserDefaults standardUserDefaults] boolForKey:CallTraceEnabledKey];
+}
+
+-(void) setEnabled:(BOOL) enabled
+{
+    [[NSUserDefaults standardUserDefaults] setBool:enabled forKey:CallTraceEnabledKey];
+}
+
+-(void) performSync:(dispatch_block_t) block
+{
+    if (dispatch_get_specific(CallTraceQueueKey) == CallTraceQueueKey) {
+        block();
+    } else {
+        dispatch_sync(self.queue, block);
+    }
+}
+
+#pragma mark Recording
+
+-(void) start
+{
+    [self stopAndFlush];
+
+    if (!self.enabled || self.capacity == 0)
+        return;
+
+    __block BOOL started = NO;
+    [self performSync:^{
+        // Allocate once, the ring is reused for every call
+        if (!ring || ringCapacity != self.capacity) {
+            free(ring);
+            ringCapacity = self.capacity;
+            ring = calloc(ringCapacity, sizeof(CallTraceRecord));
+            if (!ring) {
+                ringCapacity = 0;
+                return;
+            }
+        }
+
+        writeIndex = 0;
+        traceStart = CFAbsoluteTimeGetCurrent();
+        recording = YES;
+        started = YES;
+    }];
+    if (!started)
+        return;
+
+    lastKeyframeDistance = 0;
+    lastHandoverCount = [CallHandoverMonitor instance].handoverCount;
+
+    NSNotificationCenter *nc = [NSNotificationCenter defaultCenter];
+    [nc addObserver:self selector:@selector(callEvent:) name:@"C2Call:ConnectionStalling" object:nil];
+    [nc addObserver:self selector:@selector(callEvent:) name:@"C2Call:ConnectionResume" object:nil];
+    [nc addObserver:self selector:@selector(callEvent:) name:@"C2Call:VideoStalling" object:nil];
+    [nc addObserver:self selector:@selector(callEvent:) name:@"C2Call:VideoResume" object:nil];
+    [nc addObserver:self selector:@selector(encoderAdjusted:) name:EncoderLoadControllerDidAdjustNotification object:nil];
+
+    self.sampleTimer = [NSTimer scheduledTimerWithTimeInterval:SAMPLE_INTERVAL target:self selector:@selector(sample:) userInfo:nil repeats:YES];
+
+    [self recordEvent:CallTraceCallConnected value:0 value:0 value:0];
+}
+
+-(void) stopAndFlush
+{
+    // The hang up record and the snapshot of the ring are taken on the queue,
+    // so no record from another thread can land in between or after them
+    __block NSData *trace = nil;
+    [self performSync:^{
+        if (!recording)
+            return;
+
+        [self recordEvent:CallTraceCallHangUp value:0 value:0 value:0];
+        recording = NO;
+        trace = [self traceData];
+    }];
+    if (!trace)
+        return;
+
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [self.sampleTimer invalidate];
+    self.sampleTimer = nil;
+
+    NSString *dir = self.traceDirectory;
+    NSString *name = [NSString stringWithFormat:@"%.0f.ctrace", [[NSDate date] timeIntervalSince1970]];
+    NSString *path = [dir stringByAppendingPathComponent:name];
+    self.lastTracePath = path;
+
+    NSUInteger maxTraceFiles = self.maxTraceFiles;
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+        [[NSFileManager defaultManager] createDirectoryAtPath:dir withIntermediateDirectories:YES attributes:nil error:nil];
+        if (![trace writeToFile:path atomically:YES])
+            DLog(@"CallTraceRecorder: failed to write %@", path);
+
+        [CallTraceRecorder pruneTraceFilesInDirectory:dir keepingNewest:maxTraceFiles];
+    });
+}
+
+-(void) recordEvent:(CallTraceEventT) type value:(int32_t) v0 value:(int32_t) v1 value:(int32_t) v2
+{
+    // A synchronous block lives on the stack, recording still does not allocate
+    [self performSync:^{
+        if (!recording)
+            return;
+
+        // Taken on the queue, a record waiting behind a restart must not predate traceStart
+        CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+        CallTraceRecord *record = &ring[writeIndex % ringCapacity];
+        writeIndex++;
+
+        record->timeOffset = (uint32_t) ((now - traceStart) * 1000.);
+        record->type = (uint16_t) type;
+        record->reserved = 0;
+        record->values[0] = v0;
+        record->values[1] = v1;
+        record->values[2] = v2;
+    }];
+}
+
+-(void) callEvent:(NSNotification *) notification
+{
+    NSString *name = [notification name];
+    CallTraceEventT type;
+    if ([name isEqualToString:@"C2Call:ConnectionStalling"]) {
+        type = CallTraceConnectionStalling;
+    } else if ([name isEqualToString:@"C2Call:ConnectionResume"]) {
+        type = CallTraceConnectionResume;
+    } else if ([name isEqualToString:@"C2Call:VideoStalling"]) {
+        type = CallTraceVideoStalling;
+    } else {
+        type = CallTraceVideoResume;
+    }
+    [self recordEvent:type value:0 value:0 value:0];
+}
+
+-(void) encoderAdjusted:(NSNotification *) notification
+{
+    NSDictionary *info = [notification userInfo];
+    [self recordEvent:CallTraceEncoderAdjusted
+                value:[info[@"FrameRate"] intValue]
+                value:[info[@"Resolution"] intValue]
+                value:(int32_t) ([info[@"EncodeLoad"] doubleValue] * 1000.)];
+}
+
+-(void) sample:(NSTimer *) timer
+{
+    CallHandoverMonitor *monitor = [CallHandoverMonitor instance];
+    if (monitor.handoverCount != lastHandoverCount && !monitor.handoverInProgress) {
+        lastHandoverCount = monitor.handoverCount;
+        [self recordEvent:CallTraceHandover value:(int32_t) lastHandoverCount value:(int32_t) (monitor.lastHandoverGap * 1000.) value:monitor.lastHandoverTimedOut ? 1 : 0];
+    }
+
+    RTPVideoHandler *handler = [RTPVideoHandler videoHandler];
+    if (!handler || ![handler isActive] || handler.disposed)
+        return;
+
+    [self recordEvent:CallTraceStatsSample value:[handler fpsWrite] value:[handler fpsRead] value:handler.connectionQuality];
+
+    int keyframeDistance = [handler keyframeDistance];
+    if (keyframeDistance != lastKeyframeDistance) {
+        lastKeyframeDistance = keyframeDistance;
+        [self recordEvent:CallTraceKeyframeDistance value:keyframeDistance value:0 value:0];
+    }
+}
+
+#pragma mark Trace File
+
+-(NSData *) traceData
+{
+    int64_t written = writeIndex;
+    NSUInteger count = (NSUInteger) MIN(written, (int64_t) ringCapacity);
+    NSUInteger first = written > (int64_t) ringCapacity ? (NSUInteger) (written % ringCapacity) : 0;
+
+    CallTraceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, 4);
+    header.version = TRACE_VERSION;
+    header.recordSize = sizeof(CallTraceRecord);
+    header.count = (uint32_t) count;
+    header.startTime = traceStart;
+
+    NSMutableData *data = [NSMutableData dataWithCapacity:sizeof(header) + count * sizeof(CallTraceRecord)];
+    [data appendBytes:&header length:sizeof(header)];
+
+    // Oldest record first
+    NSUInteger tail = MIN(count, ringCapacity - first);
+    [data appendBytes:&ring[first] length:tail * sizeof(CallTraceRecord)];
+    if (tail < count)
+        [data appendBytes:ring length:(count - tail) * sizeof(CallTraceRecord)];
+
+    return data;
+}
+
+-(BOOL) writeTraceToFile:(NSString *) path
+{
+    __block NSData *trace = nil;
+    [self performSync:^{
+        if (ring)
+            trace = [self traceData];
+    }];
+
+    return [trace writeToFile:path atomically:YES];
+}
+
++(void) pruneTraceFilesInDirectory:(NSString *) dir keepingNewest:(NSUInteger) count
+{
+    NSFileManager *fm = [NSFileManager defaultManager];
+    NSURL *url = [NSURL fileURLWithPath:dir isDirectory:YES];
+    NSArray *files = [fm contentsOfDirectoryAtURL:url includingPropertiesForKeys:@[NSURLContentModificationDateKey] options:NSDirectoryEnumerationSkipsHiddenFiles error:nil];
+
+    NSMutableArray *traces = [NSMutableArray arrayWithCapacity:[files count]];
+    for (NSURL *file in files) {
+        if ([[file pathExtension] isEqualToString:@"ctrace"])
+            [traces addObject:file];
+    }
+    if ([traces count] <= count)
+        return;
+
+    // Newest first
+    [traces sortUsingComparator:^NSComparisonResult(NSURL *a, NSURL *b) {
+        NSDate *dateA = nil, *dateB = nil;
+        [a getResourceValue:&dateA forKey:NSURLContentModificationDateKey error:nil];
+        [b getResourceValue:&dateB forKey:NSURLContentModificationDateKey error:nil];
+        return [dateB compare:dateA];
+    }];
+
+    for (NSUInteger i = count; i < [traces count]; i++) {
+        NSError *error = nil;
+        if (![fm removeItemAtURL:traces[i] error:&error])
+            DLog(@"CallTraceRecorder: failed to remove %@: %@", [traces[i] lastPathComponent], error);
+    }
+}
+
++(NSArray *) recordsFromTraceFile:(NSString *) path
+{
+    NSData *data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:nil];
+    if ([data length] < sizeof(CallTraceHeader))
+        return nil;
+
+    CallTraceHeader header;
+    [data getBytes:&header length:sizeof(header)];
+    if (memcmp(header.magic, TRACE_MAGIC, 4) != 0 || header.version != TRACE_VERSION || header.recordSize != sizeof(CallTraceRecord))
+        return nil;
+
+    if ([data length] < sizeof(header) + (NSUInteger) header.count * sizeof(CallTraceRecord))
+        return nil;
+
+    const CallTraceRecord *records = (const CallTraceRecord *) ((const char *) [data bytes] + sizeof(header));
+    NSMutableArray *result = [NSMutableArray arrayWithCapacity:header.count];
+    for (uint32_t i = 0; i < header.count; i++) {
+        const CallTraceRecord *record = &records[i];
+        [result addObject:@{@"time" : @(record->timeOffset / 1000.),
+                            @"type" : @(record->type),
+                            @"values" : @[@(record->values[0]), @(record->values[1]), @(record->values[2])]}];
+    }
+    return result;
+}
+
++(CallTraceRecorder *) instance
+{
+    static CallTraceRecorder *recorder = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        recorder = [[CallTraceRecorder alloc] init];
+    });
+    return recorder;
+}
+
+@end
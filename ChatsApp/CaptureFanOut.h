@@ -0,0 +1,73 @@
+//
+//  CaptureFanOut.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 06/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <AVFoundation/AVFoundation.h>
+
+typedef enum {
+    CaptureDropIfBusy,          // Drop frames while the consumer is still processing
+    CaptureKeepLatest           // Keep the latest frame and deliver it when the consumer is done
+} CaptureDropPolicyT;
+
+/** Converts a frame into the format requested by a consumer, returns a retained sample buffer or NULL. */
+typedef CMSampleBufferRef (^CaptureFrameConverter)(CMSampleBufferRef sampleBuffer);
+
+/** Broadcast hub for captured video frames.
+
+ SCMediaManager accepts only two AVCaptureVideoDataOutputSampleBufferDelegate, one of them is used by the
+ video call itself. The fan out registers as a single delegate and hands every captured frame to any number
+ of consumers, e.g. preview, recorder or image filters.
+
+ The sample buffer is passed on retained, not copied. Every consumer is called on its own serial queue with
+ its own frame rate limit and drop policy, so a slow consumer never delays the capture or other consumers.
+ A consumer may request a different pixel format with a converter, frames are converted only once per
+ format and shared between all consumers requesting that format.
+
+ The capture session runs out of buffers when too many frames are held, so the number of frames retained
+ for delivery over all consumers is limited by maxRetainedFrames.
+ */
+@interface CaptureFanOut : NSObject<AVCaptureVideoDataOutputSampleBufferDelegate>
+
+/** Maximum number of frames retained for delivery or pending over all consumers. Default is 4. */
+@property(nonatomic) int maxRetainedFrames;
+
+/** Add a consumer receiving the captured frames as they are.
+
+ Adding a registered consumer again replaces its settings.
+
+ @param consumer - The consumer, held weakly
+ @param maxFrameRate - Maximum frames per second delivered to the consumer, 0 for no limit
+ @param dropPolicy - What to do with frames while the consumer is busy
+ @return NO if the capture delegate could not be registered with SCMediaManager
+ */
+-(BOOL) addConsumer:(id<AVCaptureVideoDataOutputSampleBufferDelegate>) consumer maxFrameRate:(int) maxFrameRate dropPolicy:(CaptureDropPolicyT) dropPolicy;
+
+/** Add a consumer receiving the captured frames in a different pixel format.
+
+ @param consumer - The consumer, held weakly
+ @param maxFrameRate - Maximum frames per second delivered to the consumer, 0 for no limit
+ @param dropPolicy - What to do with frames while the consumer is busy
+ @param pixelFormat - The requested pixel format
+ @param converter - Converter into the requested pixel format, called only for frames in a different format
+ @return NO if the capture delegate could not be registered with SCMediaManager
+ */
+-(BOOL) addConsumer:(id<AVCaptureVideoDataOutputSampleBufferDelegate>) consumer maxFrameRate:(int) maxFrameRate dropPolicy:(CaptureDropPolicyT) dropPolicy pixelFormat:(OSType) pixelFormat converter:(CaptureFrameConverter) converter;
+
+/** Remove a consumer. The capture delegate is removed with the last consumer. */
+-(void) removeConsumer:(id<AVCaptureVideoDataOutputSampleBufferDelegate>) consumer;
+
+/** Number of registered consumers. */
+-(NSUInteger) numberOfConsumers;
+
+/** Frames dropped for a consumer by rate limit or drop policy. */
+-(NSUInteger) droppedFramesForConsumer:(id<AVCaptureVideoDataOutputSampleBufferDelegate>) consumer;
+
+/** @return shared instance */
++(CaptureFanOut *) instance;
+
+@end
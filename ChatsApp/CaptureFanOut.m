@@ -0,0 +1,313 @@
+//
+//  CaptureFanOut.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 06/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <libkern/OSAtomic.h>
+#import <SocialCommunication/SCMediaManager.h>
+#import <SocialCommunication/debug.h>
+
+#import "CaptureFanOut.h"
+
+#define DEFAULT_MAX_RETAINED_FRAMES     4
+
+@interface CaptureFanOut ()
+
+-(void) releaseFrame:(CMSampleBufferRef) frame;
+
+@end
+
+@interface CaptureConsumer : NSObject {
+@public
+    volatile int32_t    busy;
+    volatile int32_t    dropped;
+    CMSampleBufferRef   pending;
+    CMTime              lastDelivery;
+    BOOL                removed;        // Under @synchronized(entry), no frames are kept or delivered afterwards
+}
+
+@property(nonatomic, weak) CaptureFanOut *fanOut;
+@property(nonatomic, weak) id<AVCaptureVideoDataOutputSampleBufferDelegate> delegate;
+@property(nonatomic, strong) dispatch_queue_t queue;
+@property(nonatomic) int maxFrameRate;
+@property(nonatomic) CaptureDropPolicyT dropPolicy;
+@property(nonatomic) OSType pixelFormat;
+@property(nonatomic, copy) CaptureFrameConverter converter;
+
+@end
+
+@implementation CaptureConsumer
+
+-(void) dealloc
+{
+    // Counted in retainedFrames of the fan out
+    if (pending) {
+        CaptureFanOut *fanOut = self.fanOut;
+        if (fanOut) {
+            [fanOut releaseFrame:pending];
+        } else {
+            CFRelease(pending);
+        }
+    }
+}
+
+@end
+
+@interface CaptureFanOut () {
+    volatile int32_t    retainedFrames;
+}
+
+// Replaced as a whole on every change, so the capture thread can iterate without locking
+@property(atomic, strong) NSArray *consumers;
+
+@end
+
+@implementation CaptureFanOut
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.consumers = @[];
+        self.maxRetainedFrames = DEFAULT_MAX_RETAINED_FRAMES;
+    }
+    return self;
+}
+
+#pragma mark Consumers
+
+-(BOOL) addConsumer:(id<AVCaptureVideoDataOutputSampleBufferDelegate>) consumer maxFrameRate:(int) maxFrameRate dropPolicy:(CaptureDropPolicyT) dropPolicy
+{
+    return [self addConsumer:consumer maxFrameRate:maxFrameRate dropPolicy:dropPolicy pixelFormat:0 converter:nil];
+}
+
+-(BOOL) addConsumer:(id<AVCaptureVideoDataOutputSampleBufferDelegate>) consumer maxFrameRate:(int) maxFrameRate dropPolicy:(CaptureDropPolicyT) dropPolicy pixelFormat:(OSType) pixelFormat converter:(CaptureFrameConverter) converter
+{
+    if (!consumer)
+        return NO;
+
+    CaptureConsumer *entry = [[CaptureConsumer alloc] init];
+    entry.fanOut = self;
+    entry.delegate = consumer;
+    entry.queue = dispatch_queue_create("CaptureFanOut.consumer", DISPATCH_QUEUE_SERIAL);
+    entry.maxFrameRate = maxFrameRate;
+    entry.dropPolicy = dropPolicy;
+    entry.pixelFormat = converter ? pixelFormat : 0;
+    entry.converter = converter;
+    entry->lastDelivery = kCMTimeInvalid;
+
+    // A registered consumer is replaced in place, capture keeps running for it
+    BOOL first = NO;
+    @synchronized(self) {
+        first = [self.consumers count] == 0;
+        self.consumers = [[self consumersWithout:consumer] arrayByAddingObject:entry];
+    }
+
+    if (first && ![[SCMediaManager instance] addVideoDataOutputDelegate:self]) {
+        DLog(@"CaptureFanOut: no capture delegate available, max delegates have been reached");
+
+        @synchronized(self) {
+            NSMutableArray *remaining = [self.consumers mutableCopy];
+            [remaining removeObjectIdenticalTo:entry];
+            self.consumers = remaining;
+        }
+        return NO;
+    }
+    return YES;
+}
+
+// Called with @synchronized(self), discards the frames held for the removed entries
+-(NSArray *) consumersWithout:(id<AVCaptureVideoDataOutputSampleBufferDelegate>) consumer
+{
+    NSMutableArray *remaining = [NSMutableArray arrayWithCapacity:[self.consumers count]];
+    for (CaptureConsumer *entry in self.consumers) {
+        if (entry.delegate != nil && entry.delegate != consumer) {
+            [remaining addObject:entry];
+            continue;
+        }
+
+        @synchronized(entry) {
+            entry->removed = YES;
+            if (entry->pending) {
+                [self releaseFrame:entry->pending];
+                entry->pending = NULL;
+            }
+        }
+    }
+    return remaining;
+}
+
+-(void) removeConsumer:(id<AVCaptureVideoDataOutputSampleBufferDelegate>) consumer
+{
+    BOOL last = NO;
+    @synchronized(self) {
+        NSUInteger count = [self.consumers count];
+        NSArray *remaining = [self consumersWithout:consumer];
+        if ([remaining count] == count)
+            return;
+
+        self.consumers = remaining;
+        last = [remaining count] == 0;
+    }
+
+    if (last)
+        [[SCMediaManager instance] stopVideoCaptureForDelegate:self];
+}
+
+-(NSUInteger) numberOfConsumers
+{
+    return [self.consumers count];
+}
+
+-(NSUInteger) droppedFramesForConsumer:(id<AVCaptureVideoDataOutputSampleBufferDelegate>) consumer
+{
+    for (CaptureConsumer *entry in self.consumers) {
+        if (entry.delegate == consumer)
+            return entry->dropped;
+    }
+    return 0;
+}
+
+#pragma mark Delivery
+
+-(BOOL) retainFrame:(CMSampleBufferRef) frame
+{
+    if (OSAtomicIncrement32Barrier(&retainedFrames) > self.maxRetainedFrames) {
+        OSAtomicDecrement32Barrier(&retainedFrames);
+        return NO;
+    }
+
+    CFRetain(frame);
+    return YES;
+}
+
+-(void) releaseFrame:(CMSampleBufferRef) frame
+{
+    CFRelease(frame);
+    OSAtomicDecrement32Barrier(&retainedFrames);
+}
+
+-(void) deliver:(CMSampleBufferRef) sampleBuffer toConsumer:(CaptureConsumer *) entry output:(AVCaptureOutput *) captureOutput connection:(AVCaptureConnection *) connection
+{
+    // Called with busy set, sampleBuffer is retained for this delivery
+    dispatch_async(entry.queue, ^{
+        CMSampleBufferRef frame = sampleBuffer;
+        while (frame) {
+            // Removed while the frame was queued, the consumer must not be called anymore
+            BOOL removed;
+            @synchronized(entry) {
+                removed = entry->removed;
+            }
+            if (!removed)
+                [entry.delegate captureOutput:captureOutput didOutputSampleBuffer:frame fromConnection:connection];
+            [self releaseFrame:frame];
+
+            @synchronized(entry) {
+                frame = entry->pending;
+                entry->pending = NULL;
+                if (!frame)
+                    entry->busy = 0;
+            }
+        }
+    });
+}
+
+-(void) captureOutput:(AVCaptureOutput *)captureOutput didOutputSampleBuffer:(CMSampleBufferRef)sampleBuffer fromConnection:(AVCaptureConnection *)connection
+{
+    NSArray *consumers = self.consumers;
+    CMTime timestamp = CMSampleBufferGetPresentationTimeStamp(sampleBuffer);
+    CVImageBufferRef imageBuffer = CMSampleBufferGetImageBuffer(sampleBuffer);
+    OSType sourceFormat = imageBuffer ? CVPixelBufferGetPixelFormatType(imageBuffer) : 0;
+
+    // One conversion per requested format and frame
+    NSMutableDictionary *converted = nil;
+
+    for (CaptureConsumer *entry in consumers) {
+        if (!entry.delegate)
+            continue;
+
+        if (entry.maxFrameRate > 0 && CMTIME_IS_VALID(entry->lastDelivery) && CMTIME_IS_VALID(timestamp)) {
+            Float64 elapsed = CMTimeGetSeconds(CMTimeSubtract(timestamp, entry->lastDelivery));
+            if (elapsed >= 0. && elapsed < 1. / entry.maxFrameRate) {
+                OSAtomicIncrement32(&entry->dropped);
+                continue;
+            }
+        }
+
+        CMSampleBufferRef frame = sampleBuffer;
+        if (entry.converter && entry.pixelFormat != sourceFormat) {
+            if (!converted)
+                converted = [NSMutableDictionary dictionary];
+
+            NSNumber *format = @(entry.pixelFormat);
+            id buffer = converted[format];
+            if (!buffer) {
+                CMSampleBufferRef result = entry.converter(sampleBuffer);
+                buffer = result ? (__bridge_transfer id) result : [NSNull null];
+                converted[format] = buffer;
+            }
+
+            if (buffer == [NSNull null])
+                continue;
+
+            frame = (__bridge CMSampleBufferRef) buffer;
+        }
+
+        if (OSAtomicCompareAndSwap32Barrier(0, 1, &entry->busy)) {
+            if ([self retainFrame:frame]) {
+                entry->lastDelivery = timestamp;
+                [self deliver:frame toConsumer:entry output:captureOutput connection:connection];
+                continue;
+            }
+            entry->busy = 0;
+        } else if (entry.dropPolicy == CaptureKeepLatest) {
+            BOOL kept = NO;
+            @synchronized(entry) {
+                // The consumer may have finished or been removed in the meantime
+                if (entry->busy && !entry->removed) {
+                    if (entry->pending) {
+                        // Replacing the pending frame keeps the number of retained frames
+                        CFRelease(entry->pending);
+                        entry->pending = (CMSampleBufferRef) CFRetain(frame);
+                        OSAtomicIncrement32(&entry->dropped);
+                        kept = YES;
+                    } else if ([self retainFrame:frame]) {
+                        entry->pending = frame;
+                        kept = YES;
+                    }
+
+                    if (kept) {
+                        entry->lastDelivery = timestamp;
+                        continue;
+                    }
+                }
+            }
+
+            if (!kept && !entry->busy && OSAtomicCompareAndSwap32Barrier(0, 1, &entry->busy)) {
+                if ([self retainFrame:frame]) {
+                    entry->lastDelivery = timestamp;
+                    [self deliver:frame toConsumer:entry output:captureOutput connection:connection];
+                    continue;
+                }
+                entry->busy = 0;
+            }
+        }
+
+        OSAtomicIncrement32(&entry->dropped);
+    }
+}
+
++(CaptureFanOut *) instance
+{
+    static CaptureFanOut *fanOut = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        fanOut = [[CaptureFanOut alloc] init];
+    });
+    return fanOut;
+}
+
+@end
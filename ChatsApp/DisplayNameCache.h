@@ -0,0 +1,67 @@
+//
+//  DisplayNameCache.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 13/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/** Resolves the display name of a user. */
+typedef NSString *(^DisplayNameResolver)(NSString *userid);
+
+/** Read-mostly cache of display names.
+
+ [C2CallPhone nameForUserid:] is called for every cell, chat bubble and notification and resolves
+ the name through the SDK friend and contact maps each time. DisplayNameCache keeps the resolved
+ names in an immutable dictionary. Readers take the current dictionary and never wait for a writer,
+ writers copy the dictionary, modify the copy and publish it (copy-on-write, RCU style). Equal names
+ share one string instance. Names resolved on cache misses are collected and published together,
+ after a short delay or once their number reaches half of the cached names, so filling a cold cache
+ copies the dictionary a logarithmic number of times instead of once per name. Users the resolver has
+ no name for are cached as well, so an unknown user is not resolved again on every lookup.
+
+ Names are removed when the name, first name, display name or email of a user changes in Core Data,
+ which covers friend updates and changes of the own profile, and when a user is inserted or deleted;
+ inserting a user also removes a cached unknown user.
+ Presence updates do not invalidate names. FriendListController takes the names of its cells from the
+ shared instance.
+ */
+@interface DisplayNameCache : NSObject
+
+/** Resolver for names not in the cache, can be called on any thread. Default is [C2CallPhone nameForUserid:]. */
+@property(nonatomic, copy) DisplayNameResolver resolver;
+
+/** Number of cached names, without the users cached as unknown. */
+@property(nonatomic, readonly) NSUInteger count;
+
+/** Number of distinct name strings shared by the cached names. */
+@property(nonatomic, readonly) NSUInteger internedCount;
+
+/** Display name of a user, resolved and cached on first use. Can be called on any thread.
+
+ @param userid - The user
+ @return Display name or nil
+ */
+-(NSString *) nameForUserid:(NSString *) userid;
+
+/** Resolve and cache the names of several users with a single update.
+
+ @param userids - The users
+ */
+-(void) prefetchUserids:(NSArray *) userids;
+
+/** Remove users from the cache. */
+-(void) invalidateUserids:(NSArray *) userids;
+
+/** Remove all users from the cache. */
+-(void) invalidateAll;
+
+/** Prefetch the friends and observe user changes in Core Data. */
+-(void) start;
+
+/** @return shared instance */
++(DisplayNameCache *) instance;
+
+@end
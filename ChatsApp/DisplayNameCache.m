@@ -0,0 +1,259 @@
+//
+//  DisplayNameCache.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 13/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <CoreData/CoreData.h>
+#import <SocialCommunication/C2CallPhone.h>
+#import <SocialCommunication/SCFriendList.h>
+#import <SocialCommunication/MOC2CallUser.h>
+
+#import "DisplayNameCache.h"
+
+// Names resolved on a cache miss are published together, after this delay or once enough have been resolved
+#define PUBLISH_DELAY       0.05
+#define MIN_PUBLISH_BATCH   32
+
+@interface DisplayNameCache ()
+
+// Immutable, replaced as a whole by writers. NSNull for users the resolver has no name for.
+@property(atomic, strong) NSDictionary *names;
+
+// Writers only, under the writer lock
+@property(nonatomic, strong) NSMutableDictionary *internedNames;
+@property(nonatomic, strong) NSMutableDictionary *pendingNames;
+@property(nonatomic) BOOL publishScheduled;
+
+// Incremented on invalidation, names resolved before are not published
+@property(atomic) NSUInteger generation;
+@property(nonatomic) BOOL observingChanges;
+
+@end
+
+@implementation DisplayNameCache
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.names = [NSDictionary dictionary];
+        self.internedNames = [NSMutableDictionary dictionary];
+        self.pendingNames = [NSMutableDictionary dictionary];
+        self.resolver = ^NSString *(NSString *userid) {
+            return [[C2CallPhone currentPhone] nameForUserid:userid];
+        };
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+-(NSUInteger) count
+{
+    @synchronized(self) {
+        [self publishPendingNames];
+    }
+
+    NSDictionary *names = self.names;
+    return [[names keysOfEntriesPassingTest:^BOOL(id key, id name, BOOL *stop) {
+        return name != [NSNull null];
+    }] count];
+}
+
+-(NSUInteger) internedCount
+{
+    @synchronized(self) {
+        [self publishPendingNames];
+        return [self.internedNames count];
+    }
+}
+
+#pragma mark Lookup
+
+-(NSString *) nameOrNil:(id) name
+{
+    return name == [NSNull null] ? nil : name;
+}
+
+-(NSString *) nameForUserid:(NSString *) userid
+{
+    if (!userid)
+        return nil;
+
+    id name = self.names[userid];
+    if (name)
+        return [self nameOrNil:name];
+
+    // Resolved by another reader and not published yet
+    NSUInteger generation = 0;
+    @synchronized(self) {
+        name = self.pendingNames[userid];
+        generation = self.generation;
+    }
+    if (name)
+        return [self nameOrNil:name];
+
+    DisplayNameResolver resolver = self.resolver;
+    if (!resolver)
+        return nil;
+
+    // A user without name is cached as well, until the user is inserted or changed
+    NSString *resolved = resolver(userid);
+    [self addNames:@{userid : resolved ?: [NSNull null]} generation:generation publish:NO];
+    return resolved;
+}
+
+-(void) prefetchUserids:(NSArray *) userids
+{
+    DisplayNameResolver resolver = self.resolver;
+    if (!resolver)
+        return;
+
+    NSUInteger generation = self.generation;
+    NSDictionary *names = self.names;
+    NSMutableDictionary *resolved = [NSMutableDictionary dictionaryWithCapacity:[userids count]];
+    for (NSString *userid in userids) {
+        if (names[userid] || resolved[userid])
+            continue;
+
+        resolved[userid] = resolver(userid) ?: [NSNull null];
+    }
+
+    if ([resolved count] > 0)
+        [self addNames:resolved generation:generation publish:YES];
+}
+
+#pragma mark Update
+
+-(void) addNames:(NSDictionary *) added generation:(NSUInteger) generation publish:(BOOL) publish
+{
+    @synchronized(self) {
+        // Invalidated while resolving, the names may be stale
+        if (generation != self.generation)
+            return;
+
+        [self.pendingNames addEntriesFromDictionary:added];
+
+        // Every publish copies all names, the batch grows with the cache so that a cold start stays linear
+        if (publish || [self.pendingNames count] >= MAX(MIN_PUBLISH_BATCH, [self.names count] / 2)) {
+            [self publishPendingNames];
+        } else if (!self.publishScheduled) {
+            self.publishScheduled = YES;
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(PUBLISH_DELAY * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                @synchronized(self) {
+                    [self publishPendingNames];
+                }
+            });
+        }
+    }
+}
+
+-(void) publishPendingNames
+{
+    // Under the writer lock
+    self.publishScheduled = NO;
+    if ([self.pendingNames count] == 0)
+        return;
+
+    NSMutableDictionary *names = [self.names mutableCopy];
+    [self.pendingNames enumerateKeysAndObjectsUsingBlock:^(NSString *userid, id name, BOOL *stop) {
+        if (name == [NSNull null]) {
+            names[userid] = name;
+            return;
+        }
+
+        NSString *interned = self.internedNames[name];
+        if (!interned) {
+            interned = [name copy];
+            self.internedNames[interned] = interned;
+        }
+        names[userid] = interned;
+    }];
+    [self.pendingNames removeAllObjects];
+    self.names = [names copy];
+}
+
+-(void) invalidateUserids:(NSArray *) userids
+{
+    if ([userids count] == 0)
+        return;
+
+    @synchronized(self) {
+        [self.pendingNames removeObjectsForKeys:userids];
+        [self publishPendingNames];
+
+        NSMutableDictionary *names = [self.names mutableCopy];
+        [names removeObjectsForKeys:userids];
+        self.names = [names copy];
+        self.generation++;
+
+        // Drop the strings no longer used by any user, the remaining values are the interned instances
+        NSMutableArray *used = [NSMutableArray arrayWithArray:[names allValues]];
+        [used removeObject:[NSNull null]];
+        self.internedNames = [NSMutableDictionary dictionaryWithObjects:used forKeys:used];
+    }
+}
+
+-(void) invalidateAll
+{
+    @synchronized(self) {
+        self.names = [NSDictionary dictionary];
+        [self.pendingNames removeAllObjects];
+        [self.internedNames removeAllObjects];
+        self.generation++;
+    }
+}
+
+-(void) objectsDidChange:(NSNotification *) notification
+{
+    NSMutableArray *userids = [NSMutableArray array];
+    NSSet *nameKeys = [NSSet setWithObjects:@"name", @"firstname", @"displayName", @"email", nil];
+
+    for (id object in notification.userInfo[NSUpdatedObjectsKey]) {
+        if (![object isKindOfClass:[MOC2CallUser class]])
+            continue;
+
+        MOC2CallUser *user = object;
+        NSSet *changedKeys = [NSSet setWithArray:[[user changedValuesForCurrentEvent] allKeys]];
+        if (user.userid && [changedKeys intersectsSet:nameKeys])
+            [userids addObject:user.userid];
+    }
+
+    // A name resolved before the user was inserted is the fallback for an unknown user
+    for (NSString *key in @[NSInsertedObjectsKey, NSDeletedObjectsKey]) {
+        for (id object in notification.userInfo[key]) {
+            if ([object isKindOfClass:[MOC2CallUser class]] && [(MOC2CallUser *) object userid])
+                [userids addObject:[(MOC2CallUser *) object userid]];
+        }
+    }
+
+    [self invalidateUserids:userids];
+}
+
+-(void) start
+{
+    if (!self.observingChanges) {
+        self.observingChanges = YES;
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(objectsDidChange:) name:NSManagedObjectContextObjectsDidChangeNotification object:nil];
+    }
+
+    [self prefetchUserids:[[SCFriendList instance] listFriendsUserids]];
+}
+
++(DisplayNameCache *) instance
+{
+    static DisplayNameCache *cache = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        cache = [[DisplayNameCache alloc] init];
+    });
+    return cache;
+}
+
+@end
@@ -0,0 +1,61 @@
+//
+//  EncoderLoadController.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 28/05/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/** Will be posted on every encoder setting change.
+
+ The userInfo dictionary contains the keys FrameRate, Resolution and EncodeLoad.
+ */
+extern NSString * const EncoderLoadControllerDidAdjustNotification;
+
+/** Closed-loop controller for the video encoder load during a video call.
+
+ Once per second the average encoding time per frame is compared with the frame interval.
+ If encoding takes more than highLoad of the frame interval for several samples, or the
+ send frame rate falls clearly below the configured rate, the encoder is stepped down:
+ first the frame rate, down to minFrameRate, then the capture resolution.
+ When the load stays below lowLoad for a longer period, the settings are stepped up again.
+
+ The initial frame rate is chosen from the number of CPU cores, so weak devices start
+ at a rate they can sustain.
+
+ The encoding time and the resolution index are read from SDK instance variables, see
+ RTPVideoHandler (EncoderMeasurements) for the assumptions made about them. If an SDK version
+ renames them, the load is judged from the send frame rate alone and the resolution is left unchanged.
+ */
+@interface EncoderLoadController : NSObject
+
+/** Load above which the encoder is stepped down. Default is 0.8. */
+@property(nonatomic) double highLoad;
+
+/** Load below which the encoder is stepped up again. Default is 0.4. */
+@property(nonatomic) double lowLoad;
+
+/** Lowest frame rate before the resolution is reduced. Default is 8. */
+@property(nonatomic) int minFrameRate;
+
+/** Highest frame rate the controller will step up to. Default is 15 on multi-core devices, 10 else. */
+@property(nonatomic) int maxFrameRate;
+
+/** While suspended the encoder settings are left alone, e.g. during screen sharing. */
+@property(nonatomic) BOOL suspended;
+
+/** Last measured encode load, encoding time per frame / frame interval. */
+@property(nonatomic, readonly) double encodeLoad;
+
+/** Start controlling the encoder of the current video call. */
+-(void) start;
+
+/** Stop controlling the encoder. */
+-(void) stop;
+
+/** @return shared instance */
++(EncoderLoadController *) instance;
+
+@end
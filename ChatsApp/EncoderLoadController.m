@@ -0,0 +1,173 @@
+//
+//  EncoderLoadController.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 28/05/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <SocialCommunication/IOS.h>
+#import <SocialCommunication/debug.h>
+
+#import "EncoderLoadController.h"
+#import "RTPVideoHandler+EncoderMeasurements.h"
+
+NSString * const EncoderLoadControllerDidAdjustNotification = @"EncoderLoadController:DidAdjust";
+
+#define SAMPLE_INTERVAL         1.0
+#define STEP_DOWN_SAMPLES       3
+#define STEP_UP_SAMPLES         10
+#define FRAMERATE_STEP          2
+#define MIN_FPS_RATIO           0.7
+
+@interface EncoderLoadController () {
+    int     highLoadCount, lowLoadCount;
+    int     initialResolution;
+}
+
+@property(nonatomic, strong) NSTimer *sampleTimer;
+@property(nonatomic, readwrite) double encodeLoad;
+
+@end
+
+@implementation EncoderLoadController
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.highLoad = 0.8;
+        self.lowLoad = 0.4;
+        self.minFrameRate = 8;
+        self.maxFrameRate = [IOS numberOfCores] > 1 ? 15 : 10;
+    }
+    return self;
+}
+
+-(void) start
+{
+    [self stop];
+
+    highLoadCount = 0;
+    lowLoadCount = 0;
+    self.encodeLoad = 0.;
+
+    RTPVideoHandler *handler = [RTPVideoHandler videoHandler];
+    initialResolution = [handler measuredResolution];
+    if ([handler frameRate] > self.maxFrameRate)
+        [self applyFrameRate:self.maxFrameRate resolution:-1 forHandler:handler];
+
+    self.sampleTimer = [NSTimer scheduledTimerWithTimeInterval:SAMPLE_INTERVAL target:self selector:@selector(sample:) userInfo:nil repeats:YES];
+}
+
+-(void) stop
+{
+    [self.sampleTimer invalidate];
+    self.sampleTimer = nil;
+}
+
+-(void) setSuspended:(BOOL) suspended
+{
+    _suspended = suspended;
+
+    // Samples from before the suspension say nothing about the current settings
+    highLoadCount = 0;
+    lowLoadCount = 0;
+}
+
+-(void) sample:(NSTimer *) timer
+{
+    if (self.suspended)
+        return;
+
+    RTPVideoHandler *handler = [RTPVideoHandler videoHandler];
+    if (!handler || ![handler isActive] || handler.disposed)
+        return;
+
+    int frameRate = [handler frameRate];
+    if (frameRate <= 0)
+        return;
+
+    double encodingTime = [handler measuredEncodingTime];
+    int fps = [handler fpsWrite];
+
+    BOOL overloaded = NO;
+    if (encodingTime >= 0.) {
+        self.encodeLoad = encodingTime * frameRate;
+        overloaded = self.encodeLoad > self.highLoad;
+    }
+
+    // The capture rate drops as well when the encoder can't keep up
+    if (fps > 0 && fps < frameRate * MIN_FPS_RATIO)
+        overloaded = YES;
+
+    if (overloaded) {
+        lowLoadCount = 0;
+        if (++highLoadCount >= STEP_DOWN_SAMPLES) {
+            highLoadCount = 0;
+            [self stepDown:handler];
+        }
+    } else if (encodingTime >= 0. && self.encodeLoad < self.lowLoad) {
+        highLoadCount = 0;
+        if (++lowLoadCount >= STEP_UP_SAMPLES) {
+            lowLoadCount = 0;
+            [self stepUp:handler];
+        }
+    } else {
+        highLoadCount = 0;
+        lowLoadCount = 0;
+    }
+}
+
+-(void) stepDown:(RTPVideoHandler *) handler
+{
+    int frameRate = [handler frameRate];
+    if (frameRate - FRAMERATE_STEP >= self.minFrameRate) {
+        [self applyFrameRate:frameRate - FRAMERATE_STEP resolution:-1 forHandler:handler];
+        return;
+    }
+
+    // Last resort, reduce the resolution
+    int resolution = [handler measuredResolution];
+    if (resolution > 0)
+        [self applyFrameRate:frameRate resolution:resolution - 1 forHandler:handler];
+}
+
+-(void) stepUp:(RTPVideoHandler *) handler
+{
+    int resolution = [handler measuredResolution];
+    if (resolution < initialResolution) {
+        [self applyFrameRate:[handler frameRate] resolution:resolution + 1 forHandler:handler];
+        return;
+    }
+
+    int frameRate = [handler frameRate];
+    if (frameRate + FRAMERATE_STEP <= self.maxFrameRate)
+        [self applyFrameRate:frameRate + FRAMERATE_STEP resolution:-1 forHandler:handler];
+}
+
+-(void) applyFrameRate:(int) frameRate resolution:(int) resolution forHandler:(RTPVideoHandler *) handler
+{
+    DLog(@"EncoderLoadController: load %.2f -> frameRate %d resolution %d", self.encodeLoad, frameRate, resolution);
+
+    if (frameRate != [handler frameRate])
+        [handler setFrameRate:frameRate];
+
+    if (resolution >= 0)
+        [handler setResolution:resolution];
+
+    NSDictionary *info = @{@"FrameRate" : @(frameRate), @"Resolution" : @(resolution), @"EncodeLoad" : @(self.encodeLoad)};
+    [[NSNotificationCenter defaultCenter] postNotificationName:EncoderLoadControllerDidAdjustNotification object:self userInfo:info];
+}
+
++(EncoderLoadController *) instance
+{
+    static EncoderLoadController *controller = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        controller = [[EncoderLoadController alloc] init];
+    });
+    return controller;
+}
+
+@end
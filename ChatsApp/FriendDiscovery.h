@@ -0,0 +1,107 @@
+//
+//  FriendDiscovery.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 12/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/** Directory the identifiers are looked up in. C2CallPhone conforms via findFriends:. */
+@protocol FriendDiscoveryDirectory <NSObject>
+
+/** Look up phone numbers and email addresses, found users are added to the friend list asynchronously.
+
+ @param identifiers - Phone numbers in international format or email addresses
+ */
+-(void) findFriends:(NSArray *) identifiers;
+
+@end
+
+/** Batched friend lookup with a negative cache.
+
+ Identifiers are normalized in one pass and duplicates are removed. National numbers with the trunk
+ prefix 0 get countryCode instead of the 0, see normalizedIdentifier:countryCode:. Identifiers which belong to a friend already and identifiers
+ looked up within negativeTTL without a friend turning up are skipped, the remaining ones are sent to
+ the directory in batches of batchSize. The lookup times are persisted, so a rescan of an unchanged
+ address book after a restart sends no requests at all. The file is keyed by the 64-bit identifier
+ hash of AddressBookDigest, it holds no phone numbers or email addresses.
+
+ findFriends: has no result, an identifier counts as not registered until a friend with that phone
+ number or email address is added to the friend list. Unlike [C2CallPhone transferAddressBook:],
+ findFriends: sends the identifiers in plain text, so AddressBookSync does not use FriendDiscovery.
+ */
+@interface FriendDiscovery : NSObject
+
+/** Directory for lookups. Default is nil, which uses [C2CallPhone currentPhone] on the main queue. */
+@property(nonatomic, weak) id<FriendDiscoveryDirectory> directory;
+
+/** Country code without + for national numbers, e.g. @"49". Default is the SDK country code setting. */
+@property(nonatomic, strong) NSString *countryCode;
+
+/** Time an identifier without friend is not looked up again. Default is 7 days. */
+@property(nonatomic) NSTimeInterval negativeTTL;
+
+/** Maximum identifiers per request. Default is 100. */
+@property(nonatomic) NSUInteger batchSize;
+
+/** Number of requests sent to the directory. */
+@property(nonatomic, readonly) NSUInteger requestCount;
+
+/** Number of identifiers sent to the directory. */
+@property(nonatomic, readonly) NSUInteger lookupCount;
+
+/** Number of identifiers skipped as invalid, duplicate, friend or cached negative result. */
+@property(nonatomic, readonly) NSUInteger skippedCount;
+
+/** Initialize with the file of the negative cache.
+
+ @param path - Path of the cache file, nil for a memory only cache
+ */
+-(id) initWithPath:(NSString *) path;
+
+/** Look up the identifiers which are neither friends nor cached as not registered.
+
+ @param identifiers - Phone numbers and email addresses in any format
+ @return Number of identifiers sent to the directory
+ */
+-(NSUInteger) discoverIdentifiers:(NSArray *) identifiers;
+
+/** Record identifiers looked up by other means, e.g. the SDK address book transfer.
+
+ They are not looked up again within negativeTTL, unless they belong to a friend by then.
+
+ @param identifiers - Phone numbers and email addresses in any format
+ */
+-(void) cacheIdentifiersAsLookedUp:(NSArray *) identifiers;
+
+/** Mark identifiers as belonging to a friend, they are removed from the negative cache. */
+-(void) addFriendIdentifiers:(NSArray *) identifiers;
+
+/** YES if the identifier has been looked up within negativeTTL without a friend turning up. */
+-(BOOL) isCachedAsUnregistered:(NSString *) identifier;
+
+/** Remove all cached negative results. */
+-(void) invalidateAll;
+
+/** Load the friend identifiers from the friend list and register for added friends. */
+-(void) start;
+
+/** Normalize a phone number or email address.
+
+ This is no numbering plan normalization. Only a national number with the trunk prefix 0, as used in
+ most of Europe, is converted: the 0 is replaced with + and countryCode. National numbers of other
+ plans, e.g. with trunk prefix 1 or 8 or without trunk prefix, are returned as digits only and will
+ not match the international number of a friend.
+
+ @param identifier - Phone number or email address
+ @param countryCode - Country code for national numbers with trunk prefix 0 or nil
+ @return Normalized identifier or nil if it is not a valid identifier
+ */
++(NSString *) normalizedIdentifier:(NSString *) identifier countryCode:(NSString *) countryCode;
+
+/** @return shared instance */
++(FriendDiscovery *) instance;
+
+@end
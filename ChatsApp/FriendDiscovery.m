@@ -0,0 +1,295 @@
+//
+//  FriendDiscovery.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 12/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <SocialCommunication/C2CallConstants.h>
+#import <SocialCommunication/C2CallPhone.h>
+#import <SocialCommunication/SCFriendList.h>
+#import <SocialCommunication/MOC2CallUser.h>
+#import <SocialCommunication/MOPhoneNumber.h>
+#import <SocialCommunication/debug.h>
+
+#import "FriendDiscovery.h"
+#import "AddressBookDigest.h"
+
+#define CACHE_FILE          @"FriendDiscoveryLookups.plist"
+#define LEGACY_CACHE_FILE   @"FriendDiscoveryCache.plist"
+
+static void *FriendDiscoveryQueueKey = &FriendDiscoveryQueueKey;
+
+@interface FriendDiscovery ()
+
+// Accessed on queue only
+@property(nonatomic, strong) dispatch_queue_t queue;
+@property(nonatomic, strong) NSString *path;
+// Lookup times by identifier hash, the file is backed up and must not hold phone numbers or email addresses
+@property(nonatomic, strong) NSMutableDictionary *lookups;
+@property(nonatomic, strong) NSMutableSet *friendIdentifiers;
+@property(nonatomic) BOOL registeredForFriends;
+@property(nonatomic, readwrite) NSUInteger requestCount;
+@property(nonatomic, readwrite) NSUInteger lookupCount;
+@property(nonatomic, readwrite) NSUInteger skippedCount;
+
+@end
+
+@implementation FriendDiscovery
+
+-(id) initWithPath:(NSString *) path
+{
+    self = [super init];
+    if (self) {
+        self.negativeTTL = 7. * 24. * 3600.;
+        self.batchSize = 100;
+
+        NSString *countryCode = [[NSUserDefaults standardUserDefaults] stringForKey:DEFAULT_COUNTRYCODE];
+        self.countryCode = [[countryCode componentsSeparatedByCharactersInSet:[[NSCharacterSet decimalDigitCharacterSet] invertedSet]] componentsJoinedByString:@""];
+
+        self.path = path;
+        self.lookups = path ? [NSMutableDictionary dictionaryWithContentsOfFile:path] : nil;
+        if (!self.lookups)
+            self.lookups = [NSMutableDictionary dictionary];
+
+        self.friendIdentifiers = [NSMutableSet set];
+        self.queue = dispatch_queue_create("FriendDiscovery", DISPATCH_QUEUE_SERIAL);
+        dispatch_queue_set_specific(self.queue, FriendDiscoveryQueueKey, FriendDiscoveryQueueKey, NULL);
+    }
+    return self;
+}
+
+- (id)init
+{
+    return [self initWithPath:nil];
+}
+
+-(void) performSync:(dispatch_block_t) block
+{
+    if (dispatch_get_specific(FriendDiscoveryQueueKey) == FriendDiscoveryQueueKey) {
+        block();
+    } else {
+        dispatch_sync(self.queue, block);
+    }
+}
+
+#pragma mark Negative Cache
+
+-(NSString *) cacheKeyForIdentifier:(NSString *) identifier
+{
+    return [NSString stringWithFormat:@"%016llx", [AddressBookDigest hashOfIdentifier:identifier]];
+}
+
+-(BOOL) isCachedIdentifier:(NSString *) identifier now:(CFAbsoluteTime) now
+{
+    // On queue
+    NSNumber *lookup = self.lookups[[self cacheKeyForIdentifier:identifier]];
+    return lookup && now < [lookup doubleValue] + self.negativeTTL;
+}
+
+-(BOOL) isCachedAsUnregistered:(NSString *) identifier
+{
+    NSString *normalized = [FriendDiscovery normalizedIdentifier:identifier countryCode:self.countryCode];
+    if (!normalized)
+        return NO;
+
+    __block BOOL cached = NO;
+    [self performSync:^{
+        cached = [self isCachedIdentifier:normalized now:CFAbsoluteTimeGetCurrent()];
+    }];
+    return cached;
+}
+
+-(void) save
+{
+    // On queue, expired entries are not written
+    if (!self.path)
+        return;
+
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    NSSet *expired = [self.lookups keysOfEntriesPassingTest:^BOOL(id key, NSNumber *lookup, BOOL *stop) {
+        return now >= [lookup doubleValue] + self.negativeTTL;
+    }];
+    [self.lookups removeObjectsForKeys:[expired allObjects]];
+
+    if (![self.lookups writeToFile:self.path atomically:YES])
+        DLog(@"FriendDiscovery: failed to write %@", self.path);
+}
+
+-(void) invalidateAll
+{
+    [self performSync:^{
+        [self.lookups removeAllObjects];
+        [self save];
+    }];
+}
+
+-(void) addFriendIdentifiers:(NSArray *) identifiers
+{
+    NSMutableArray *normalized = [NSMutableArray arrayWithCapacity:[identifiers count]];
+    for (NSString *identifier in identifiers) {
+        NSString *n = [FriendDiscovery normalizedIdentifier:identifier countryCode:self.countryCode];
+        if (n)
+            [normalized addObject:n];
+    }
+
+    [self performSync:^{
+        [self.friendIdentifiers addObjectsFromArray:normalized];
+
+        NSUInteger count = [self.lookups count];
+        for (NSString *identifier in normalized) {
+            [self.lookups removeObjectForKey:[self cacheKeyForIdentifier:identifier]];
+        }
+        if ([self.lookups count] != count)
+            [self save];
+    }];
+}
+
+-(void) cacheIdentifiersAsLookedUp:(NSArray *) identifiers
+{
+    NSString *countryCode = self.countryCode;
+    NSMutableArray *normalized = [NSMutableArray arrayWithCapacity:[identifiers count]];
+    for (NSString *identifier in identifiers) {
+        NSString *n = [FriendDiscovery normalizedIdentifier:identifier countryCode:countryCode];
+        if (n)
+            [normalized addObject:n];
+    }
+
+    [self performSync:^{
+        NSNumber *now = @(CFAbsoluteTimeGetCurrent());
+        for (NSString *identifier in normalized) {
+            if (![self.friendIdentifiers containsObject:identifier])
+                self.lookups[[self cacheKeyForIdentifier:identifier]] = now;
+        }
+        [self save];
+    }];
+}
+
+#pragma mark Lookup
+
+-(NSUInteger) discoverIdentifiers:(NSArray *) identifiers
+{
+    NSString *countryCode = self.countryCode;
+    NSMutableOrderedSet *normalized = [NSMutableOrderedSet orderedSetWithCapacity:[identifiers count]];
+    for (NSString *identifier in identifiers) {
+        NSString *n = [FriendDiscovery normalizedIdentifier:identifier countryCode:countryCode];
+        if (n)
+            [normalized addObject:n];
+    }
+
+    __block NSUInteger sent = 0;
+    [self performSync:^{
+        CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+        NSMutableArray *lookup = [NSMutableArray arrayWithCapacity:[normalized count]];
+
+        for (NSString *identifier in normalized) {
+            if ([self.friendIdentifiers containsObject:identifier] || [self isCachedIdentifier:identifier now:now])
+                continue;
+
+            [lookup addObject:identifier];
+            self.lookups[[self cacheKeyForIdentifier:identifier]] = @(now);
+        }
+
+        self.skippedCount += [identifiers count] - [lookup count];
+        if ([lookup count] == 0)
+            return;
+
+        NSUInteger batchSize = MAX(1, self.batchSize);
+        for (NSUInteger offset = 0; offset < [lookup count]; offset += batchSize) {
+            [self sendBatch:[lookup subarrayWithRange:NSMakeRange(offset, MIN(batchSize, [lookup count] - offset))]];
+        }
+
+        sent = [lookup count];
+        self.lookupCount += sent;
+        [self save];
+    }];
+
+    DLog(@"FriendDiscovery: %lu of %lu identifiers looked up", (unsigned long) sent, (unsigned long) [identifiers count]);
+    return sent;
+}
+
+-(void) sendBatch:(NSArray *) batch
+{
+    // On queue
+    self.requestCount++;
+
+    id<FriendDiscoveryDirectory> directory = self.directory;
+    if (directory) {
+        [directory findFriends:batch];
+        return;
+    }
+
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [[C2CallPhone currentPhone] findFriends:batch];
+    });
+}
+
+#pragma mark Friends
+
+-(NSArray *) identifiersOfFriend:(MOC2CallUser *) user
+{
+    NSMutableArray *identifiers = [NSMutableArray array];
+    if (user.email)
+        [identifiers addObject:user.email];
+
+    for (MOPhoneNumber *number in user.friendNumbers) {
+        if (number.phoneNumber)
+            [identifiers addObject:number.phoneNumber];
+    }
+    return identifiers;
+}
+
+-(void) start
+{
+    NSMutableArray *identifiers = [NSMutableArray array];
+    for (NSDictionary *info in [[SCFriendList instance] listFriendsInfo]) {
+        for (NSString *key in @[@"Email", @"NT_WORK", @"NT_MOBILE", @"NT_HOME", @"NT_OTHER"]) {
+            if ([info[key] isKindOfClass:[NSString class]])
+                [identifiers addObject:info[key]];
+        }
+    }
+    [self addFriendIdentifiers:identifiers];
+
+    if (!self.registeredForFriends) {
+        self.registeredForFriends = YES;
+
+        __weak FriendDiscovery *weakself = self;
+        [[SCFriendList instance] registerForAddedFriends:^(MOC2CallUser *user) {
+            [weakself addFriendIdentifiers:[weakself identifiersOfFriend:user]];
+        }];
+    }
+}
+
+#pragma mark Static Methods
+
++(NSString *) normalizedIdentifier:(NSString *) identifier countryCode:(NSString *) countryCode
+{
+    NSString *normalized = [AddressBookDigest normalizedIdentifier:identifier];
+    if (!normalized || [countryCode length] == 0)
+        return normalized;
+
+    // Only the trunk prefix 0 is known here, e.g. 030123456 -> +4930123456
+    if ([normalized hasPrefix:@"0"])
+        return [NSString stringWithFormat:@"+%@%@", countryCode, [normalized substringFromIndex:1]];
+
+    return normalized;
+}
+
++(FriendDiscovery *) instance
+{
+    static FriendDiscovery *discovery = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        NSString *directory = [NSSearchPathForDirectoriesInDomains(NSApplicationSupportDirectory, NSUserDomainMask, YES) firstObject];
+        [[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil];
+
+        // Keyed by the plain identifiers, the identifiers are looked up once more instead
+        [[NSFileManager defaultManager] removeItemAtPath:[directory stringByAppendingPathComponent:LEGACY_CACHE_FILE] error:nil];
+
+        discovery = [[FriendDiscovery alloc] initWithPath:[directory stringByAppendingPathComponent:CACHE_FILE]];
+    });
+    return discovery;
+}
+
+@end
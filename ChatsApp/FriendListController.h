@@ -0,0 +1,21 @@
+//
+//  FriendListController.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 12/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <SocialCommunication/SCFriendListController.h>
+
+/** Friend list refreshing presence from PresenceCoalescer.
+
+ SCFriendListController refreshes a row on every change of its MOC2CallUser, presence changes
+ included, and a subclass cannot turn that off. While visible, this controller adds one reload per
+ PresenceCoalescer batch, only for visible rows whose cell still shows an older online status than
+ the batch; rows the SDK has refreshed already are not reloaded again. Rows are found from the visible
+ cells at reload time, so a re-sorted list reloads the right rows. Names are taken from DisplayNameCache.
+ */
+@interface FriendListController : SCFriendListController
+
+@end
@@ -0,0 +1,94 @@
+//
+//  FriendListController.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 12/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <objc/runtime.h>
+#import <SocialCommunication/SCFriendListCell.h>
+#import <SocialCommunication/MOC2CallUser.h>
+
+#import "FriendListController.h"
+#import "PresenceCoalescer.h"
+#import "DisplayNameCache.h"
+
+static char FriendListCellUseridKey;
+static char FriendListCellStatusKey;
+
+@interface FriendListController ()
+
+@property(nonatomic, strong) id presenceToken;
+
+@end
+
+@implementation FriendListController
+
+-(void) viewWillAppear:(BOOL) animated
+{
+    [super viewWillAppear:animated];
+
+    if (!self.presenceToken) {
+        __weak FriendListController *weakself = self;
+        self.presenceToken = [[PresenceCoalescer instance] addHandler:^(NSDictionary *changes) {
+            [weakself reloadRowsForChanges:changes];
+        }];
+    }
+}
+
+-(void) viewDidDisappear:(BOOL) animated
+{
+    [super viewDidDisappear:animated];
+
+    [[PresenceCoalescer instance] removeHandler:self.presenceToken];
+    self.presenceToken = nil;
+}
+
+-(void) dealloc
+{
+    [[PresenceCoalescer instance] removeHandler:self.presenceToken];
+}
+
+-(void) configureCell:(SCFriendListCell *) cell forElement:(MOC2CallUser *) elem atIndexPath:(NSIndexPath *) indexPath
+{
+    [super configureCell:cell forElement:elem atIndexPath:indexPath];
+
+    // Remembered on the cell, index paths go stale when the SDK re-sorts the list
+    objc_setAssociatedObject(cell, &FriendListCellUseridKey, elem.userid, OBJC_ASSOCIATION_COPY_NONATOMIC);
+    objc_setAssociatedObject(cell, &FriendListCellStatusKey, elem.onlineStatus, OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+
+    if (!elem.userid)
+        return;
+
+    NSString *name = [[DisplayNameCache instance] nameForUserid:elem.userid];
+    if (name)
+        cell.labelName.text = name;
+}
+
+-(void) reloadRowsForChanges:(NSDictionary *) changes
+{
+    if (![self isViewLoaded] || !self.view.window)
+        return;
+
+    // Only rows on screen, the others are configured with the current status when scrolled in.
+    // Rows the SDK has refreshed already show the new status and are left alone.
+    NSMutableArray *rows = [NSMutableArray arrayWithCapacity:[changes count]];
+    for (UITableViewCell *cell in [self.tableView visibleCells]) {
+        NSString *userid = objc_getAssociatedObject(cell, &FriendListCellUseridKey);
+        NSNumber *status = userid ? changes[userid] : nil;
+        if (!status || [status isEqual:objc_getAssociatedObject(cell, &FriendListCellStatusKey)])
+            continue;
+
+        NSIndexPath *indexPath = [self.tableView indexPathForCell:cell];
+        if (indexPath && ![rows containsObject:indexPath])
+            [rows addObject:indexPath];
+    }
+
+    if ([rows count] == 0)
+        return;
+
+    [self.tableView reloadRowsAtIndexPaths:rows withRowAnimation:UITableViewRowAnimationNone];
+}
+
+@end
@@ -0,0 +1,71 @@
+//
+//  GroupVideoCompositor.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 07/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <UIKit/UIKit.h>
+
+@class VideoStreamViewController, SCGroupVideoCallController;
+
+/** Renders all participant streams of a group video call in a single GL pass.
+
+ Every remote participant gets its own EAGLViewController in the group video call,
+ so each stream costs its own GL context, upload and present. With a compositor the
+ participant views keep their layout but become plain views without a GL context;
+ their frames are copied to the compositor, which draws all tiles into one drawable
+ and presents once per display refresh, only when at least one tile has a new frame.
+
+ A VideoStreamViewController shown in a SCGroupVideoCallController joins the compositor
+ of that call, see compositorForGroupVideoCall:. The compositor lies above the participant
+ views and does not take touches. Each tile is drawn into the area of its stream view,
+ converted into the compositor coordinates and rotated by the rotate of the stream view.
+
+ The display link only takes the tile layout on the main thread; uploads, drawing and
+ presenting run on a serial render queue, like the uploads of VideoStreamViewController.
+ */
+@interface GroupVideoCompositor : UIView
+
+/** Frames uploaded into tile textures. */
+@property(nonatomic, readonly) NSUInteger uploadedFrames;
+
+/** Frames replaced by a newer frame of the same tile before they were uploaded. */
+@property(nonatomic, readonly) NSUInteger coalescedFrames;
+
+/** Composed frames presented. */
+@property(nonatomic, readonly) NSUInteger presentedFrames;
+
+/** Compositor of a group video call, created and added above the participant views on first use.
+
+ @param controller - The group video call controller
+ @return The compositor, owned by the controller
+ */
++(GroupVideoCompositor *) compositorForGroupVideoCall:(SCGroupVideoCallController *) controller;
+
+/** Add a tile. The stream view is held weakly.
+
+ @param streamView - The participant stream view
+ */
+-(void) addTile:(VideoStreamViewController *) streamView;
+
+/** Remove a tile and release its textures.
+
+ @param streamView - The participant stream view
+ */
+-(void) removeTile:(VideoStreamViewController *) streamView;
+
+/** Set the latest I420 frame of a tile. Can be called from any thread, the data is copied.
+
+ @param data - I420 image data
+ @param width - Image width
+ @param height - Image height
+ @param streamView - The participant stream view
+ */
+-(void) setTextureData:(NSData *) data withWidth:(int) width andHeight:(int) height forTile:(VideoStreamViewController *) streamView;
+
+/** Redraw on the next display refresh, e.g. after the tile layout has changed. */
+-(void) setNeedsCompose;
+
+@end
@@ -0,0 +1,610 @@
+//
+//  GroupVideoCompositor.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 07/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <objc/runtime.h>
+#import <QuartzCore/QuartzCore.h>
+#import <OpenGLES/ES2/gl.h>
+#import <OpenGLES/ES2/glext.h>
+#import <libkern/OSAtomic.h>
+#import <SocialCommunication/SCGroupVideoCallController.h>
+#import <SocialCommunication/debug.h>
+
+#import "GroupVideoCompositor.h"
+#import "VideoStreamViewController.h"
+
+#define ATTRIB_POSITION     0
+#define ATTRIB_TEXCOORD     1
+
+static char GroupVideoCompositorKey;
+
+static const char *vertexShaderSource =
+    "attribute vec4 position;\n"
+    "attribute vec2 texCoord;\n"
+    "varying vec2 coord;\n"
+    "void main() {\n"
+    "    gl_Position = position;\n"
+    "    coord = texCoord;\n"
+    "}\n";
+
+// I420 to RGB, BT.601 video range
+static const char *fragmentShaderSource =
+    "precision mediump float;\n"
+    "varying vec2 coord;\n"
+    "uniform sampler2D texY;\n"
+    "uniform sampler2D texU;\n"
+    "uniform sampler2D texV;\n"
+    "void main() {\n"
+    "    float y = 1.1643 * (texture2D(texY, coord).r - 0.0625);\n"
+    "    float u = texture2D(texU, coord).r - 0.5;\n"
+    "    float v = texture2D(texV, coord).r - 0.5;\n"
+    "    gl_FragColor = vec4(y + 1.5958 * v, y - 0.39173 * u - 0.81290 * v, y + 2.017 * u, 1.0);\n"
+    "}\n";
+
+@interface CompositorTile : NSObject {
+@public
+    GLuint      textures[3];
+    int         width, height;
+
+    // Copy of the latest frame not yet uploaded, guarded by @synchronized(tile)
+    NSMutableData   *pending;
+    BOOL            hasPending;
+    int             pendingWidth, pendingHeight;
+
+    // Frame being uploaded on the render queue, swapped with pending
+    NSMutableData   *upload;
+
+    // Layout taken on the main thread for the next compose, guarded by @synchronized(tile)
+    CGRect          drawRect;
+    BOOL            drawVisible;
+    int             quarterTurns;
+}
+
+@property(nonatomic, weak) VideoStreamViewController *streamView;
+
+@end
+
+@implementation CompositorTile
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        pending = [NSMutableData data];
+        upload = [NSMutableData data];
+    }
+    return self;
+}
+
+@end
+
+static void releaseTileTextures(CompositorTile *tile)
+{
+    if (tile->textures[0]) {
+        glDeleteTextures(3, tile->textures);
+        memset(tile->textures, 0, sizeof(tile->textures));
+    }
+    tile->width = tile->height = 0;
+}
+
+// EAGLViewController rotate, the SDK sets it from the rotation flag of the decoded frame.
+// 90, 180 and 270 are taken as degrees clockwise, any other non-zero value as a quarter turn.
+static int quarterTurnsForRotate(int rotate)
+{
+    if (rotate % 90 == 0)
+        return ((rotate / 90) % 4 + 4) % 4;
+    return 1;
+}
+
+@interface GroupVideoCompositor () {
+    // Only used on the render queue
+    GLuint              framebuffer, colorRenderbuffer;
+    GLint               drawableWidth, drawableHeight;
+    GLuint              program;
+    CGFloat             scale;
+
+    volatile int32_t    needsCompose;
+    volatile int32_t    composing;
+    volatile int32_t    coalesced;
+}
+
+@property(nonatomic, strong) EAGLContext *context;
+@property(nonatomic, strong) dispatch_queue_t renderQueue;
+@property(nonatomic, strong) CADisplayLink *displayLink;
+@property(atomic, strong) NSArray *tiles;
+@property(nonatomic, readwrite) NSUInteger uploadedFrames;
+@property(nonatomic, readwrite) NSUInteger presentedFrames;
+
+@end
+
+@implementation GroupVideoCompositor
+
++(Class) layerClass
+{
+    return [CAEAGLLayer class];
+}
+
+-(void) setupCompositor
+{
+    self.tiles = @[];
+    self.opaque = NO;
+    self.backgroundColor = [UIColor clearColor];
+    self.userInteractionEnabled = NO;
+    self.contentScaleFactor = [UIScreen mainScreen].scale;
+
+    CAEAGLLayer *layer = (CAEAGLLayer *) self.layer;
+    layer.opaque = NO;
+    layer.drawableProperties = @{kEAGLDrawablePropertyRetainedBacking : @NO, kEAGLDrawablePropertyColorFormat : kEAGLColorFormatRGBA8};
+
+    // Uploads and draws run off the main thread, like the stream view uploads
+    self.renderQueue = dispatch_queue_create("GroupVideoCompositor.render", DISPATCH_QUEUE_SERIAL);
+    self.context = [[EAGLContext alloc] initWithAPI:kEAGLRenderingAPIOpenGLES2];
+    [self performOnRenderQueue:^{
+        program = [self createProgram];
+    }];
+}
+
+- (id)initWithFrame:(CGRect)frame
+{
+    self = [super initWithFrame:frame];
+    if (self) {
+        [self setupCompositor];
+    }
+    return self;
+}
+
+- (id)initWithCoder:(NSCoder *)aDecoder
+{
+    self = [super initWithCoder:aDecoder];
+    if (self) {
+        [self setupCompositor];
+    }
+    return self;
+}
+
+-(void) dealloc
+{
+    [self.displayLink invalidate];
+
+    // The block must not retain self, release the GL objects by value after the running compose
+    EAGLContext *context = self.context;
+    NSArray *tiles = self.tiles;
+    GLuint ownFramebuffer = framebuffer, ownRenderbuffer = colorRenderbuffer, ownProgram = program;
+    dispatch_async(self.renderQueue, ^{
+        EAGLContext *previous = [EAGLContext currentContext];
+        [EAGLContext setCurrentContext:context];
+        for (CompositorTile *tile in tiles) {
+            releaseTileTextures(tile);
+        }
+        if (ownFramebuffer)
+            glDeleteFramebuffers(1, &ownFramebuffer);
+        if (ownRenderbuffer)
+            glDeleteRenderbuffers(1, &ownRenderbuffer);
+        if (ownProgram)
+            glDeleteProgram(ownProgram);
+        [EAGLContext setCurrentContext:previous];
+    });
+}
+
++(GroupVideoCompositor *) compositorForGroupVideoCall:(SCGroupVideoCallController *) controller
+{
+    GroupVideoCompositor *compositor = objc_getAssociatedObject(controller, &GroupVideoCompositorKey);
+    if (compositor)
+        return compositor;
+
+    UIView *container = controller.innerView ?: controller.view;
+    compositor = [[GroupVideoCompositor alloc] initWithFrame:container.bounds];
+    compositor.autoresizingMask = UIViewAutoresizingFlexibleWidth | UIViewAutoresizingFlexibleHeight;
+    [container addSubview:compositor];
+
+    objc_setAssociatedObject(controller, &GroupVideoCompositorKey, compositor, OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+    return compositor;
+}
+
+#pragma mark GL Setup
+
+-(void) performWithContext:(dispatch_block_t) block
+{
+    // Other GL code on this thread expects its own context to stay current
+    EAGLContext *previous = [EAGLContext currentContext];
+    if (previous != self.context)
+        [EAGLContext setCurrentContext:self.context];
+
+    block();
+
+    if (previous != self.context)
+        [EAGLContext setCurrentContext:previous];
+}
+
+-(void) performOnRenderQueue:(dispatch_block_t) block
+{
+    dispatch_async(self.renderQueue, ^{
+        [self performWithContext:block];
+    });
+}
+
+-(GLuint) compileShader:(GLenum) type source:(const char *) source
+{
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    GLint status = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (!status) {
+        GLchar log[512];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        DLog(@"GroupVideoCompositor: shader compile failed: %s", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+-(GLuint) createProgram
+{
+    GLuint vertexShader = [self compileShader:GL_VERTEX_SHADER source:vertexShaderSource];
+    GLuint fragmentShader = [self compileShader:GL_FRAGMENT_SHADER source:fragmentShaderSource];
+    if (!vertexShader || !fragmentShader)
+        return 0;
+
+    GLuint result = glCreateProgram();
+    glAttachShader(result, vertexShader);
+    glAttachShader(result, fragmentShader);
+    glBindAttribLocation(result, ATTRIB_POSITION, "position");
+    glBindAttribLocation(result, ATTRIB_TEXCOORD, "texCoord");
+    glLinkProgram(result);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    GLint status = 0;
+    glGetProgramiv(result, GL_LINK_STATUS, &status);
+    if (!status) {
+        DLog(@"GroupVideoCompositor: program link failed");
+        glDeleteProgram(result);
+        return 0;
+    }
+
+    glUseProgram(result);
+    glUniform1i(glGetUniformLocation(result, "texY"), 0);
+    glUniform1i(glGetUniformLocation(result, "texU"), 1);
+    glUniform1i(glGetUniformLocation(result, "texV"), 2);
+    return result;
+}
+
+-(void) releaseFramebuffer
+{
+    if (framebuffer) {
+        glDeleteFramebuffers(1, &framebuffer);
+        framebuffer = 0;
+    }
+    if (colorRenderbuffer) {
+        glDeleteRenderbuffers(1, &colorRenderbuffer);
+        colorRenderbuffer = 0;
+    }
+}
+
+-(BOOL) prepareFramebuffer
+{
+    if (framebuffer)
+        return YES;
+
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &colorRenderbuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorRenderbuffer);
+    [self.context renderbufferStorage:GL_RENDERBUFFER fromDrawable:(CAEAGLLayer *) self.layer];
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRenderbuffer);
+    glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_WIDTH, &drawableWidth);
+    glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_HEIGHT, &drawableHeight);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE || drawableWidth == 0 || drawableHeight == 0) {
+        [self releaseFramebuffer];
+        return NO;
+    }
+    return YES;
+}
+
+-(void) layoutSubviews
+{
+    [super layoutSubviews];
+
+    // Recreated with the new size on the next compose
+    [self performOnRenderQueue:^{
+        [self releaseFramebuffer];
+    }];
+    [self setNeedsCompose];
+}
+
+-(void) didMoveToWindow
+{
+    [super didMoveToWindow];
+
+    // The display link retains its target, so it only runs while on screen
+    if (self.window && !self.displayLink) {
+        self.displayLink = [CADisplayLink displayLinkWithTarget:self selector:@selector(compose:)];
+        [self.displayLink addToRunLoop:[NSRunLoop mainRunLoop] forMode:NSRunLoopCommonModes];
+        [self setNeedsCompose];
+    } else if (!self.window) {
+        [self.displayLink invalidate];
+        self.displayLink = nil;
+    }
+}
+
+#pragma mark Tiles
+
+-(CompositorTile *) tileForStreamView:(VideoStreamViewController *) streamView
+{
+    for (CompositorTile *tile in self.tiles) {
+        if (tile.streamView == streamView)
+            return tile;
+    }
+    return nil;
+}
+
+-(void) addTile:(VideoStreamViewController *) streamView
+{
+    if (!streamView || [self tileForStreamView:streamView])
+        return;
+
+    CompositorTile *tile = [[CompositorTile alloc] init];
+    tile.streamView = streamView;
+
+    @synchronized(self) {
+        self.tiles = [self.tiles arrayByAddingObject:tile];
+    }
+
+    // Stay above participant views added after the compositor
+    [self.superview bringSubviewToFront:self];
+    [self setNeedsCompose];
+}
+
+-(void) removeTile:(VideoStreamViewController *) streamView
+{
+    NSMutableArray *removed = [NSMutableArray array];
+    @synchronized(self) {
+        NSMutableArray *remaining = [NSMutableArray arrayWithCapacity:[self.tiles count]];
+        for (CompositorTile *tile in self.tiles) {
+            if (tile.streamView == streamView || !tile.streamView) {
+                [removed addObject:tile];
+            } else {
+                [remaining addObject:tile];
+            }
+        }
+        self.tiles = remaining;
+    }
+
+    if ([removed count] == 0)
+        return;
+
+    [self performOnRenderQueue:^{
+        for (CompositorTile *tile in removed) {
+            releaseTileTextures(tile);
+        }
+    }];
+    [self setNeedsCompose];
+}
+
+-(void) setTextureData:(NSData *) data withWidth:(int) width andHeight:(int) height forTile:(VideoStreamViewController *) streamView
+{
+    CompositorTile *tile = [self tileForStreamView:streamView];
+    if (!tile || width <= 0 || height <= 0)
+        return;
+
+    if ([data length] < width * height + 2 * ((width + 1) / 2) * ((height + 1) / 2))
+        return;
+
+    BOOL replaced = NO;
+    @synchronized(tile) {
+        // The decoder reuses its buffer for the next frame, keep a copy
+        replaced = tile->hasPending;
+        [tile->pending setData:data];
+        tile->hasPending = YES;
+        tile->pendingWidth = width;
+        tile->pendingHeight = height;
+    }
+
+    if (replaced)
+        OSAtomicIncrement32(&coalesced);
+    [self setNeedsCompose];
+}
+
+-(NSUInteger) coalescedFrames
+{
+    return coalesced;
+}
+
+-(void) setNeedsCompose
+{
+    OSAtomicCompareAndSwap32Barrier(0, 1, &needsCompose);
+}
+
+#pragma mark Rendering
+
+-(void) uploadPendingFrame:(CompositorTile *) tile
+{
+    NSData *data = nil;
+    int width = 0, height = 0;
+    @synchronized(tile) {
+        if (!tile->hasPending)
+            return;
+
+        // Only the render queue touches the upload buffer, the decoder fills the other one meanwhile
+        NSMutableData *frame = tile->pending;
+        tile->pending = tile->upload;
+        tile->upload = frame;
+        tile->hasPending = NO;
+
+        data = frame;
+        width = tile->pendingWidth;
+        height = tile->pendingHeight;
+    }
+
+    int planeWidth[3] = {width, (width + 1) / 2, (width + 1) / 2};
+    int planeHeight[3] = {height, (height + 1) / 2, (height + 1) / 2};
+    const uint8_t *plane = [data bytes];
+
+    // Textures are allocated once per resolution, frames are written with sub image updates
+    BOOL allocate = tile->width != width || tile->height != height || !tile->textures[0];
+    if (allocate) {
+        releaseTileTextures(tile);
+        glGenTextures(3, tile->textures);
+        tile->width = width;
+        tile->height = height;
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int i = 0; i < 3; i++) {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D, tile->textures[i]);
+
+        if (allocate) {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, planeWidth[i], planeHeight[i], 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, plane);
+        } else {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, planeWidth[i], planeHeight[i], GL_LUMINANCE, GL_UNSIGNED_BYTE, plane);
+        }
+        plane += planeWidth[i] * planeHeight[i];
+    }
+
+    self.uploadedFrames++;
+}
+
+-(void) drawTile:(CompositorTile *) tile
+{
+    CGRect rect;
+    int turns = 0;
+    @synchronized(tile) {
+        if (!tile->drawVisible)
+            return;
+        rect = tile->drawRect;
+        turns = tile->quarterTurns;
+    }
+
+    if (!tile->textures[0])
+        return;
+
+    GLint x = (GLint) (CGRectGetMinX(rect) * scale);
+    GLint y = drawableHeight - (GLint) (CGRectGetMaxY(rect) * scale);
+    GLsizei width = (GLsizei) (CGRectGetWidth(rect) * scale);
+    GLsizei height = (GLsizei) (CGRectGetHeight(rect) * scale);
+    if (width <= 0 || height <= 0)
+        return;
+
+    // Aspect fill of the rotated image, crop in tile coordinates, top down
+    GLfloat u0 = 0., u1 = 1., v0 = 0., v1 = 1.;
+    float tileAspect = (float) width / height;
+    float imageAspect = turns % 2 ? (float) tile->height / tile->width : (float) tile->width / tile->height;
+    if (imageAspect > tileAspect) {
+        float visible = tileAspect / imageAspect;
+        u0 = (1. - visible) / 2.;
+        u1 = u0 + visible;
+    } else if (imageAspect < tileAspect) {
+        float visible = imageAspect / tileAspect;
+        v0 = (1. - visible) / 2.;
+        v1 = v0 + visible;
+    }
+
+    // Corners bottom left, bottom right, top left, top right, mapped back into the unrotated texture
+    const GLfloat positions[] = {-1., -1., 1., -1., -1., 1., 1., 1.};
+    const GLfloat corners[] = {u0, v1, u1, v1, u0, v0, u1, v0};
+    GLfloat texCoords[8];
+    for (int i = 0; i < 8; i += 2) {
+        GLfloat u = corners[i], v = corners[i + 1];
+        switch (turns) {
+            case 1: texCoords[i] = v; texCoords[i + 1] = 1. - u; break;
+            case 2: texCoords[i] = 1. - u; texCoords[i + 1] = 1. - v; break;
+            case 3: texCoords[i] = 1. - v; texCoords[i + 1] = u; break;
+            default: texCoords[i] = u; texCoords[i + 1] = v; break;
+        }
+    }
+
+    glViewport(x, y, width, height);
+    for (int i = 0; i < 3; i++) {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D, tile->textures[i]);
+    }
+    glVertexAttribPointer(ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, 0, positions);
+    glVertexAttribPointer(ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, 0, texCoords);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+-(void) takeLayout:(CompositorTile *) tile
+{
+    // UIKit state is only read on the main thread, the render queue works on this copy
+    VideoStreamViewController *streamView = tile.streamView;
+    UIView *tileView = streamView.view;
+    BOOL visible = tileView.window && !tileView.hidden && streamView.visibility != VideoVisibilityHidden;
+    CGRect rect = visible ? [tileView convertRect:tileView.bounds toView:self] : CGRectZero;
+    int turns = quarterTurnsForRotate(streamView.rotate);
+
+    @synchronized(tile) {
+        tile->drawVisible = visible;
+        tile->drawRect = rect;
+        tile->quarterTurns = turns;
+    }
+}
+
+-(void) compose:(CADisplayLink *) displayLink
+{
+    if ([UIApplication sharedApplication].applicationState == UIApplicationStateBackground)
+        return;
+
+    // The previous compose is still running, needsCompose stays set for the next vsync
+    if (!OSAtomicCompareAndSwap32Barrier(0, 1, &composing))
+        return;
+
+    if (!OSAtomicCompareAndSwap32Barrier(1, 0, &needsCompose)) {
+        OSAtomicCompareAndSwap32Barrier(1, 0, &composing);
+        return;
+    }
+
+    NSArray *tiles = self.tiles;
+    for (CompositorTile *tile in tiles) {
+        [self takeLayout:tile];
+    }
+    CGFloat contentScale = self.contentScaleFactor;
+
+    [self performOnRenderQueue:^{
+        scale = contentScale;
+        if (program)
+            [self composeTiles:tiles];
+        OSAtomicCompareAndSwap32Barrier(1, 0, &composing);
+    }];
+}
+
+-(void) composeTiles:(NSArray *) tiles
+{
+    if (![self prepareFramebuffer])
+        return;
+
+    for (CompositorTile *tile in tiles) {
+        [self uploadPendingFrame:tile];
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, drawableWidth, drawableHeight);
+    glClearColor(0., 0., 0., 0.);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glUseProgram(program);
+    glEnableVertexAttribArray(ATTRIB_POSITION);
+    glEnableVertexAttribArray(ATTRIB_TEXCOORD);
+
+    for (CompositorTile *tile in tiles) {
+        [self drawTile:tile];
+    }
+
+    glBindRenderbuffer(GL_RENDERBUFFER, colorRenderbuffer);
+    [self.context presentRenderbuffer:GL_RENDERBUFFER];
+    self.presentedFrames++;
+}
+
+@end
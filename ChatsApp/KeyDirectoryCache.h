@@ -0,0 +1,121 @@
+//
+//  KeyDirectoryCache.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 10/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "MessageEnvelope.h"
+
+typedef enum {
+    KeyDirectoryUnknown,            // Not cached or expired, a fetch has been scheduled
+    KeyDirectoryAvailable,          // Certificate cached
+    KeyDirectoryNoKey               // The user has no certificate, cached with negativeTTL
+} KeyDirectoryStateT;
+
+/** Directory the certificates are fetched from. */
+@protocol KeyDirectorySource <NSObject>
+
+/** Fetch the certificates of a batch of users.
+
+ @param userids - The users
+ @param completion - To be called once with the DER encoded X.509 certificates by userid and optional
+    certificate versions by userid, users without certificate are left out. Can be called on any thread.
+ */
+-(void) fetchCertificatesForUserids:(NSArray *) userids completion:(void (^)(NSDictionary *certificates, NSDictionary *versions)) completion;
+
+/** Private key of the current user.
+
+ @return Retained private key or NULL
+ */
+-(SecKeyRef) copyPrivateKey;
+
+@end
+
+/** Cache of the public keys of other users for encrypted messages.
+
+ Lookups never block on the network: a user not in the cache, or with an expired entry, is answered
+ from what is cached and a fetch is scheduled. Fetches are collected for batchDelay and sent to the
+ source in batches of batchSize. Users without certificate are cached as well (negative caching),
+ with a shorter TTL. A batch the source has not answered after fetchTimeout is given up, so the
+ next lookup fetches these users again. A certificate is only used if it chains to one of the
+ anchorCertificates, without anchors no certificate is trusted. An entry is invalidated when a different certificate version is reported for the
+ user, and all entries are invalidated when the certificate of the own account is no longer valid.
+
+ Friends are prefetched on start and when they are added, group members with prefetchGroup:, so the
+ first encrypted message to a contact usually finds the key in the cache.
+
+ The app does not start the cache: the SDK has no API to fetch certificates or the private key of the
+ account, so there is no source. Once a source exists, it is set together with the anchors of its CA
+ before start, and the cache is set as MessageEnvelope keyProvider.
+ */
+@interface KeyDirectoryCache : NSObject<MessageEnvelopeKeyProvider>
+
+/** Source of the certificates, retained. */
+@property(nonatomic, strong) id<KeyDirectorySource> source;
+
+/** DER encoded certificates of the CAs issuing the user certificates, the only trusted anchors. */
+@property(nonatomic, copy) NSArray *anchorCertificates;
+
+/** Lifetime of a cached certificate. Default is 24h. */
+@property(nonatomic) NSTimeInterval ttl;
+
+/** Lifetime of a cached "no certificate" result. Default is 1h. */
+@property(nonatomic) NSTimeInterval negativeTTL;
+
+/** Maximum users per fetch. Default is 50. */
+@property(nonatomic) NSUInteger batchSize;
+
+/** Time to collect users for a fetch. Default is 0.2s. */
+@property(nonatomic) NSTimeInterval batchDelay;
+
+/** Time after which an unanswered fetch is given up. Default is 30s. */
+@property(nonatomic) NSTimeInterval fetchTimeout;
+
+/** Number of fetches sent to the source. */
+@property(nonatomic, readonly) NSUInteger fetchCount;
+
+/** Cache state of a user, schedules a fetch if unknown.
+
+ @param userid - The user
+ */
+-(KeyDirectoryStateT) stateForUserid:(NSString *) userid;
+
+/** Cached certificate of a user, schedules a fetch if unknown.
+
+ @param userid - The user
+ @return DER encoded certificate or nil
+ */
+-(NSData *) certificateForUserid:(NSString *) userid;
+
+/** Fetch the certificates of users not cached yet. */
+-(void) prefetchUserids:(NSArray *) userids;
+
+/** Fetch the certificates of all friends not cached yet. */
+-(void) prefetchFriends;
+
+/** Fetch the certificates of all members of a group not cached yet. */
+-(void) prefetchGroup:(NSString *) groupid;
+
+/** Report the current certificate version of a user, invalidates the entry if the version differs.
+
+ @param version - The certificate version
+ @param userid - The user
+ */
+-(void) setVersion:(NSString *) version forUserid:(NSString *) userid;
+
+/** Remove a user from the cache. */
+-(void) invalidateUserid:(NSString *) userid;
+
+/** Remove all users from the cache. */
+-(void) invalidateAll;
+
+/** Validate the own account certificate and prefetch the friends, registers for added friends. */
+-(void) start;
+
+/** @return shared instance */
++(KeyDirectoryCache *) instance;
+
+@end
@@ -0,0 +1,380 @@
+//
+//  KeyDirectoryCache.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 10/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <SocialCommunication/C2CallPhone.h>
+#import <SocialCommunication/SCFriendList.h>
+#import <SocialCommunication/SCGroup.h>
+#import <SocialCommunication/MOC2CallUser.h>
+#import <SocialCommunication/debug.h>
+
+#import "KeyDirectoryCache.h"
+
+static void *KeyDirectoryQueueKey = &KeyDirectoryQueueKey;
+
+@interface KeyDirectoryEntry : NSObject {
+@public
+    SecKeyRef   publicKey;
+}
+
+@property(nonatomic, strong) NSData *certificate;
+@property(nonatomic, strong) NSString *version;
+@property(nonatomic) CFAbsoluteTime expires;
+
+@end
+
+@implementation KeyDirectoryEntry
+
+-(void) dealloc
+{
+    if (publicKey)
+        CFRelease(publicKey);
+}
+
+@end
+
+@interface KeyDirectoryCache ()
+
+// Accessed on queue only
+@property(nonatomic, strong) dispatch_queue_t queue;
+@property(nonatomic, strong) NSMutableDictionary *entries;
+@property(nonatomic, strong) NSMutableOrderedSet *pending;
+@property(nonatomic, strong) NSMutableSet *inflight;
+@property(nonatomic) BOOL fetchScheduled;
+@property(nonatomic) BOOL registeredForFriends;
+@property(nonatomic, readwrite) NSUInteger fetchCount;
+
+@end
+
+@implementation KeyDirectoryCache
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.ttl = 24. * 3600.;
+        self.negativeTTL = 3600.;
+        self.batchSize = 50;
+        self.batchDelay = 0.2;
+        self.fetchTimeout = 30.;
+
+        self.entries = [NSMutableDictionary dictionary];
+        self.pending = [NSMutableOrderedSet orderedSet];
+        self.inflight = [NSMutableSet set];
+        self.queue = dispatch_queue_create("KeyDirectoryCache", DISPATCH_QUEUE_SERIAL);
+        dispatch_queue_set_specific(self.queue, KeyDirectoryQueueKey, KeyDirectoryQueueKey, NULL);
+    }
+    return self;
+}
+
+-(void) performSync:(dispatch_block_t) block
+{
+    if (dispatch_get_specific(KeyDirectoryQueueKey) == KeyDirectoryQueueKey) {
+        block();
+    } else {
+        dispatch_sync(self.queue, block);
+    }
+}
+
+#pragma mark Lookup
+
+-(KeyDirectoryEntry *) entryForUserid:(NSString *) userid
+{
+    // On queue
+    KeyDirectoryEntry *entry = self.entries[userid];
+    if (!entry || CFAbsoluteTimeGetCurrent() >= entry.expires)
+        [self scheduleFetchForUserid:userid];
+
+    return entry;
+}
+
+-(KeyDirectoryStateT) stateForUserid:(NSString *) userid
+{
+    if (!userid)
+        return KeyDirectoryUnknown;
+
+    __block KeyDirectoryStateT state = KeyDirectoryUnknown;
+    [self performSync:^{
+        KeyDirectoryEntry *entry = [self entryForUserid:userid];
+        if (entry)
+            state = entry.certificate ? KeyDirectoryAvailable : KeyDirectoryNoKey;
+    }];
+    return state;
+}
+
+-(NSData *) certificateForUserid:(NSString *) userid
+{
+    if (!userid)
+        return nil;
+
+    __block NSData *certificate = nil;
+    [self performSync:^{
+        certificate = [self entryForUserid:userid].certificate;
+    }];
+    return certificate;
+}
+
+-(SecKeyRef) copyPublicKeyForUserid:(NSString *) userid
+{
+    if (!userid)
+        return NULL;
+
+    __block SecKeyRef publicKey = NULL;
+    [self performSync:^{
+        KeyDirectoryEntry *entry = [self entryForUserid:userid];
+        if (!entry.certificate)
+            return;
+
+        if (!entry->publicKey)
+            entry->publicKey = [self createPublicKeyFromCertificate:entry.certificate];
+
+        if (entry->publicKey)
+            publicKey = (SecKeyRef) CFRetain(entry->publicKey);
+    }];
+    return publicKey;
+}
+
+-(void) setAnchorCertificates:(NSArray *) anchorCertificates
+{
+    [self performSync:^{
+        _anchorCertificates = [anchorCertificates copy];
+
+        // Keys were evaluated against the previous anchors
+        for (KeyDirectoryEntry *entry in [self.entries allValues]) {
+            if (entry->publicKey) {
+                CFRelease(entry->publicKey);
+                entry->publicKey = NULL;
+            }
+        }
+    }];
+}
+
+-(SecKeyRef) copyPrivateKey
+{
+    return [self.source copyPrivateKey];
+}
+
+-(NSArray *) createAnchors
+{
+    NSMutableArray *anchors = [NSMutableArray arrayWithCapacity:[self.anchorCertificates count]];
+    for (NSData *data in self.anchorCertificates) {
+        SecCertificateRef anchor = SecCertificateCreateWithData(kCFAllocatorDefault, (__bridge CFDataRef) data);
+        if (anchor)
+            [anchors addObject:(__bridge_transfer id) anchor];
+    }
+    return anchors;
+}
+
+-(SecKeyRef) createPublicKeyFromCertificate:(NSData *) data
+{
+    // The system roots would accept any certificate a public CA has issued for the user
+    NSArray *anchors = [self createAnchors];
+    if ([anchors count] == 0) {
+        DLog(@"KeyDirectoryCache: no anchor certificates, certificate rejected");
+        return NULL;
+    }
+
+    SecCertificateRef certificate = SecCertificateCreateWithData(kCFAllocatorDefault, (__bridge CFDataRef) data);
+    if (!certificate)
+        return NULL;
+
+    SecPolicyRef policy = SecPolicyCreateBasicX509();
+    SecTrustRef trust = NULL;
+    SecKeyRef publicKey = NULL;
+
+    if (SecTrustCreateWithCertificates(certificate, policy, &trust) == errSecSuccess) {
+        SecTrustSetAnchorCertificates(trust, (__bridge CFArrayRef) anchors);
+        SecTrustSetAnchorCertificatesOnly(trust, true);
+
+        SecTrustResultType result = kSecTrustResultInvalid;
+        OSStatus status = SecTrustEvaluate(trust, &result);
+
+        // Only a certificate that passes the evaluation provides a key
+        if (status == errSecSuccess && (result == kSecTrustResultUnspecified || result == kSecTrustResultProceed)) {
+            publicKey = SecTrustCopyPublicKey(trust);
+        } else {
+            DLog(@"KeyDirectoryCache: certificate rejected, trust result %d", (int) result);
+        }
+        CFRelease(trust);
+    }
+
+    CFRelease(policy);
+    CFRelease(certificate);
+    return publicKey;
+}
+
+#pragma mark Fetch
+
+-(void) scheduleFetchForUserid:(NSString *) userid
+{
+    // On queue
+    if ([self.inflight containsObject:userid] || [self.pending containsObject:userid])
+        return;
+
+    [self.pending addObject:userid];
+
+    if (self.fetchScheduled)
+        return;
+
+    self.fetchScheduled = YES;
+    if (self.batchDelay > 0.) {
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.batchDelay * NSEC_PER_SEC)), self.queue, ^{
+            [self fetchPending];
+        });
+    } else {
+        dispatch_async(self.queue, ^{
+            [self fetchPending];
+        });
+    }
+}
+
+-(void) fetchPending
+{
+    // On queue
+    self.fetchScheduled = NO;
+
+    id<KeyDirectorySource> source = self.source;
+    NSArray *userids = [self.pending array];
+    [self.pending removeAllObjects];
+
+    if (!source || [userids count] == 0)
+        return;
+
+    NSUInteger batchSize = MAX(1, self.batchSize);
+    for (NSUInteger offset = 0; offset < [userids count]; offset += batchSize) {
+        NSArray *batch = [userids subarrayWithRange:NSMakeRange(offset, MIN(batchSize, [userids count] - offset))];
+        [self.inflight addObjectsFromArray:batch];
+        self.fetchCount++;
+
+        // Set and read on queue only
+        __block BOOL completed = NO;
+        [source fetchCertificatesForUserids:batch completion:^(NSDictionary *certificates, NSDictionary *versions) {
+            [self performSync:^{
+                completed = YES;
+                [self storeCertificates:certificates versions:versions forUserids:batch];
+            }];
+        }];
+
+        if (!completed && self.fetchTimeout > 0.) {
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.fetchTimeout * NSEC_PER_SEC)), self.queue, ^{
+                if (completed)
+                    return;
+
+                // The source never answered, the next lookup fetches these users again
+                DLog(@"KeyDirectoryCache: fetch of %lu users timed out", (unsigned long) [batch count]);
+                for (NSString *userid in batch) {
+                    [self.inflight removeObject:userid];
+                }
+            });
+        }
+    }
+}
+
+-(void) storeCertificates:(NSDictionary *) certificates versions:(NSDictionary *) versions forUserids:(NSArray *) userids
+{
+    // On queue
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+
+    for (NSString *userid in userids) {
+        [self.inflight removeObject:userid];
+
+        KeyDirectoryEntry *entry = [[KeyDirectoryEntry alloc] init];
+        entry.certificate = certificates[userid];
+        entry.version = versions[userid];
+        entry.expires = now + (entry.certificate ? self.ttl : self.negativeTTL);
+        self.entries[userid] = entry;
+    }
+}
+
+-(void) prefetchUserids:(NSArray *) userids
+{
+    [self performSync:^{
+        CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+        for (NSString *userid in userids) {
+            KeyDirectoryEntry *entry = self.entries[userid];
+            if (!entry || now >= entry.expires)
+                [self scheduleFetchForUserid:userid];
+        }
+    }];
+}
+
+-(void) prefetchFriends
+{
+    [self prefetchUserids:[[SCFriendList instance] listFriendsUserids]];
+}
+
+-(void) prefetchGroup:(NSString *) groupid
+{
+    [self prefetchUserids:[[[SCGroup alloc] initWithGroupid:groupid] groupMembers]];
+}
+
+#pragma mark Invalidation
+
+-(void) setVersion:(NSString *) version forUserid:(NSString *) userid
+{
+    if (!version || !userid)
+        return;
+
+    [self performSync:^{
+        KeyDirectoryEntry *entry = self.entries[userid];
+        if (entry && ![entry.version isEqualToString:version]) {
+            [self.entries removeObjectForKey:userid];
+            [self scheduleFetchForUserid:userid];
+        }
+    }];
+}
+
+-(void) invalidateUserid:(NSString *) userid
+{
+    if (!userid)
+        return;
+
+    [self performSync:^{
+        [self.entries removeObjectForKey:userid];
+    }];
+}
+
+-(void) invalidateAll
+{
+    [self performSync:^{
+        [self.entries removeAllObjects];
+    }];
+}
+
+-(void) start
+{
+    // The key pair has been changed on another device, keys cached for this account are stale
+    C2CallPhone *phone = [C2CallPhone currentPhone];
+    if ([phone encryptionEnabledForAccount] && ![phone validateCertificateForAccount]) {
+        DLog(@"KeyDirectoryCache: account certificate changed, invalidating cache");
+        [self invalidateAll];
+    }
+
+    if (!self.registeredForFriends) {
+        self.registeredForFriends = YES;
+
+        __weak KeyDirectoryCache *weakself = self;
+        [[SCFriendList instance] registerForAddedFriends:^(MOC2CallUser *user) {
+            if (user.userid)
+                [weakself prefetchUserids:@[user.userid]];
+        }];
+    }
+
+    [self prefetchFriends];
+}
+
++(KeyDirectoryCache *) instance
+{
+    static KeyDirectoryCache *cache = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        cache = [[KeyDirectoryCache alloc] init];
+    });
+    return cache;
+}
+
+@end
@@ -0,0 +1,59 @@
+//
+//  KeyframePolicy.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 29/05/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/** Adaptive keyframe distance for the video encoder.
+
+ The video handler sends a keyframe every keyframeDistance frames (default 10) to recover
+ from packet loss. On a clean link most of these keyframes are wasted bandwidth.
+
+ The policy doubles the keyframe distance for every stableInterval the connection quality
+ stays at or above cleanConnectionQuality, up to maxKeyframeDistance. While the quality is
+ below that threshold, or when the connection resumes after stalling, the distance is reset
+ to minKeyframeDistance, so the remote decoder gets a keyframe soon. These recovery requests
+ are rate limited by minRecoveryInterval, to avoid keyframe storms on a lossy link.
+ */
+@interface KeyframePolicy : NSObject
+
+/** Keyframe distance in frames used for recovery. Default is 10. */
+@property(nonatomic) int minKeyframeDistance;
+
+/** Largest keyframe distance in frames on a clean link. Default is 150. */
+@property(nonatomic) int maxKeyframeDistance;
+
+/** Lowest RTPVideoHandler connectionQuality considered a clean link. Default is 3.
+
+ The SDK does not document the scale of connectionQuality, only that it rises with the link quality.
+ The default is a starting point, tune it against the connectionQuality histogram of
+ CallStatsCollector recorded on clean and lossy links.
+ */
+@property(nonatomic) int cleanConnectionQuality;
+
+/** Time on a clean link before the distance is doubled. Default is 5s. */
+@property(nonatomic) NSTimeInterval stableInterval;
+
+/** Minimum time between two recovery requests. Default is 2s. */
+@property(nonatomic) NSTimeInterval minRecoveryInterval;
+
+/** While suspended the keyframe distance is left alone, e.g. during screen sharing. */
+@property(nonatomic) BOOL suspended;
+
+/** Number of recovery requests since start which reduced the keyframe distance. */
+@property(nonatomic, readonly) NSUInteger recoveryCount;
+
+/** Start controlling the keyframe distance of the current video call. */
+-(void) start;
+
+/** Stop controlling and restore the minimum keyframe distance. */
+-(void) stop;
+
+/** @return shared instance */
++(KeyframePolicy *) instance;
+
+@end
@@ -0,0 +1,141 @@
+//
+//  KeyframePolicy.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 29/05/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <SocialCommunication/RTPVideoHandler.h>
+#import <SocialCommunication/debug.h>
+
+#import "KeyframePolicy.h"
+
+#define SAMPLE_INTERVAL     1.0
+
+@interface KeyframePolicy () {
+    CFAbsoluteTime      lastLossIndication, lastRecovery;
+}
+
+@property(nonatomic, strong) NSTimer *sampleTimer;
+@property(nonatomic, readwrite) NSUInteger recoveryCount;
+
+@end
+
+@implementation KeyframePolicy
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.minKeyframeDistance = 10;
+        self.maxKeyframeDistance = 150;
+        self.cleanConnectionQuality = 3;
+        self.stableInterval = 5.;
+        self.minRecoveryInterval = 2.;
+    }
+    return self;
+}
+
+-(void) start
+{
+    [self stop];
+
+    lastLossIndication = CFAbsoluteTimeGetCurrent();
+    lastRecovery = 0;
+
+    NSNotificationCenter *nc = [NSNotificationCenter defaultCenter];
+    [nc addObserver:self selector:@selector(connectionResume:) name:@"C2Call:ConnectionResume" object:nil];
+    [nc addObserver:self selector:@selector(connectionResume:) name:@"C2Call:VideoResume" object:nil];
+
+    self.sampleTimer = [NSTimer scheduledTimerWithTimeInterval:SAMPLE_INTERVAL target:self selector:@selector(sample:) userInfo:nil repeats:YES];
+}
+
+-(void) stop
+{
+    if (!self.sampleTimer)
+        return;
+
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [self.sampleTimer invalidate];
+    self.sampleTimer = nil;
+
+    [[RTPVideoHandler videoHandler] setKeyframeDistance:self.minKeyframeDistance];
+}
+
+-(void) setSuspended:(BOOL) suspended
+{
+    _suspended = suspended;
+
+    // Start a new stable interval with the distance the suspension leaves behind
+    lastLossIndication = CFAbsoluteTimeGetCurrent();
+}
+
+-(void) sample:(NSTimer *) timer
+{
+    if (self.suspended)
+        return;
+
+    RTPVideoHandler *handler = [RTPVideoHandler videoHandler];
+    if (!handler || ![handler isActive] || handler.disposed)
+        return;
+
+    // connectionQuality rises with a better link, below the clean threshold we expect loss
+    if (handler.connectionQuality < self.cleanConnectionQuality) {
+        [self requestRecovery];
+        return;
+    }
+
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    if (now - lastLossIndication < self.stableInterval)
+        return;
+
+    int distance = [handler keyframeDistance];
+    if (distance < self.maxKeyframeDistance) {
+        distance = MIN(MAX(distance, self.minKeyframeDistance) * 2, self.maxKeyframeDistance);
+        DLog(@"KeyframePolicy: stable link, keyframe distance %d", distance);
+        [handler setKeyframeDistance:distance];
+    }
+
+    // Wait another stable interval before the next step
+    lastLossIndication = now;
+}
+
+-(void) connectionResume:(NSNotification *) notification
+{
+    if (!self.suspended)
+        [self requestRecovery];
+}
+
+-(void) requestRecovery
+{
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    lastLossIndication = now;
+
+    if (now - lastRecovery < self.minRecoveryInterval)
+        return;
+
+    lastRecovery = now;
+
+    // Already at the recovery distance, e.g. on a link which stays below the clean threshold
+    RTPVideoHandler *handler = [RTPVideoHandler videoHandler];
+    if ([handler keyframeDistance] == self.minKeyframeDistance)
+        return;
+
+    self.recoveryCount++;
+
+    DLog(@"KeyframePolicy: recovery, keyframe distance %d", self.minKeyframeDistance);
+    [handler setKeyframeDistance:self.minKeyframeDistance];
+}
+
++(KeyframePolicy *) instance
+{
+    static KeyframePolicy *policy = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        policy = [[KeyframePolicy alloc] init];
+    });
+    return policy;
+}
+
+@end
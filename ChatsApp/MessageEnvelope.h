@@ -0,0 +1,246 @@
+//
+//  MessageEnvelope.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 08/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <Security/Security.h>
+
+#define MESSAGE_ENVELOPE_PREFIX         @"SCE1:"
+#define MESSAGE_SESSION_KEY_LENGTH      64
+#define MESSAGE_KEY_ID_LENGTH           8
+#define MESSAGE_RECIPIENT_ID_LENGTH     8
+
+extern NSString * const MessageEnvelopeErrorDomain;
+
+typedef enum {
+    MessageEnvelopeErrorMissingKey = 1,     // The receiver or a group member has no public key
+    MessageEnvelopeErrorGroupTooLarge,      // The wrapped keys of all members exceed the 64 KB key table
+    MessageEnvelopeErrorCrypto              // Creating or wrapping the session key failed
+} MessageEnvelopeErrorT;
+
+/** Source of the RSA keys used to wrap session keys. */
+@protocol MessageEnvelopeKeyProvider <NSObject>
+
+/** Public key of a user.
+
+ @param userid - The user
+ @return Retained public key or NULL if the user has no key
+ */
+-(SecKeyRef) copyPublicKeyForUserid:(NSString *) userid;
+
+/** Private key of the current user.
+
+ @return Retained private key or NULL
+ */
+-(SecKeyRef) copyPrivateKey;
+
+@end
+
+/** Symmetric session key of a conversation.
+
+ The key material holds an AES-256 key and an HMAC-SHA256 key. The wrapped key is the key
+ material encrypted with the public key of the receiver and is sent along with every message,
+ the receiver unwraps it only once per key id.
+
+ A group key is wrapped once per member, the wrapped key is then a table of all wrapped keys
+ by recipient, so the payload is encrypted only once for the whole group.
+ */
+@interface MessageSessionKey : NSObject
+
+/** Random key identifier. */
+@property(nonatomic, readonly) NSData *keyId;
+
+/** Key material encrypted for the receiver. */
+@property(nonatomic, readonly) NSData *wrappedKey;
+
+/** Creation time of the key. */
+@property(nonatomic, readonly) NSDate *created;
+
+/** YES if the key is wrapped for multiple recipients. */
+@property(nonatomic, readonly) BOOL group;
+
+/** Messages sealed with this key. */
+@property(nonatomic, readonly) NSUInteger messageCount;
+
+/** Initialize with existing key material.
+
+ @param keyId - Key identifier of MESSAGE_KEY_ID_LENGTH bytes
+ @param keyMaterial - Key material of MESSAGE_SESSION_KEY_LENGTH bytes
+ @param wrappedKey - Wrapped key material sent with each message
+ */
+-(id) initWithKeyId:(NSData *) keyId keyMaterial:(NSData *) keyMaterial wrappedKey:(NSData *) wrappedKey;
+
+/** Initialize a group key with existing key material.
+
+ @param keyId - Key identifier of MESSAGE_KEY_ID_LENGTH bytes
+ @param keyMaterial - Key material of MESSAGE_SESSION_KEY_LENGTH bytes
+ @param wrappedKeys - Wrapped key material by userid
+ */
+-(id) initWithKeyId:(NSData *) keyId keyMaterial:(NSData *) keyMaterial wrappedKeys:(NSDictionary *) wrappedKeys;
+
+/** Create a new random session key wrapped with a public key.
+
+ @param publicKey - RSA public key of the receiver
+ @return The session key or nil on error
+ */
++(MessageSessionKey *) sessionKeyWrappedWithPublicKey:(SecKeyRef) publicKey;
+
+/** Create a new random group key wrapped for every member, the members are wrapped in parallel.
+
+ @param publicKeys - RSA public keys (SecKeyRef) by userid
+ @return The session key or nil on error, also if wrapping failed for any member
+ */
++(MessageSessionKey *) sessionKeyWrappedWithPublicKeys:(NSDictionary *) publicKeys;
+
+/** Encrypt and authenticate data.
+
+ @param data - The plain data
+ @return The binary envelope
+ */
+-(NSData *) seal:(NSData *) data;
+
+/** Verify and decrypt an envelope sealed with this key.
+
+ @param envelope - The binary envelope
+ @return The plain data or nil, if the envelope was not sealed with this key or has been modified
+ */
+-(NSData *) open:(NSData *) envelope;
+
+/** Key identifier of a binary envelope. */
++(NSData *) keyIdOfEnvelope:(NSData *) envelope;
+
+/** Wrapped key of a binary envelope. */
++(NSData *) wrappedKeyOfEnvelope:(NSData *) envelope;
+
+/** YES if the envelope has been sealed with a group key. */
++(BOOL) isGroupEnvelope:(NSData *) envelope;
+
+/** Find the wrapped key of a recipient in the wrapped key of a group envelope.
+
+ @param userid - The recipient
+ @param wrappedKeys - Wrapped key of a group envelope
+ @return The wrapped key of the recipient or nil
+ */
++(NSData *) wrappedKeyForRecipient:(NSString *) userid inWrappedKeys:(NSData *) wrappedKeys;
+
+@end
+
+/** Envelope encryption for instant messages.
+
+ The SDK message encryption uses a 2048-bit RSA operation for every message sent and received.
+ With envelopes, every conversation has a symmetric session key, RSA-wrapped once when the key
+ is created and rotated after rotationMessageCount messages or rotationInterval.
+ Messages are sealed with AES-256-CBC and HMAC-SHA256 (encrypt-then-MAC) and sent as
+ MESSAGE_ENVELOPE_PREFIX text. Unwrapped session keys of received messages are cached per sender
+ and key id, so the receiver needs one RSA private key operation per rotation instead of one per message.
+
+ Group messages are encrypted once with a group session key, which is wrapped for every member.
+ The group key is rotated like a conversation key and whenever the group members change.
+ A group envelope is only created when every member has a public key, and its key table
+ of all wrapped keys must fit into 64 KB: at most 246 members with 2048-bit keys.
+
+ The app does not use envelopes yet: the SDK exposes neither the private key of the account
+ nor the certificates of other users, so there is no key provider. Chat messages are sent by the
+ SDK controllers with the SDK encryption, and received envelopes are not opened. A sender
+ has to call submitMessage:toUser: and the app startOpeningReceivedMessages once a key provider is set.
+ */
+@interface MessageEnvelope : NSObject
+
+/** Provider of the RSA keys. Without a provider, messages are sent with the SDK encryption. */
+@property(nonatomic, weak) id<MessageEnvelopeKeyProvider> keyProvider;
+
+/** Messages per session key before rotation. Default is 1000. */
+@property(nonatomic) NSUInteger rotationMessageCount;
+
+/** Session key lifetime before rotation. Default is 24h. */
+@property(nonatomic) NSTimeInterval rotationInterval;
+
+/** Number of RSA public and private key operations, for comparison with per message encryption. */
+@property(nonatomic, readonly) NSUInteger keyOperations;
+
+/** Seal a message for a user.
+
+ @param message - The message
+ @param userid - The receiver
+ @return Envelope text or nil if no public key is available for the receiver
+ */
+-(NSString *) sealMessage:(NSString *) message forUser:(NSString *) userid;
+
+/** Seal a message for all members of a group.
+
+ @param message - The message
+ @param groupid - The group
+ @param error - MessageEnvelopeErrorDomain error if no envelope can be created
+ @return Envelope text or nil if a member has no public key or the group is too large
+ */
+-(NSString *) sealMessage:(NSString *) message forGroup:(NSString *) groupid error:(NSError **) error;
+
+/** Seal data for all members of a group, e.g. an attachment. The data is encrypted once.
+
+ Not called by the app: attachments are uploaded by the SDK, which encrypts them itself.
+
+ @param data - The data
+ @param groupid - The group
+ @param error - MessageEnvelopeErrorDomain error if no envelope can be created
+ @return Binary envelope or nil if a member has no public key or the group is too large
+ */
+-(NSData *) sealData:(NSData *) data forGroup:(NSString *) groupid error:(NSError **) error;
+
+/** Open a received binary envelope.
+
+ @param envelope - Binary envelope
+ @param userid - The sender, the current user for sent envelopes
+ @return The data or nil if the envelope cannot be opened
+ */
+-(NSData *) openData:(NSData *) envelope fromUser:(NSString *) userid;
+
+/** Open a received envelope.
+
+ @param envelope - Envelope text
+ @param userid - The sender, the current user for sent envelopes
+ @return The message or nil if the envelope cannot be opened
+ */
+-(NSString *) openMessage:(NSString *) envelope fromUser:(NSString *) userid;
+
+/** Submit a message sealed for the receiver, falls back to the SDK encryption if no envelope can be created.
+
+ @param message - The message
+ @param userid - The receiver
+ */
+-(void) submitMessage:(NSString *) message toUser:(NSString *) userid;
+
+/** Submit a message sealed for all members of a group, falls back to the SDK encryption if no envelope can be created,
+ e.g. because a member has no public key.
+
+ Not called by the app: group messages are sent by the SDK chat controller, and without a keyProvider
+ every group message would fall back to the SDK encryption anyway.
+
+ @param message - The message
+ @param groupid - The group
+ */
+-(void) submitMessage:(NSString *) message toGroup:(NSString *) groupid;
+
+/** Force a new session key for the next message to a user or group. */
+-(void) rotateKeyForUser:(NSString *) userid;
+
+/** Replace the text of received envelopes in the message store with the opened message.
+
+ Does nothing without a keyProvider. Only messages inserted into the main context of the SDK are opened. The RSA operation runs
+ in background, the event is updated on the main thread afterwards.
+ */
+-(void) startOpeningReceivedMessages;
+
+/** Stop opening received envelopes. */
+-(void) stopOpeningReceivedMessages;
+
+/** YES if the text is an envelope. */
++(BOOL) isEnvelope:(NSString *) text;
+
+/** @return shared instance */
++(MessageEnvelope *) instance;
+
+@end
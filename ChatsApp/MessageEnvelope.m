@@ -0,0 +1,684 @@
+//
+//  MessageEnvelope.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 08/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <CommonCrypto/CommonCryptor.h>
+#import <CommonCrypto/CommonHMAC.h>
+#import <CommonCrypto/CommonDigest.h>
+#import <CoreData/CoreData.h>
+#import <libkern/OSAtomic.h>
+#import <SocialCommunication/SIPPhone.h>
+#import <SocialCommunication/MOC2CallEvent.h>
+#import <SocialCommunication/SCDataManager.h>
+#import <SocialCommunication/SCGroup.h>
+#import <SocialCommunication/SCUserProfile.h>
+#import <SocialCommunication/debug.h>
+
+#import "MessageEnvelope.h"
+
+#define ENVELOPE_VERSION        1
+#define ENVELOPE_VERSION_GROUP  2
+#define ENVELOPE_IV_LENGTH      kCCBlockSizeAES128
+#define ENVELOPE_TAG_LENGTH     CC_SHA256_DIGEST_LENGTH
+#define ENCRYPTION_KEY_LENGTH   kCCKeySizeAES256
+#define RECEIVED_KEYS_LIMIT     256
+#define KEY_TABLE_LIMIT         0xffff
+
+NSString * const MessageEnvelopeErrorDomain = @"MessageEnvelope";
+
+// version | key id | wrapped key length (16 bit big endian) | wrapped key | iv | ciphertext | tag
+// For group envelopes the wrapped key is a table: count (16 bit) | count * (recipient id | length (16 bit) | wrapped key)
+typedef struct {
+    NSRange     keyId;
+    NSRange     wrappedKey;
+    NSRange     iv;
+    NSRange     ciphertext;
+    NSRange     tag;
+} EnvelopeLayout;
+
+static BOOL parseEnvelope(NSData *envelope, EnvelopeLayout *layout)
+{
+    const uint8_t *bytes = [envelope bytes];
+    NSUInteger length = [envelope length];
+    NSUInteger headerLength = 1 + MESSAGE_KEY_ID_LENGTH + 2;
+
+    if (length < headerLength || (bytes[0] != ENVELOPE_VERSION && bytes[0] != ENVELOPE_VERSION_GROUP))
+        return NO;
+
+    NSUInteger wrappedLength = (bytes[headerLength - 2] << 8) | bytes[headerLength - 1];
+    NSUInteger fixedLength = headerLength + wrappedLength + ENVELOPE_IV_LENGTH + ENVELOPE_TAG_LENGTH;
+    if (length < fixedLength + kCCBlockSizeAES128)
+        return NO;
+
+    NSUInteger ciphertextLength = length - fixedLength;
+    if (ciphertextLength % kCCBlockSizeAES128 != 0)
+        return NO;
+
+    layout->keyId = NSMakeRange(1, MESSAGE_KEY_ID_LENGTH);
+    layout->wrappedKey = NSMakeRange(headerLength, wrappedLength);
+    layout->iv = NSMakeRange(NSMaxRange(layout->wrappedKey), ENVELOPE_IV_LENGTH);
+    layout->ciphertext = NSMakeRange(NSMaxRange(layout->iv), ciphertextLength);
+    layout->tag = NSMakeRange(NSMaxRange(layout->ciphertext), ENVELOPE_TAG_LENGTH);
+    return YES;
+}
+
+static NSData *recipientId(NSString *userid)
+{
+    NSData *data = [userid dataUsingEncoding:NSUTF8StringEncoding];
+    uint8_t digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256([data bytes], (CC_LONG) [data length], digest);
+    return [NSData dataWithBytes:digest length:MESSAGE_RECIPIENT_ID_LENGTH];
+}
+
+static void appendLength(NSMutableData *data, NSUInteger length)
+{
+    uint8_t bytes[2] = {(length >> 8) & 0xff, length & 0xff};
+    [data appendBytes:bytes length:2];
+}
+
+static NSData *randomData(size_t length)
+{
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    if (SecRandomCopyBytes(kSecRandomDefault, length, [data mutableBytes]) != 0)
+        return nil;
+    return data;
+}
+
+@interface MessageSessionKey () {
+    uint8_t     keyMaterial[MESSAGE_SESSION_KEY_LENGTH];
+}
+
+@property(nonatomic, readwrite) NSUInteger messageCount;
+@property(nonatomic, readwrite) BOOL group;
+
+@end
+
+@implementation MessageSessionKey
+
+-(id) initWithKeyId:(NSData *) keyId keyMaterial:(NSData *) material wrappedKey:(NSData *) wrappedKey
+{
+    if ([keyId length] != MESSAGE_KEY_ID_LENGTH || [material length] != MESSAGE_SESSION_KEY_LENGTH || [wrappedKey length] > 0xffff)
+        return nil;
+
+    self = [super init];
+    if (self) {
+        _keyId = [keyId copy];
+        _wrappedKey = [wrappedKey copy] ?: [NSData data];
+        _created = [NSDate date];
+        [material getBytes:keyMaterial length:MESSAGE_SESSION_KEY_LENGTH];
+    }
+    return self;
+}
+
+-(id) initWithKeyId:(NSData *) keyId keyMaterial:(NSData *) material wrappedKeys:(NSDictionary *) wrappedKeys
+{
+    NSMutableData *table = [NSMutableData data];
+    appendLength(table, [wrappedKeys count]);
+
+    for (NSString *userid in wrappedKeys) {
+        NSData *wrapped = wrappedKeys[userid];
+        [table appendData:recipientId(userid)];
+        appendLength(table, [wrapped length]);
+        [table appendData:wrapped];
+    }
+
+    self = [self initWithKeyId:keyId keyMaterial:material wrappedKey:table];
+    if (self) {
+        self.group = YES;
+    }
+    return self;
+}
+
+-(void) dealloc
+{
+    memset(keyMaterial, 0, sizeof(keyMaterial));
+}
+
++(NSData *) wrapKeyMaterial:(NSData *) material withPublicKey:(SecKeyRef) publicKey
+{
+    size_t wrappedLength = SecKeyGetBlockSize(publicKey);
+    NSMutableData *wrapped = [NSMutableData dataWithLength:wrappedLength];
+    OSStatus status = SecKeyEncrypt(publicKey, kSecPaddingOAEP, [material bytes], [material length], [wrapped mutableBytes], &wrappedLength);
+    if (status != errSecSuccess) {
+        DLog(@"MessageSessionKey: wrapping failed: %d", (int) status);
+        return nil;
+    }
+    [wrapped setLength:wrappedLength];
+    return wrapped;
+}
+
++(MessageSessionKey *) sessionKeyWrappedWithPublicKey:(SecKeyRef) publicKey
+{
+    NSData *material = randomData(MESSAGE_SESSION_KEY_LENGTH);
+    NSData *keyId = randomData(MESSAGE_KEY_ID_LENGTH);
+    if (!material || !keyId || !publicKey)
+        return nil;
+
+    NSData *wrapped = [self wrapKeyMaterial:material withPublicKey:publicKey];
+    if (!wrapped)
+        return nil;
+
+    return [[MessageSessionKey alloc] initWithKeyId:keyId keyMaterial:material wrappedKey:wrapped];
+}
+
++(MessageSessionKey *) sessionKeyWrappedWithPublicKeys:(NSDictionary *) publicKeys
+{
+    NSData *material = randomData(MESSAGE_SESSION_KEY_LENGTH);
+    NSData *keyId = randomData(MESSAGE_KEY_ID_LENGTH);
+    if (!material || !keyId || [publicKeys count] == 0)
+        return nil;
+
+    // One RSA operation per member, independent of each other
+    NSArray *userids = [publicKeys allKeys];
+    NSMutableDictionary *wrappedKeys = [NSMutableDictionary dictionaryWithCapacity:[userids count]];
+    dispatch_apply([userids count], dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        NSString *userid = userids[i];
+        NSData *wrapped = [self wrapKeyMaterial:material withPublicKey:(__bridge SecKeyRef) publicKeys[userid]];
+        if (wrapped) {
+            @synchronized(wrappedKeys) {
+                wrappedKeys[userid] = wrapped;
+            }
+        }
+    });
+
+    // A member without wrapped key could not read the message
+    if ([wrappedKeys count] != [userids count])
+        return nil;
+
+    return [[MessageSessionKey alloc] initWithKeyId:keyId keyMaterial:material wrappedKeys:wrappedKeys];
+}
+
+-(NSData *) authenticationTag:(NSData *) envelope length:(NSUInteger) length
+{
+    NSMutableData *tag = [NSMutableData dataWithLength:ENVELOPE_TAG_LENGTH];
+    CCHmac(kCCHmacAlgSHA256, keyMaterial + ENCRYPTION_KEY_LENGTH, MESSAGE_SESSION_KEY_LENGTH - ENCRYPTION_KEY_LENGTH, [envelope bytes], length, [tag mutableBytes]);
+    return tag;
+}
+
+-(NSData *) seal:(NSData *) data
+{
+    NSData *iv = randomData(ENVELOPE_IV_LENGTH);
+    if (!iv)
+        return nil;
+
+    NSUInteger wrappedLength = [self.wrappedKey length];
+    uint8_t header[1 + MESSAGE_KEY_ID_LENGTH + 2];
+    header[0] = self.group ? ENVELOPE_VERSION_GROUP : ENVELOPE_VERSION;
+    [self.keyId getBytes:header + 1 length:MESSAGE_KEY_ID_LENGTH];
+    header[sizeof(header) - 2] = (wrappedLength >> 8) & 0xff;
+    header[sizeof(header) - 1] = wrappedLength & 0xff;
+
+    NSMutableData *envelope = [NSMutableData dataWithCapacity:sizeof(header) + wrappedLength + ENVELOPE_IV_LENGTH + [data length] + kCCBlockSizeAES128 + ENVELOPE_TAG_LENGTH];
+    [envelope appendBytes:header length:sizeof(header)];
+    [envelope appendData:self.wrappedKey];
+    [envelope appendData:iv];
+
+    NSUInteger offset = [envelope length];
+    size_t ciphertextLength = 0;
+    [envelope setLength:offset + [data length] + kCCBlockSizeAES128];
+    CCCryptorStatus status = CCCrypt(kCCEncrypt, kCCAlgorithmAES128, kCCOptionPKCS7Padding, keyMaterial, ENCRYPTION_KEY_LENGTH, [iv bytes],
+                                     [data bytes], [data length], (uint8_t *)[envelope mutableBytes] + offset, [data length] + kCCBlockSizeAES128, &ciphertextLength);
+    if (status != kCCSuccess)
+        return nil;
+
+    [envelope setLength:offset + ciphertextLength];
+    [envelope appendData:[self authenticationTag:envelope length:[envelope length]]];
+
+    @synchronized(self) {
+        self.messageCount++;
+    }
+    return envelope;
+}
+
+-(NSData *) open:(NSData *) envelope
+{
+    EnvelopeLayout layout;
+    if (!parseEnvelope(envelope, &layout))
+        return nil;
+
+    if (![[envelope subdataWithRange:layout.keyId] isEqualToData:self.keyId])
+        return nil;
+
+    // Constant time comparison of the tag
+    NSData *expected = [self authenticationTag:envelope length:layout.tag.location];
+    const uint8_t *tag = (const uint8_t *)[envelope bytes] + layout.tag.location;
+    const uint8_t *expectedTag = [expected bytes];
+    uint8_t difference = 0;
+    for (int i = 0; i < ENVELOPE_TAG_LENGTH; i++) {
+        difference |= tag[i] ^ expectedTag[i];
+    }
+    if (difference != 0)
+        return nil;
+
+    NSMutableData *data = [NSMutableData dataWithLength:layout.ciphertext.length];
+    size_t dataLength = 0;
+    const uint8_t *bytes = [envelope bytes];
+    CCCryptorStatus status = CCCrypt(kCCDecrypt, kCCAlgorithmAES128, kCCOptionPKCS7Padding, keyMaterial, ENCRYPTION_KEY_LENGTH, bytes + layout.iv.location,
+                                     bytes + layout.ciphertext.location, layout.ciphertext.length, [data mutableBytes], [data length], &dataLength);
+    if (status != kCCSuccess)
+        return nil;
+
+    [data setLength:dataLength];
+    return data;
+}
+
++(NSData *) keyIdOfEnvelope:(NSData *) envelope
+{
+    EnvelopeLayout layout;
+    return parseEnvelope(envelope, &layout) ? [envelope subdataWithRange:layout.keyId] : nil;
+}
+
++(NSData *) wrappedKeyOfEnvelope:(NSData *) envelope
+{
+    EnvelopeLayout layout;
+    return parseEnvelope(envelope, &layout) ? [envelope subdataWithRange:layout.wrappedKey] : nil;
+}
+
++(BOOL) isGroupEnvelope:(NSData *) envelope
+{
+    EnvelopeLayout layout;
+    return parseEnvelope(envelope, &layout) && ((const uint8_t *)[envelope bytes])[0] == ENVELOPE_VERSION_GROUP;
+}
+
++(NSData *) wrappedKeyForRecipient:(NSString *) userid inWrappedKeys:(NSData *) wrappedKeys
+{
+    const uint8_t *bytes = [wrappedKeys bytes];
+    NSUInteger length = [wrappedKeys length];
+    if (!userid || length < 2)
+        return nil;
+
+    NSData *recipient = recipientId(userid);
+    NSUInteger count = (bytes[0] << 8) | bytes[1];
+    NSUInteger offset = 2;
+
+    for (NSUInteger i = 0; i < count; i++) {
+        if (offset + MESSAGE_RECIPIENT_ID_LENGTH + 2 > length)
+            return nil;
+
+        const uint8_t *entry = bytes + offset;
+        NSUInteger wrappedLength = (entry[MESSAGE_RECIPIENT_ID_LENGTH] << 8) | entry[MESSAGE_RECIPIENT_ID_LENGTH + 1];
+        NSUInteger wrappedOffset = offset + MESSAGE_RECIPIENT_ID_LENGTH + 2;
+        if (wrappedOffset + wrappedLength > length)
+            return nil;
+
+        if (memcmp(entry, [recipient bytes], MESSAGE_RECIPIENT_ID_LENGTH) == 0)
+            return [wrappedKeys subdataWithRange:NSMakeRange(wrappedOffset, wrappedLength)];
+
+        offset = wrappedOffset + wrappedLength;
+    }
+    return nil;
+}
+
+@end
+
+@interface MessageEnvelope () {
+    volatile int32_t    keyOperationCount;
+}
+
+@property(nonatomic, strong) NSMutableDictionary *sendKeys;
+@property(nonatomic, strong) NSMutableDictionary *groupKeyMembers;
+@property(nonatomic, strong) NSCache *receivedKeys;
+@property(nonatomic, strong) dispatch_queue_t openQueue;
+@property(nonatomic, strong) NSManagedObjectContext *observedContext;
+@property(nonatomic) BOOL openingReceivedMessages;
+
+@end
+
+@implementation MessageEnvelope
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.rotationMessageCount = 1000;
+        self.rotationInterval = 24. * 3600.;
+        self.sendKeys = [NSMutableDictionary dictionary];
+        self.groupKeyMembers = [NSMutableDictionary dictionary];
+        self.receivedKeys = [[NSCache alloc] init];
+        self.receivedKeys.countLimit = RECEIVED_KEYS_LIMIT;
+        self.openQueue = dispatch_queue_create("MessageEnvelope.open", DISPATCH_QUEUE_SERIAL);
+    }
+    return self;
+}
+
+-(void) dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+-(NSUInteger) keyOperations
+{
+    return keyOperationCount;
+}
+
++(BOOL) isEnvelope:(NSString *) text
+{
+    return [text hasPrefix:MESSAGE_ENVELOPE_PREFIX];
+}
+
+#pragma mark Session Keys
+
+// Key ids are chosen by the sender, so a cached key is only used for envelopes of the same sender
+-(id) receivedKeyCacheKeyForSender:(NSString *) sender keyId:(NSData *) keyId
+{
+    return @[sender ?: @"", keyId];
+}
+
+-(BOOL) needsRotation:(MessageSessionKey *) key
+{
+    if (!key)
+        return YES;
+
+    if (self.rotationMessageCount > 0 && key.messageCount >= self.rotationMessageCount)
+        return YES;
+
+    return self.rotationInterval > 0 && -[key.created timeIntervalSinceNow] >= self.rotationInterval;
+}
+
+-(MessageSessionKey *) sendKeyForUser:(NSString *) userid
+{
+    @synchronized(self.sendKeys) {
+        MessageSessionKey *key = self.sendKeys[userid];
+        if (![self needsRotation:key])
+            return key;
+    }
+
+    SecKeyRef publicKey = [self.keyProvider copyPublicKeyForUserid:userid];
+    if (!publicKey)
+        return nil;
+
+    MessageSessionKey *key = [MessageSessionKey sessionKeyWrappedWithPublicKey:publicKey];
+    CFRelease(publicKey);
+    OSAtomicIncrement32(&keyOperationCount);
+
+    if (!key)
+        return nil;
+
+    DLog(@"MessageEnvelope: new session key for %@", userid);
+    @synchronized(self.sendKeys) {
+        self.sendKeys[userid] = key;
+    }
+
+    // Sent messages are stored as envelopes as well
+    [self.receivedKeys setObject:key forKey:[self receivedKeyCacheKeyForSender:[SCUserProfile currentUser].userid keyId:key.keyId]];
+    return key;
+}
+
+-(id) failWithCode:(MessageEnvelopeErrorT) code error:(NSError **) error
+{
+    if (error)
+        *error = [NSError errorWithDomain:MessageEnvelopeErrorDomain code:code userInfo:nil];
+    return nil;
+}
+
+-(MessageSessionKey *) sendKeyForGroup:(NSString *) groupid error:(NSError **) error
+{
+    NSSet *members = [NSSet setWithArray:[[[SCGroup alloc] initWithGroupid:groupid] groupMembers] ?: @[]];
+    if ([members count] == 0)
+        return [self failWithCode:MessageEnvelopeErrorMissingKey error:error];
+
+    @synchronized(self.sendKeys) {
+        MessageSessionKey *key = self.sendKeys[groupid];
+        if (![self needsRotation:key] && [self.groupKeyMembers[groupid] isEqualToSet:members])
+            return key;
+    }
+
+    // Every member must be able to read the message, else it goes out with the SDK encryption
+    NSMutableDictionary *publicKeys = [NSMutableDictionary dictionaryWithCapacity:[members count]];
+    NSUInteger tableLength = 2;
+    for (NSString *userid in members) {
+        SecKeyRef publicKey = [self.keyProvider copyPublicKeyForUserid:userid];
+        if (!publicKey) {
+            DLog(@"MessageEnvelope: no public key for %@ in group %@", userid, groupid);
+            return [self failWithCode:MessageEnvelopeErrorMissingKey error:error];
+        }
+
+        tableLength += MESSAGE_RECIPIENT_ID_LENGTH + 2 + SecKeyGetBlockSize(publicKey);
+        publicKeys[userid] = (__bridge_transfer id) publicKey;
+    }
+
+    // The key table length is a 16 bit field, checked before any RSA operation
+    if (tableLength > KEY_TABLE_LIMIT) {
+        DLog(@"MessageEnvelope: group %@ too large for a key table, %lu members", groupid, (unsigned long) [members count]);
+        return [self failWithCode:MessageEnvelopeErrorGroupTooLarge error:error];
+    }
+
+    MessageSessionKey *key = [MessageSessionKey sessionKeyWrappedWithPublicKeys:publicKeys];
+    OSAtomicAdd32((int32_t) [publicKeys count], &keyOperationCount);
+
+    if (!key)
+        return [self failWithCode:MessageEnvelopeErrorCrypto error:error];
+
+    DLog(@"MessageEnvelope: new group key for %@, %lu members", groupid, (unsigned long) [members count]);
+    @synchronized(self.sendKeys) {
+        self.sendKeys[groupid] = key;
+        self.groupKeyMembers[groupid] = members;
+    }
+
+    [self.receivedKeys setObject:key forKey:[self receivedKeyCacheKeyForSender:[SCUserProfile currentUser].userid keyId:key.keyId]];
+    return key;
+}
+
+-(MessageSessionKey *) receivedKeyForEnvelope:(NSData *) envelope fromUser:(NSString *) sender
+{
+    NSData *keyId = [MessageSessionKey keyIdOfEnvelope:envelope];
+    if (!keyId)
+        return nil;
+
+    id cacheKey = [self receivedKeyCacheKeyForSender:sender keyId:keyId];
+    MessageSessionKey *key = [self.receivedKeys objectForKey:cacheKey];
+    if (key)
+        return key;
+
+    SecKeyRef privateKey = [self.keyProvider copyPrivateKey];
+    if (!privateKey)
+        return nil;
+
+    NSData *wrapped = [MessageSessionKey wrappedKeyOfEnvelope:envelope];
+    if ([MessageSessionKey isGroupEnvelope:envelope])
+        wrapped = [MessageSessionKey wrappedKeyForRecipient:[SCUserProfile currentUser].userid inWrappedKeys:wrapped];
+
+    if (!wrapped) {
+        CFRelease(privateKey);
+        return nil;
+    }
+
+    size_t materialLength = SecKeyGetBlockSize(privateKey);
+    NSMutableData *material = [NSMutableData dataWithLength:materialLength];
+    OSStatus status = SecKeyDecrypt(privateKey, kSecPaddingOAEP, [wrapped bytes], [wrapped length], [material mutableBytes], &materialLength);
+    CFRelease(privateKey);
+    OSAtomicIncrement32(&keyOperationCount);
+
+    if (status != errSecSuccess) {
+        DLog(@"MessageEnvelope: unwrapping failed: %d", (int) status);
+        return nil;
+    }
+    [material setLength:materialLength];
+
+    key = [[MessageSessionKey alloc] initWithKeyId:keyId keyMaterial:material wrappedKey:wrapped];
+    [material resetBytesInRange:NSMakeRange(0, [material length])];
+
+    if (key)
+        [self.receivedKeys setObject:key forKey:cacheKey];
+    return key;
+}
+
+-(void) rotateKeyForUser:(NSString *) userid
+{
+    @synchronized(self.sendKeys) {
+        [self.sendKeys removeObjectForKey:userid];
+        [self.groupKeyMembers removeObjectForKey:userid];
+    }
+}
+
+#pragma mark Messages
+
+-(NSString *) sealMessage:(NSString *) message forUser:(NSString *) userid
+{
+    if (!message || !userid)
+        return nil;
+
+    MessageSessionKey *key = [self sendKeyForUser:userid];
+    return [self envelopeText:[key seal:[message dataUsingEncoding:NSUTF8StringEncoding]]];
+}
+
+-(NSString *) sealMessage:(NSString *) message forGroup:(NSString *) groupid error:(NSError **) error
+{
+    if (!message || !groupid)
+        return nil;
+
+    return [self envelopeText:[self sealData:[message dataUsingEncoding:NSUTF8StringEncoding] forGroup:groupid error:error]];
+}
+
+-(NSData *) sealData:(NSData *) data forGroup:(NSString *) groupid error:(NSError **) error
+{
+    if (!data || !groupid)
+        return nil;
+
+    MessageSessionKey *key = [self sendKeyForGroup:groupid error:error];
+    if (!key)
+        return nil;
+
+    NSData *envelope = [key seal:data];
+    if (!envelope)
+        return [self failWithCode:MessageEnvelopeErrorCrypto error:error];
+    return envelope;
+}
+
+-(NSString *) envelopeText:(NSData *) envelope
+{
+    if (!envelope)
+        return nil;
+
+    return [MESSAGE_ENVELOPE_PREFIX stringByAppendingString:[envelope base64EncodedStringWithOptions:0]];
+}
+
+-(NSData *) openData:(NSData *) envelope fromUser:(NSString *) userid
+{
+    return [[self receivedKeyForEnvelope:envelope fromUser:userid] open:envelope];
+}
+
+-(NSString *) openMessage:(NSString *) text fromUser:(NSString *) userid
+{
+    if (![MessageEnvelope isEnvelope:text])
+        return nil;
+
+    NSData *envelope = [[NSData alloc] initWithBase64EncodedString:[text substringFromIndex:[MESSAGE_ENVELOPE_PREFIX length]] options:0];
+    NSData *data = [self openData:envelope fromUser:userid];
+    if (!data)
+        return nil;
+
+    return [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+}
+
+-(void) submitMessage:(NSString *) message toUser:(NSString *) userid
+{
+    NSString *envelope = self.keyProvider ? [self sealMessage:message forUser:userid] : nil;
+    if (envelope) {
+        [[SIPPhone currentPhone] submitMessage:envelope toUser:userid preferEncryption:NO];
+    } else {
+        [[SIPPhone currentPhone] submitMessage:message toUser:userid preferEncryption:YES];
+    }
+}
+
+-(void) submitMessage:(NSString *) message toGroup:(NSString *) groupid
+{
+    NSError *error = nil;
+    NSString *envelope = self.keyProvider ? [self sealMessage:message forGroup:groupid error:&error] : nil;
+    if (error)
+        DLog(@"MessageEnvelope: group %@ falls back to SDK encryption: %@", groupid, error);
+
+    if (envelope) {
+        [[SIPPhone currentPhone] submitMessage:envelope toUser:groupid preferEncryption:NO];
+    } else {
+        [[SIPPhone currentPhone] submitMessage:message toUser:groupid preferEncryption:YES];
+    }
+}
+
+#pragma mark Received Messages
+
+-(void) startOpeningReceivedMessages
+{
+    if (self.openingReceivedMessages)
+        return;
+
+    // Without the private key no envelope can be opened, don't watch every insert for nothing
+    if (!self.keyProvider) {
+        DLog(@"MessageEnvelope: no key provider, received messages are not opened");
+        return;
+    }
+
+    // The SDK exposes its main context only through the objects it creates
+    NSFetchRequest *request = [[SCDataManager instance] fetchRequestForChatHistory:NO];
+    NSManagedObjectContext *context = [[SCDataManager instance] fetchedResultsControllerWithFetchRequest:request sectionNameKeyPath:nil cacheName:nil].managedObjectContext;
+    if (!context) {
+        DLog(@"MessageEnvelope: SDK data not initialized, received messages are not opened");
+        return;
+    }
+
+    self.openingReceivedMessages = YES;
+    self.observedContext = context;
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(objectsDidChange:) name:NSManagedObjectContextObjectsDidChangeNotification object:context];
+}
+
+-(void) stopOpeningReceivedMessages
+{
+    if (!self.openingReceivedMessages)
+        return;
+
+    self.openingReceivedMessages = NO;
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:NSManagedObjectContextObjectsDidChangeNotification object:self.observedContext];
+    self.observedContext = nil;
+}
+
+-(void) objectsDidChange:(NSNotification *) notification
+{
+    NSString *currentUser = [SCUserProfile currentUser].userid;
+
+    for (id object in notification.userInfo[NSInsertedObjectsKey]) {
+        if (![object isKindOfClass:[MOC2CallEvent class]])
+            continue;
+
+        MOC2CallEvent *event = object;
+        NSString *text = event.text;
+        if (![MessageEnvelope isEnvelope:text])
+            continue;
+
+        // A group message names the member in originalSender, sent envelopes use our own keys
+        NSString *sender = currentUser;
+        if ([event.eventType isEqualToString:@"MessageIn"])
+            sender = event.originalSender ?: event.contact;
+
+        // Unwrapping a new key is an RSA operation, keep it out of the notification
+        dispatch_async(self.openQueue, ^{
+            NSString *message = [self openMessage:text fromUser:sender];
+            if (!message)
+                return;
+
+            dispatch_async(dispatch_get_main_queue(), ^{
+                // The event may have been deleted or changed in the meantime
+                if (event.isDeleted || !event.managedObjectContext || ![event.text isEqualToString:text])
+                    return;
+
+                event.text = message;
+                event.encrypted = @YES;
+            });
+        });
+    }
+}
+
++(MessageEnvelope *) instance
+{
+    static MessageEnvelope *envelope = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        envelope = [[MessageEnvelope alloc] init];
+    });
+    return envelope;
+}
+
+@end
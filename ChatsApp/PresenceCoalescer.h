@@ -0,0 +1,76 @@
+//
+//  PresenceCoalescer.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 12/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/** Handler for a batch of presence changes.
+
+ @param changes - New SipOnlineStatusT as NSNumber by userid, only users whose status has changed
+ */
+typedef void (^PresenceChangeHandler)(NSDictionary *changes);
+
+/** Coalesces friend presence updates into batches.
+
+ SCFriendList reports every online status change, and every other change of a friend, as a separate
+ update event. At login or after a network change hundreds of NOTIFYs arrive within a second, and a
+ handler reloading its table for every event reloads hundreds of times. PresenceCoalescer collects the
+ events for window seconds and delivers one diff to each handler: the last status of every user
+ whose status differs from the last delivered one. A user going offline and online again within the
+ window, and updates which do not change the status, are not delivered at all.
+
+ All methods must be called on the main thread, handlers are called on the main thread.
+ FriendListController registers a handler while visible.
+ */
+@interface PresenceCoalescer : NSObject
+
+/** Time to collect updates before delivery. Default is 0.3s. */
+@property(nonatomic) NSTimeInterval window;
+
+/** Number of presence updates received. */
+@property(nonatomic, readonly) NSUInteger updateCount;
+
+/** Number of batches delivered. */
+@property(nonatomic, readonly) NSUInteger deliveryCount;
+
+/** Register a handler for presence changes.
+
+ @param handler - The handler
+ @return Token for removeHandler:
+ */
+-(id) addHandler:(PresenceChangeHandler) handler;
+
+/** Remove a handler.
+
+ @param token - Token returned by addHandler:
+ */
+-(void) removeHandler:(id) token;
+
+/** Report the status of a user, delivered with the next batch.
+
+ @param onlineStatus - SipOnlineStatusT
+ @param userid - The user
+ */
+-(void) setOnlineStatus:(NSInteger) onlineStatus forUserid:(NSString *) userid;
+
+/** Last delivered status of a user.
+
+ @param userid - The user
+ @return SipOnlineStatusT, OS_OFFLINE if unknown
+ */
+-(NSInteger) onlineStatusForUserid:(NSString *) userid;
+
+/** Deliver the collected changes now. */
+-(void) flush;
+
+/** Register for updated and removed friends with SCFriendList, updates are reported on the main thread. */
+-(void) start;
+
+/** @return shared instance */
++(PresenceCoalescer *) instance;
+
+@end
@@ -0,0 +1,145 @@
+//
+//  PresenceCoalescer.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 12/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <SocialCommunication/SCFriendList.h>
+#import <SocialCommunication/MOC2CallUser.h>
+#import <SocialCommunication/SIPConstants.h>
+
+#import "PresenceCoalescer.h"
+
+@interface PresenceCoalescer ()
+
+@property(nonatomic, strong) NSMutableDictionary *pending;
+@property(nonatomic, strong) NSMutableDictionary *delivered;
+@property(nonatomic, strong) NSMutableDictionary *handlers;
+@property(nonatomic) NSUInteger flushGeneration;
+@property(nonatomic) BOOL flushScheduled;
+@property(nonatomic) BOOL registeredForFriends;
+@property(nonatomic, readwrite) NSUInteger updateCount;
+@property(nonatomic, readwrite) NSUInteger deliveryCount;
+
+@end
+
+@implementation PresenceCoalescer
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.window = 0.3;
+        self.pending = [NSMutableDictionary dictionary];
+        self.delivered = [NSMutableDictionary dictionary];
+        self.handlers = [NSMutableDictionary dictionary];
+    }
+    return self;
+}
+
+-(id) addHandler:(PresenceChangeHandler) handler
+{
+    if (!handler)
+        return nil;
+
+    NSUUID *token = [NSUUID UUID];
+    self.handlers[token] = [handler copy];
+    return token;
+}
+
+-(void) removeHandler:(id) token
+{
+    if (token)
+        [self.handlers removeObjectForKey:token];
+}
+
+-(void) setOnlineStatus:(NSInteger) onlineStatus forUserid:(NSString *) userid
+{
+    if (!userid)
+        return;
+
+    self.updateCount++;
+    self.pending[userid] = @(onlineStatus);
+
+    if (self.flushScheduled)
+        return;
+
+    self.flushScheduled = YES;
+    NSUInteger generation = self.flushGeneration;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.window * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        // Skip if flushed in the meantime
+        if (generation == self.flushGeneration)
+            [self flush];
+    });
+}
+
+-(NSInteger) onlineStatusForUserid:(NSString *) userid
+{
+    NSNumber *status = userid ? self.delivered[userid] : nil;
+    return status ? [status integerValue] : OS_OFFLINE;
+}
+
+-(void) flush
+{
+    self.flushScheduled = NO;
+    self.flushGeneration++;
+
+    if ([self.pending count] == 0)
+        return;
+
+    NSMutableDictionary *changes = [NSMutableDictionary dictionaryWithCapacity:[self.pending count]];
+    [self.pending enumerateKeysAndObjectsUsingBlock:^(NSString *userid, NSNumber *status, BOOL *stop) {
+        if ([status integerValue] != [self onlineStatusForUserid:userid])
+            changes[userid] = status;
+    }];
+    [self.pending removeAllObjects];
+
+    if ([changes count] == 0)
+        return;
+
+    [self.delivered addEntriesFromDictionary:changes];
+    self.deliveryCount++;
+
+    // Handlers may remove themselves
+    for (PresenceChangeHandler handler in [self.handlers allValues]) {
+        handler(changes);
+    }
+}
+
+-(void) start
+{
+    if (self.registeredForFriends)
+        return;
+
+    self.registeredForFriends = YES;
+
+    // SCFriendList may report from a background thread, read the user there and report on main
+    __weak PresenceCoalescer *weakself = self;
+    [[SCFriendList instance] registerForUpdatedFriends:^(MOC2CallUser *user) {
+        NSString *userid = user.userid;
+        NSInteger status = [user.online boolValue] ? [user.onlineStatus integerValue] : OS_OFFLINE;
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [weakself setOnlineStatus:status forUserid:userid];
+        });
+    }];
+    [[SCFriendList instance] registerForRemovedFriends:^(MOC2CallUser *user) {
+        NSString *userid = user.userid;
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [weakself setOnlineStatus:OS_OFFLINE forUserid:userid];
+        });
+    }];
+}
+
++(PresenceCoalescer *) instance
+{
+    static PresenceCoalescer *coalescer = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        coalescer = [[PresenceCoalescer alloc] init];
+    });
+    return coalescer;
+}
+
+@end
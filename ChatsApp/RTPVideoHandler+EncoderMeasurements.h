@@ -0,0 +1,31 @@
+//
+//  RTPVideoHandler+EncoderMeasurements.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 30/05/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <SocialCommunication/RTPVideoHandler.h>
+
+/** Access to the encoder measurements of the video handler.
+
+ RTPVideoHandler has no accessors for them, the values are read through KVC from two instance
+ variables declared in RTPVideoHandler.h:
+
+ - averageEncodingTime, an NSTimeInterval, taken as seconds per encoded frame.
+ - currentResolution, taken as an SCVideoResolutionT index where a lower index is a lower
+   resolution (VIDEO_RES_NORMAL < VIDEO_RES_HIGH < VIDEO_RES_HD).
+
+ If an SDK version renames an instance variable the fallback value is returned, the missing
+ variable is logged once.
+ */
+@interface RTPVideoHandler (EncoderMeasurements)
+
+/** Average encoding time per frame in seconds, -1 if not available. */
+-(NSTimeInterval) measuredEncodingTime;
+
+/** Index of the current capture resolution, 0 if not available. */
+-(int) measuredResolution;
+
+@end
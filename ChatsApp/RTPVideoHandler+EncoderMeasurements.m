@@ -0,0 +1,47 @@
+//
+//  RTPVideoHandler+EncoderMeasurements.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 30/05/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <objc/runtime.h>
+#import <SocialCommunication/debug.h>
+
+#import "RTPVideoHandler+EncoderMeasurements.h"
+
+@implementation RTPVideoHandler (EncoderMeasurements)
+
+-(double) instanceValueForKey:(NSString *) key fallback:(double) fallback
+{
+    // Renamed in another SDK version, don't raise NSUndefinedKeyException for every sample
+    if (!class_getInstanceVariable([RTPVideoHandler class], [key UTF8String])) {
+        static dispatch_once_t onceToken;
+        dispatch_once(&onceToken, ^{
+            DLog(@"RTPVideoHandler: no instance variable %@", key);
+        });
+        return fallback;
+    }
+
+    @try {
+        id value = [self valueForKey:key];
+        if ([value respondsToSelector:@selector(doubleValue)])
+            return [value doubleValue];
+    }
+    @catch (NSException *exception) {
+    }
+    return fallback;
+}
+
+-(NSTimeInterval) measuredEncodingTime
+{
+    return [self instanceValueForKey:@"averageEncodingTime" fallback:-1.];
+}
+
+-(int) measuredResolution
+{
+    return (int) [self instanceValueForKey:@"currentResolution" fallback:0.];
+}
+
+@end
@@ -0,0 +1,102 @@
+//
+//  RateTable.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 13/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/** Source of rate table updates. */
+@protocol RateTableSource <NSObject>
+
+/** Fetch the rate table.
+
+ @param version - Version of the local table, nil if there is none
+ @param completion - To be called once with a full table, a delta against version or nil if the table
+    is up to date. Can be called on any thread.
+ */
+-(void) fetchRateTableSinceVersion:(NSString *) version completion:(void (^)(NSData *data)) completion;
+
+@end
+
+/** Local PSTN and SMS price lookup by longest dialing prefix.
+
+ The SDK asks the server for the price of every number (getPriceForNumber:), the dial pad on every
+ keystroke. RateTable keeps the rates in a digit trie, a lookup walks at most one node per digit and
+ answers without network round trip.
+
+ Tables and deltas are zlib compressed UTF-8 text:
+
+    version<TAB>new version<TAB>base version     (base version empty for a full table)
+    prefix<TAB>call price<TAB>SMS price           (empty price for none)
+    prefix                                        (delta only, removes the prefix)
+
+ Prefixes are international numbers without +. Updates are parsed on a background queue and
+ replace the table at once, lookups always see a complete table.
+
+ The app does not use the table yet. The SDK has no rate table endpoint, so there is no source,
+ and the SDK dial pad and message controllers query prices themselves and cannot be pointed at
+ the table. It is meant for app code showing prices, once a source exists.
+ */
+@interface RateTable : NSObject
+
+/** Source of updates. */
+@property(nonatomic, weak) id<RateTableSource> source;
+
+/** Country code without + for national numbers, e.g. @"49". Default is the SDK country code setting. */
+@property(nonatomic, strong) NSString *countryCode;
+
+/** Version of the table, nil if empty. */
+@property(nonatomic, readonly) NSString *version;
+
+/** Number of prefixes with a price. */
+@property(nonatomic, readonly) NSUInteger prefixCount;
+
+/** Number of lookups which fell back to the server. */
+@property(nonatomic, readonly) NSUInteger serverQueryCount;
+
+/** Initialize with the table file, the file is read if it exists.
+
+ @param path - Path of the table file, nil for a memory only table
+ */
+-(id) initWithPath:(NSString *) path;
+
+/** Apply a full table or a delta, and write the table file.
+
+ @param data - Compressed table or delta
+ @return NO if the data is invalid or the delta has a different base version
+ */
+-(BOOL) loadData:(NSData *) data;
+
+/** Price for the longest matching prefix.
+
+ @param number - Phone number in any format
+ @param isSMS - YES for the SMS price, NO for the call price
+ @return Price info or nil if no prefix matches
+ */
+-(NSString *) priceForNumber:(NSString *) number isSMS:(BOOL) isSMS;
+
+/** Price from the table, or a server query if no prefix matches.
+
+ @param number - Phone number in any format
+ @param isSMS - YES for the SMS price, NO for the call price
+ @return Price info or nil if the server has been queried, the SDK delivers the answer as usual
+ */
+-(NSString *) priceInfoForNumber:(NSString *) number isSMS:(BOOL) isSMS;
+
+/** Fetch an update from the source in the background. */
+-(void) update;
+
+/** Compress a table or delta.
+
+ @param text - Table in the text format
+ @return Compressed data
+ */
++(NSData *) compressedTable:(NSString *) text;
+
+/** @return shared instance */
++(RateTable *) instance;
+
+@end
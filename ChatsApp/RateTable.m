@@ -0,0 +1,437 @@
+//
+//  RateTable.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 13/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <zlib.h>
+#import <libkern/OSAtomic.h>
+#import <SocialCommunication/C2CallConstants.h>
+#import <SocialCommunication/C2CallHandler.h>
+#import <SocialCommunication/debug.h>
+
+#import "RateTable.h"
+
+#define RATE_TABLE_FILE     @"RateTable.z"
+#define MAX_DIALED_DIGITS   32
+#define NO_NODE             -1
+#define NO_PRICE            -1
+
+typedef struct {
+    int32_t firstChild;
+    int32_t nextSibling;
+    int32_t price[2];       // Index in prices, call and SMS
+    uint8_t digit;
+} RateTrieNode;
+
+static NSData *inflateData(NSData *data)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.next_in = (Bytef *) [data bytes];
+    stream.avail_in = (uInt) [data length];
+
+    if ([data length] == 0 || inflateInit(&stream) != Z_OK)
+        return nil;
+
+    NSMutableData *inflated = [NSMutableData dataWithLength:[data length] * 4 + 1024];
+    int status;
+    do {
+        if (stream.total_out >= [inflated length])
+            [inflated increaseLengthBy:[inflated length]];
+
+        stream.next_out = (Bytef *) [inflated mutableBytes] + stream.total_out;
+        stream.avail_out = (uInt) ([inflated length] - stream.total_out);
+        status = inflate(&stream, Z_NO_FLUSH);
+    } while (status == Z_OK);
+
+    [inflated setLength:stream.total_out];
+    inflateEnd(&stream);
+    return status == Z_STREAM_END ? inflated : nil;
+}
+
+#pragma mark RateTrie
+
+// Digit trie, nodes are stored in one buffer with first child / next sibling links
+@interface RateTrie : NSObject
+
+@property(nonatomic, strong) NSMutableData *nodes;
+@property(nonatomic, strong) NSMutableArray *prices;
+@property(nonatomic, strong) NSMutableDictionary *priceIndex;
+@property(nonatomic, strong) NSString *version;
+@property(nonatomic) NSUInteger prefixCount;
+
+@end
+
+@implementation RateTrie
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.nodes = [NSMutableData data];
+        self.prices = [NSMutableArray array];
+        self.priceIndex = [NSMutableDictionary dictionary];
+        [self appendNodeWithDigit:0];
+    }
+    return self;
+}
+
+-(RateTrie *) mutableTrie
+{
+    RateTrie *trie = [[RateTrie alloc] init];
+    trie.nodes = [self.nodes mutableCopy];
+    trie.prices = [self.prices mutableCopy];
+    trie.priceIndex = [self.priceIndex mutableCopy];
+    trie.version = self.version;
+    trie.prefixCount = self.prefixCount;
+    return trie;
+}
+
+-(int32_t) appendNodeWithDigit:(uint8_t) digit
+{
+    RateTrieNode node = { NO_NODE, NO_NODE, { NO_PRICE, NO_PRICE }, digit };
+    [self.nodes appendBytes:&node length:sizeof(node)];
+    return (int32_t) ([self.nodes length] / sizeof(node)) - 1;
+}
+
+-(int32_t) childOfNode:(int32_t) parent digit:(uint8_t) digit
+{
+    const RateTrieNode *nodes = [self.nodes bytes];
+    for (int32_t child = nodes[parent].firstChild; child != NO_NODE; child = nodes[child].nextSibling) {
+        if (nodes[child].digit == digit)
+            return child;
+    }
+    return NO_NODE;
+}
+
+-(int32_t) nodeForPrefix:(NSString *) prefix create:(BOOL) create
+{
+    int32_t node = 0;
+    for (NSUInteger i = 0; i < [prefix length]; i++) {
+        uint8_t digit = (uint8_t) ([prefix characterAtIndex:i] - '0');
+        int32_t child = [self childOfNode:node digit:digit];
+
+        if (child == NO_NODE) {
+            if (!create)
+                return NO_NODE;
+
+            child = [self appendNodeWithDigit:digit];
+            RateTrieNode *nodes = [self.nodes mutableBytes];
+            nodes[child].nextSibling = nodes[node].firstChild;
+            nodes[node].firstChild = child;
+        }
+        node = child;
+    }
+    return node;
+}
+
+-(int32_t) indexOfPrice:(NSString *) price
+{
+    if ([price length] == 0)
+        return NO_PRICE;
+
+    NSNumber *index = self.priceIndex[price];
+    if (!index) {
+        index = @([self.prices count]);
+        [self.prices addObject:price];
+        self.priceIndex[price] = index;
+    }
+    return [index intValue];
+}
+
+-(void) setCallPrice:(NSString *) callPrice smsPrice:(NSString *) smsPrice forPrefix:(NSString *) prefix
+{
+    BOOL hasPrice = [callPrice length] > 0 || [smsPrice length] > 0;
+    int32_t node = [self nodeForPrefix:prefix create:hasPrice];
+    if (node == NO_NODE)
+        return;
+
+    int32_t call = [self indexOfPrice:callPrice], sms = [self indexOfPrice:smsPrice];
+
+    RateTrieNode *nodes = [self.nodes mutableBytes];
+    BOOL hadPrice = nodes[node].price[0] != NO_PRICE || nodes[node].price[1] != NO_PRICE;
+    nodes[node].price[0] = call;
+    nodes[node].price[1] = sms;
+
+    if (hasPrice && !hadPrice)
+        self.prefixCount++;
+    else if (!hasPrice && hadPrice)
+        self.prefixCount--;
+}
+
+-(NSString *) priceForDigits:(const uint8_t *) digits length:(NSUInteger) length kind:(int) kind
+{
+    const RateTrieNode *nodes = [self.nodes bytes];
+    int32_t node = 0, price = NO_PRICE;
+
+    for (NSUInteger i = 0; i < length; i++) {
+        int32_t child = nodes[node].firstChild;
+        while (child != NO_NODE && nodes[child].digit != digits[i]) {
+            child = nodes[child].nextSibling;
+        }
+        if (child == NO_NODE)
+            break;
+
+        node = child;
+        if (nodes[node].price[kind] != NO_PRICE)
+            price = nodes[node].price[kind];
+    }
+    return price == NO_PRICE ? nil : self.prices[price];
+}
+
+-(void) appendNode:(int32_t) node prefix:(NSMutableString *) prefix toText:(NSMutableString *) text
+{
+    const RateTrieNode *nodes = [self.nodes bytes];
+    RateTrieNode current = nodes[node];
+
+    if (current.price[0] != NO_PRICE || current.price[1] != NO_PRICE) {
+        [text appendFormat:@"%@\t%@\t%@\n", prefix,
+         current.price[0] == NO_PRICE ? @"" : self.prices[current.price[0]],
+         current.price[1] == NO_PRICE ? @"" : self.prices[current.price[1]]];
+    }
+
+    for (int32_t child = current.firstChild; child != NO_NODE; child = nodes[child].nextSibling) {
+        [prefix appendFormat:@"%d", nodes[child].digit];
+        [self appendNode:child prefix:prefix toText:text];
+        [prefix deleteCharactersInRange:NSMakeRange([prefix length] - 1, 1)];
+    }
+}
+
+-(NSString *) text
+{
+    NSMutableString *text = [NSMutableString stringWithFormat:@"version\t%@\t\n", self.version];
+    [self appendNode:0 prefix:[NSMutableString string] toText:text];
+    return text;
+}
+
+@end
+
+#pragma mark RateTable
+
+@interface RateTable () {
+    volatile int32_t    serverQueries;
+}
+
+@property(atomic, strong) RateTrie *trie;
+@property(nonatomic, strong) NSString *path;
+@property(nonatomic, strong) dispatch_queue_t queue;
+@property(nonatomic) BOOL updating;
+
+@end
+
+@implementation RateTable
+
+-(id) initWithPath:(NSString *) path
+{
+    self = [super init];
+    if (self) {
+        NSString *countryCode = [[NSUserDefaults standardUserDefaults] stringForKey:DEFAULT_COUNTRYCODE];
+        self.countryCode = [[countryCode componentsSeparatedByCharactersInSet:[[NSCharacterSet decimalDigitCharacterSet] invertedSet]] componentsJoinedByString:@""];
+
+        self.path = path;
+        self.trie = [[RateTrie alloc] init];
+        self.queue = dispatch_queue_create("RateTable", DISPATCH_QUEUE_SERIAL);
+
+        NSData *data = path ? [NSData dataWithContentsOfFile:path] : nil;
+        if (data && ![self applyData:data])
+            DLog(@"RateTable: invalid table file %@", path);
+    }
+    return self;
+}
+
+- (id)init
+{
+    return [self initWithPath:nil];
+}
+
+-(NSString *) version
+{
+    return self.trie.version;
+}
+
+-(NSUInteger) prefixCount
+{
+    return self.trie.prefixCount;
+}
+
+#pragma mark Update
+
+-(BOOL) isPrefix:(NSString *) prefix
+{
+    if ([prefix length] == 0 || [prefix length] > MAX_DIALED_DIGITS)
+        return NO;
+
+    for (NSUInteger i = 0; i < [prefix length]; i++) {
+        unichar c = [prefix characterAtIndex:i];
+        if (c < '0' || c > '9')
+            return NO;
+    }
+    return YES;
+}
+
+-(BOOL) applyData:(NSData *) data
+{
+    NSData *inflated = inflateData(data);
+    NSString *text = inflated ? [[NSString alloc] initWithData:inflated encoding:NSUTF8StringEncoding] : nil;
+    NSArray *lines = [text componentsSeparatedByString:@"\n"];
+    NSArray *header = [[lines firstObject] componentsSeparatedByString:@"\t"];
+
+    if ([header count] != 3 || ![header[0] isEqualToString:@"version"] || [header[1] length] == 0)
+        return NO;
+
+    @synchronized(self) {
+        // A delta is applied to a copy, lookups keep using the current table until it is complete
+        NSString *base = header[2];
+        RateTrie *current = self.trie;
+        RateTrie *trie = nil;
+
+        if ([base length] == 0)
+            trie = [[RateTrie alloc] init];
+        else if ([base isEqualToString:current.version])
+            trie = [current mutableTrie];
+        else
+            return NO;
+
+        for (NSUInteger i = 1; i < [lines count]; i++) {
+            NSArray *fields = [lines[i] componentsSeparatedByString:@"\t"];
+            if (![self isPrefix:fields[0]])
+                continue;
+
+            if ([fields count] == 1)
+                [trie setCallPrice:nil smsPrice:nil forPrefix:fields[0]];
+            else if ([fields count] == 3)
+                [trie setCallPrice:fields[1] smsPrice:fields[2] forPrefix:fields[0]];
+        }
+
+        trie.version = header[1];
+        self.trie = trie;
+    }
+    return YES;
+}
+
+-(BOOL) loadData:(NSData *) data
+{
+    if (![self applyData:data])
+        return NO;
+
+    if (self.path && ![[RateTable compressedTable:[self.trie text]] writeToFile:self.path atomically:YES])
+        DLog(@"RateTable: failed to write %@", self.path);
+
+    return YES;
+}
+
+-(void) update
+{
+    id<RateTableSource> source = self.source;
+    if (!source)
+        return;
+
+    dispatch_async(self.queue, ^{
+        if (self.updating)
+            return;
+
+        self.updating = YES;
+        [source fetchRateTableSinceVersion:self.version completion:^(NSData *data) {
+            dispatch_async(self.queue, ^{
+                self.updating = NO;
+                if (data && ![self loadData:data])
+                    DLog(@"RateTable: update %@ rejected", self.version);
+            });
+        }];
+    });
+}
+
+#pragma mark Lookup
+
+-(NSUInteger) dialedDigits:(uint8_t *) digits forNumber:(NSString *) number
+{
+    NSString *trimmed = [number stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+    NSUInteger length = 0;
+
+    for (NSUInteger i = 0; i < [trimmed length] && length < MAX_DIALED_DIGITS; i++) {
+        unichar c = [trimmed characterAtIndex:i];
+        if (c >= '0' && c <= '9')
+            digits[length++] = (uint8_t) (c - '0');
+    }
+
+    if ([trimmed hasPrefix:@"+"] || length == 0)
+        return length;
+
+    // International prefix 00, or national number with trunk prefix 0
+    NSUInteger skip = 0;
+    NSString *countryCode = nil;
+    if (length >= 2 && digits[0] == 0 && digits[1] == 0) {
+        skip = 2;
+    } else if (digits[0] == 0 && [self.countryCode length] > 0) {
+        skip = 1;
+        countryCode = self.countryCode;
+    }
+
+    uint8_t dialed[MAX_DIALED_DIGITS];
+    NSUInteger dialedLength = 0;
+    for (NSUInteger i = 0; i < [countryCode length] && dialedLength < MAX_DIALED_DIGITS; i++) {
+        dialed[dialedLength++] = (uint8_t) ([countryCode characterAtIndex:i] - '0');
+    }
+    for (NSUInteger i = skip; i < length && dialedLength < MAX_DIALED_DIGITS; i++) {
+        dialed[dialedLength++] = digits[i];
+    }
+
+    memcpy(digits, dialed, dialedLength);
+    return dialedLength;
+}
+
+-(NSString *) priceForNumber:(NSString *) number isSMS:(BOOL) isSMS
+{
+    uint8_t digits[MAX_DIALED_DIGITS];
+    NSUInteger length = [self dialedDigits:digits forNumber:number];
+    if (length == 0)
+        return nil;
+
+    return [self.trie priceForDigits:digits length:length kind:isSMS ? 1 : 0];
+}
+
+-(NSString *) priceInfoForNumber:(NSString *) number isSMS:(BOOL) isSMS
+{
+    NSString *price = [self priceForNumber:number isSMS:isSMS];
+    if (!price && number) {
+        OSAtomicIncrement32(&serverQueries);
+        [[C2CallHandler defaultHandler] queryPriceForNumber:number isSMS:isSMS];
+    }
+    return price;
+}
+
+-(NSUInteger) serverQueryCount
+{
+    return serverQueries;
+}
+
+#pragma mark Static Methods
+
++(NSData *) compressedTable:(NSString *) text
+{
+    NSData *data = [text dataUsingEncoding:NSUTF8StringEncoding];
+    uLongf length = compressBound((uLong) [data length]);
+    NSMutableData *compressed = [NSMutableData dataWithLength:length];
+
+    if (compress2([compressed mutableBytes], &length, [data bytes], (uLong) [data length], Z_BEST_COMPRESSION) != Z_OK)
+        return nil;
+
+    [compressed setLength:length];
+    return compressed;
+}
+
++(RateTable *) instance
+{
+    static RateTable *table = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        NSString *directory = [NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES) firstObject];
+        table = [[RateTable alloc] initWithPath:[directory stringByAppendingPathComponent:RATE_TABLE_FILE]];
+    });
+    return table;
+}
+
+@end
@@ -0,0 +1,58 @@
+//
+//  ScreenShareCapturer.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 04/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <UIKit/UIKit.h>
+#import <SocialCommunication/IOS.h>
+
+/** Screen content capture for sharing a view during a video call.
+
+ Alternative to [SCMediaManager startScreenSharingForView:] for mostly static content
+ like documents. The view is captured with a low frame rate at high resolution via
+ SCMediaManager useExternalVideoCapture, the camera output is paused meanwhile.
+ Changed regions are detected with tile hashes: unchanged frames are not submitted to the
+ encoder at all, apart from a keep alive frame. The SDK converts and encodes whole frames,
+ it has no way to submit a region, so the tiles only decide whether a frame is submitted.
+ Every frame is rendered into a fresh buffer from a pixel buffer pool, because the encoder
+ may still hold the buffers submitted before.
+
+ While sharing, EncoderLoadController and KeyframePolicy are suspended, so they don't
+ override the frame rate and keyframe distance chosen for screen content.
+ */
+@interface ScreenShareCapturer : NSObject
+
+/** Capture rate in frames per second. Default is 5. */
+@property(nonatomic) int frameRate;
+
+/** An unchanged frame is submitted after this interval to keep the stream alive. Default is 2s. */
+@property(nonatomic) NSTimeInterval keepAliveInterval;
+
+/** Maximum width of the captured image in pixels. Default is 1280. */
+@property(nonatomic) int maxWidth;
+
+/** Frames submitted to the encoder since sharing started. */
+@property(nonatomic, readonly) NSUInteger framesSubmitted;
+
+/** Unchanged frames skipped since sharing started. */
+@property(nonatomic, readonly) NSUInteger framesSkipped;
+
+/** YES while a view is shared. */
+@property(nonatomic, readonly) BOOL sharing;
+
+/** Start sharing the view.
+
+ @param shareView - The view to be shared
+ */
+-(void) startSharingView:(UIView *) shareView;
+
+/** Stop sharing and return to camera capture with the settings from before sharing. */
+-(void) stopSharing;
+
+/** @return shared instance */
++(ScreenShareCapturer *) instance;
+
+@end
@@ -0,0 +1,273 @@
+//
+//  ScreenShareCapturer.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 04/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <QuartzCore/QuartzCore.h>
+#import <AVFoundation/AVFoundation.h>
+#import <CoreMedia/CoreMedia.h>
+#import <CoreVideo/CoreVideo.h>
+#import <SocialCommunication/SCMediaManager.h>
+#import <SocialCommunication/RTPVideoHandler.h>
+#import <SocialCommunication/debug.h>
+
+#import "ScreenShareCapturer.h"
+#import "ScreenTileHasher.h"
+#import "EncoderLoadController.h"
+#import "KeyframePolicy.h"
+#import "RTPVideoHandler+EncoderMeasurements.h"
+
+#define TILE_SIZE               32
+#define KEYFRAME_SECONDS        10
+
+@interface ScreenShareCapturer () {
+    CGColorSpaceRef         colorSpace;
+    CVPixelBufferPoolRef    pixelBufferPool;
+    int                     captureWidth, captureHeight;
+    CFAbsoluteTime          lastSubmitted;
+    int                     savedFrameRate, savedKeyframeDistance, savedResolution;
+    AVCaptureDevicePosition savedCameraPosition;
+}
+
+@property(nonatomic, weak) UIView *shareView;
+@property(nonatomic, strong) NSTimer *captureTimer;
+@property(nonatomic, strong) ScreenTileHasher *tileHasher;
+@property(nonatomic, readwrite) NSUInteger framesSubmitted;
+@property(nonatomic, readwrite) NSUInteger framesSkipped;
+@property(nonatomic, readwrite) BOOL sharing;
+
+@end
+
+@implementation ScreenShareCapturer
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.frameRate = 5;
+        self.keepAliveInterval = 2.;
+        self.maxWidth = 1280;
+        self.tileHasher = [[ScreenTileHasher alloc] initWithTileSize:TILE_SIZE];
+    }
+    return self;
+}
+
+-(void) dealloc
+{
+    [self releaseBuffers];
+}
+
+-(void) releaseBuffers
+{
+    if (colorSpace) {
+        CGColorSpaceRelease(colorSpace);
+        colorSpace = NULL;
+    }
+    if (pixelBufferPool) {
+        CVPixelBufferPoolRelease(pixelBufferPool);
+        pixelBufferPool = NULL;
+    }
+    captureWidth = captureHeight = 0;
+}
+
+#pragma mark Sharing
+
+-(void) startSharingView:(UIView *) shareView
+{
+    if (self.sharing)
+        [self stopSharing];
+
+    if (!shareView || self.frameRate <= 0)
+        return;
+
+    self.shareView = shareView;
+    self.framesSubmitted = 0;
+    self.framesSkipped = 0;
+    lastSubmitted = 0;
+    [self.tileHasher reset];
+
+    // Screen content: high resolution, low frame rate, rare keyframes
+    RTPVideoHandler *handler = [RTPVideoHandler videoHandler];
+    savedFrameRate = [handler frameRate];
+    savedKeyframeDistance = [handler keyframeDistance];
+    savedResolution = [handler measuredResolution];
+    [IOS setVideoResolution:VIDEO_RES_HD];
+    [handler setFrameRate:self.frameRate];
+    [handler setKeyframeDistance:self.frameRate * KEYFRAME_SECONDS];
+
+    // The load controller and the keyframe policy would undo the settings above
+    [EncoderLoadController instance].suspended = YES;
+    [KeyframePolicy instance].suspended = YES;
+
+    // Pause the camera output, its frames would be interleaved with the screen frames.
+    // Unlike stopVideoCapture this keeps the registered capture delegates.
+    SCMediaManager *mediaManager = [SCMediaManager instance];
+    mediaManager.useExternalVideoCapture = YES;
+    savedCameraPosition = mediaManager.cameraPosition;
+    if (savedCameraPosition != AVCaptureDevicePositionUnspecified)
+        [mediaManager switchCamera:AVCaptureDevicePositionUnspecified];
+
+    self.captureTimer = [NSTimer scheduledTimerWithTimeInterval:1. / self.frameRate target:self selector:@selector(captureFrame:) userInfo:nil repeats:YES];
+    self.sharing = YES;
+}
+
+-(void) stopSharing
+{
+    if (!self.sharing)
+        return;
+
+    [self.captureTimer invalidate];
+    self.captureTimer = nil;
+    self.sharing = NO;
+
+    SCMediaManager *mediaManager = [SCMediaManager instance];
+    mediaManager.useExternalVideoCapture = NO;
+    if (savedCameraPosition != AVCaptureDevicePositionUnspecified)
+        [mediaManager switchCamera:savedCameraPosition];
+
+    RTPVideoHandler *handler = [RTPVideoHandler videoHandler];
+    if (savedFrameRate > 0)
+        [handler setFrameRate:savedFrameRate];
+    if (savedKeyframeDistance > 0)
+        [handler setKeyframeDistance:savedKeyframeDistance];
+    [IOS setVideoResolution:(SCVideoResolutionT) savedResolution];
+
+    [EncoderLoadController instance].suspended = NO;
+    [KeyframePolicy instance].suspended = NO;
+
+    DLog(@"ScreenShareCapturer: %lu frames submitted, %lu skipped", (unsigned long) self.framesSubmitted, (unsigned long) self.framesSkipped);
+    [self releaseBuffers];
+}
+
+#pragma mark Capture
+
+-(BOOL) prepareBuffersForWidth:(int) width height:(int) height
+{
+    if (width == captureWidth && height == captureHeight && colorSpace && pixelBufferPool)
+        return YES;
+
+    [self releaseBuffers];
+
+    colorSpace = CGColorSpaceCreateDeviceRGB();
+
+    NSDictionary *attributes = @{(id) kCVPixelBufferPixelFormatTypeKey : @(kCVPixelFormatType_32BGRA),
+                                 (id) kCVPixelBufferWidthKey : @(width),
+                                 (id) kCVPixelBufferHeightKey : @(height),
+                                 (id) kCVPixelBufferIOSurfacePropertiesKey : @{}};
+    CVReturn status = CVPixelBufferPoolCreate(kCFAllocatorDefault, NULL, (__bridge CFDictionaryRef) attributes, &pixelBufferPool);
+
+    if (!colorSpace || status != kCVReturnSuccess) {
+        [self releaseBuffers];
+        return NO;
+    }
+
+    captureWidth = width;
+    captureHeight = height;
+    [self.tileHasher reset];
+    return YES;
+}
+
+-(void) captureFrame:(NSTimer *) timer
+{
+    UIView *view = self.shareView;
+    if (!view) {
+        [self stopSharing];
+        return;
+    }
+
+    CGSize size = view.bounds.size;
+    if (size.width < 1. || size.height < 1.)
+        return;
+
+    CGFloat scale = MIN([UIScreen mainScreen].scale, self.maxWidth / size.width);
+    int width = ((int) (size.width * scale)) & ~1;
+    int height = ((int) (size.height * scale)) & ~1;
+    if (width <= 0 || height <= 0 || ![self prepareBuffersForWidth:width height:height])
+        return;
+
+    // A submitted buffer may still be in use by the encoder, render into a fresh one from the pool
+    CVPixelBufferRef pixelBuffer = NULL;
+    if (CVPixelBufferPoolCreatePixelBuffer(kCFAllocatorDefault, pixelBufferPool, &pixelBuffer) != kCVReturnSuccess)
+        return;
+
+    CVPixelBufferLockBaseAddress(pixelBuffer, 0);
+    uint8_t *pixels = CVPixelBufferGetBaseAddress(pixelBuffer);
+    size_t bytesPerRow = CVPixelBufferGetBytesPerRow(pixelBuffer);
+
+    CGContextRef context = CGBitmapContextCreate(pixels, width, height, 8, bytesPerRow, colorSpace, kCGImageAlphaPremultipliedFirst | kCGBitmapByteOrder32Little);
+    if (!context) {
+        CVPixelBufferUnlockBaseAddress(pixelBuffer, 0);
+        CVPixelBufferRelease(pixelBuffer);
+        return;
+    }
+
+    CGContextClearRect(context, CGRectMake(0, 0, width, height));
+    CGContextTranslateCTM(context, 0, height);
+    CGContextScaleCTM(context, scale, -scale);
+    [view.layer renderInContext:context];
+    CGContextRelease(context);
+
+    int changed = [self.tileHasher updateWithPixels:pixels width:width height:height bytesPerRow:bytesPerRow];
+    CVPixelBufferUnlockBaseAddress(pixelBuffer, 0);
+
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    if (changed == 0 && now - lastSubmitted < self.keepAliveInterval) {
+        // Unchanged, the buffer goes back to the pool
+        self.framesSkipped++;
+        CVPixelBufferRelease(pixelBuffer);
+        return;
+    }
+
+    [self submitPixelBuffer:pixelBuffer];
+    CVPixelBufferRelease(pixelBuffer);
+    lastSubmitted = now;
+    self.framesSubmitted++;
+}
+
+-(void) submitPixelBuffer:(CVPixelBufferRef) buffer
+{
+    CMVideoFormatDescriptionRef format = NULL;
+    if (CMVideoFormatDescriptionCreateForImageBuffer(kCFAllocatorDefault, buffer, &format) != noErr)
+        return;
+
+    CMSampleTimingInfo timing;
+    timing.duration = CMTimeMake(1, self.frameRate);
+    timing.presentationTimeStamp = CMTimeMakeWithSeconds(CACurrentMediaTime(), 1000000);
+    timing.decodeTimeStamp = kCMTimeInvalid;
+
+    CMSampleBufferRef sampleBuffer = NULL;
+    OSStatus status = CMSampleBufferCreateForImageBuffer(kCFAllocatorDefault, buffer, true, NULL, NULL, format, &timing, &sampleBuffer);
+    CFRelease(format);
+
+    if (status != noErr || !sampleBuffer)
+        return;
+
+    // The SDK expects the output and connection of its capture session, they stay in the session while the camera is paused
+    AVCaptureVideoDataOutput *output = [self videoDataOutput];
+    [[SCMediaManager instance] captureOutput:output didOutputSampleBuffer:sampleBuffer fromConnection:[output connectionWithMediaType:AVMediaTypeVideo]];
+    CFRelease(sampleBuffer);
+}
+
+-(AVCaptureVideoDataOutput *) videoDataOutput
+{
+    for (AVCaptureOutput *output in [SCMediaManager instance].videoCaptureSession.outputs) {
+        if ([output isKindOfClass:[AVCaptureVideoDataOutput class]])
+            return (AVCaptureVideoDataOutput *) output;
+    }
+    return nil;
+}
+
++(ScreenShareCapturer *) instance
+{
+    static ScreenShareCapturer *capturer = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        capturer = [[ScreenShareCapturer alloc] init];
+    });
+    return capturer;
+}
+
+@end
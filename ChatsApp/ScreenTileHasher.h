@@ -0,0 +1,44 @@
+//
+//  ScreenTileHasher.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 04/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/** Finds the changed regions between two successive 32 bit pixel images.
+
+ The image is divided into square tiles. For every tile a hash is kept,
+ so only a hash per tile needs to be stored to compare with the previous frame.
+ */
+@interface ScreenTileHasher : NSObject
+
+/** Tile size in pixels. */
+@property(nonatomic, readonly) int tileSize;
+
+/** Number of tiles per row and column of the last image. */
+@property(nonatomic, readonly) int tilesPerRow, tilesPerColumn;
+
+- (id)initWithTileSize:(int) tileSize;
+
+/** Hash the image and compare with the previous image.
+
+ A change of the image dimensions marks all tiles as changed.
+
+ @param pixels - 32 bit pixel data
+ @param width - Width in pixels
+ @param height - Height in pixels
+ @param bytesPerRow - Row stride in bytes
+ @return Number of changed tiles
+ */
+-(int) updateWithPixels:(const uint8_t *) pixels width:(int) width height:(int) height bytesPerRow:(size_t) bytesPerRow;
+
+/** YES if the tile at column / row changed with the last update. */
+-(BOOL) isTileChangedAtColumn:(int) column row:(int) row;
+
+/** Forget the previous image, the next update reports all tiles as changed. */
+-(void) reset;
+
+@end
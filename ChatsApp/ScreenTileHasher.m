@@ -0,0 +1,118 @@
+//
+//  ScreenTileHasher.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 04/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import "ScreenTileHasher.h"
+
+#define FNV_OFFSET      2166136261u
+#define FNV_PRIME       16777619u
+
+@interface ScreenTileHasher () {
+    uint32_t    *tileHashes;
+    uint8_t     *changedTiles;
+    int         width, height;
+}
+
+@property(nonatomic, readwrite) int tileSize;
+@property(nonatomic, readwrite) int tilesPerRow, tilesPerColumn;
+
+@end
+
+@implementation ScreenTileHasher
+
+- (id)initWithTileSize:(int) tileSize
+{
+    self = [super init];
+    if (self) {
+        self.tileSize = MAX(tileSize, 1);
+    }
+    return self;
+}
+
+- (id)init
+{
+    return [self initWithTileSize:32];
+}
+
+-(void) dealloc
+{
+    free(tileHashes);
+    free(changedTiles);
+}
+
+-(void) reset
+{
+    width = 0;
+    height = 0;
+}
+
+-(int) updateWithPixels:(const uint8_t *) pixels width:(int) newWidth height:(int) newHeight bytesPerRow:(size_t) bytesPerRow
+{
+    if (!pixels || newWidth <= 0 || newHeight <= 0)
+        return 0;
+
+    int tileSize = self.tileSize;
+    int columns = (newWidth + tileSize - 1) / tileSize;
+    int rows = (newHeight + tileSize - 1) / tileSize;
+    BOOL resized = newWidth != width || newHeight != height;
+
+    if (resized) {
+        free(tileHashes);
+        free(changedTiles);
+        tileHashes = calloc(columns * rows, sizeof(uint32_t));
+        changedTiles = calloc(columns * rows, sizeof(uint8_t));
+        if (!tileHashes || !changedTiles) {
+            free(tileHashes);
+            free(changedTiles);
+            tileHashes = NULL;
+            changedTiles = NULL;
+            width = height = 0;
+            return 0;
+        }
+        width = newWidth;
+        height = newHeight;
+        self.tilesPerRow = columns;
+        self.tilesPerColumn = rows;
+    }
+
+    int changed = 0;
+    for (int row = 0; row < rows; row++) {
+        int y0 = row * tileSize;
+        int y1 = MIN(y0 + tileSize, newHeight);
+
+        for (int column = 0; column < columns; column++) {
+            int x0 = column * tileSize;
+            int x1 = MIN(x0 + tileSize, newWidth);
+
+            uint32_t hash = FNV_OFFSET;
+            for (int y = y0; y < y1; y++) {
+                const uint32_t *line = (const uint32_t *) (pixels + y * bytesPerRow) + x0;
+                for (int x = 0; x < x1 - x0; x++) {
+                    hash = (hash ^ line[x]) * FNV_PRIME;
+                }
+            }
+
+            int tile = row * columns + column;
+            BOOL tileChanged = resized || tileHashes[tile] != hash;
+            tileHashes[tile] = hash;
+            changedTiles[tile] = tileChanged;
+            if (tileChanged)
+                changed++;
+        }
+    }
+    return changed;
+}
+
+-(BOOL) isTileChangedAtColumn:(int) column row:(int) row
+{
+    if (!changedTiles || column < 0 || row < 0 || column >= self.tilesPerRow || row >= self.tilesPerColumn)
+        return NO;
+
+    return changedTiles[row * self.tilesPerRow + column] != 0;
+}
+
+@end
@@ -0,0 +1,133 @@
+//
+//  StoreMigrator.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 14/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreData/CoreData.h>
+
+extern NSString * const StoreMigratorErrorDomain;
+
+typedef enum {
+    StoreMigratorErrorUnknownModel = 1,     // The store matches none of the model versions
+    StoreMigratorErrorNoMapping             // No mapping between two model versions
+} StoreMigratorErrorT;
+
+/** Progress handler, called on the migrating thread.
+
+ @param progress - 0.0 to 1.0
+ */
+typedef void (^StoreMigrationProgress)(float progress);
+
+/** Completion handler of a background migration, called on the main thread.
+
+ @param success - YES if all stores have been migrated
+ */
+typedef void (^StoreMigrationCompletion)(BOOL success);
+
+/** Migration of the SDK Core Data store from any model version to the current one.
+
+ Without it the store of a user upgrading from an old release is migrated by the SDK when the data is
+ initialized, version by version. StoreMigrator migrates before the SDK opens the store:
+
+ - From any version with an inferable mapping the store is migrated in one step with a lightweight
+   migration. For SQLite stores it runs as SQL inside the store, objects are never loaded into memory.
+ - Otherwise the store is migrated version by version with NSMigrationManager, using a mapping model
+   from the bundle or an inferred one. This reports fine grained progress.
+
+ Every step migrates a copy of the store, and the copy replaces the store only when it is complete.
+ An interrupted migration leaves the store at the last completed version and continues from there on
+ the next launch.
+
+ Stores up to synchronousMigrationLimit bytes in total can be migrated at launch on the main thread.
+ Larger stores take longer than the launch watchdog allows and are migrated in the background, the
+ app opens the SDK data when the migration has completed.
+ */
+@interface StoreMigrator : NSObject
+
+/** The current model version. */
+@property(nonatomic, readonly) NSManagedObjectModel *currentModel;
+
+/** All model versions, oldest first. */
+@property(nonatomic, readonly) NSArray *models;
+
+/** Total size of stores in bytes to migrate synchronously at launch. Default is 8 MB. */
+@property(nonatomic) unsigned long long synchronousMigrationLimit;
+
+/** Initialize with a versioned model.
+
+ @param modelURL - URL of the .momd directory
+ */
+-(id) initWithModelURL:(NSURL *) modelURL;
+
+/** Model version of a store.
+
+ @param storeURL - SQLite store
+ @return Model or nil if the store matches none of the versions
+ */
+-(NSManagedObjectModel *) modelForStoreAtURL:(NSURL *) storeURL;
+
+/** YES if the store has been created with an older model version. */
+-(BOOL) requiresMigrationOfStoreAtURL:(NSURL *) storeURL;
+
+/** Migrate a store to the current model version, does nothing if it is current already.
+
+ @param storeURL - SQLite store
+ @param progress - Progress handler or nil
+ @param error - Error on return
+ @return YES on success
+ */
+-(BOOL) migrateStoreAtURL:(NSURL *) storeURL progress:(StoreMigrationProgress) progress error:(NSError **) error;
+
+/** SQLite stores in a directory with an older model version.
+
+ A store matching none of the model versions is logged and left to the SDK.
+ */
+-(NSArray *) storesRequiringMigrationInDirectory:(NSURL *) directory;
+
+/** Stores in the Documents and Application Support directories which require migration. */
+-(NSArray *) storesRequiringMigration;
+
+/** Size of stores including their journal files.
+
+ @param stores - SQLite stores
+ @return Size in bytes
+ */
+-(unsigned long long) sizeOfStores:(NSArray *) stores;
+
+/** YES if the stores are small enough to be migrated synchronously at launch. */
+-(BOOL) canMigrateStoresSynchronously:(NSArray *) stores;
+
+/** Migrate stores on the calling thread, a failed store is logged and skipped.
+
+ @param stores - SQLite stores
+ @param progress - Progress of all stores or nil
+ @return YES if all stores have been migrated
+ */
+-(BOOL) migrateStores:(NSArray *) stores progress:(StoreMigrationProgress) progress;
+
+/** Migrate stores on a background queue.
+
+ @param stores - SQLite stores
+ @param progress - Progress of all stores, called on the main thread, or nil
+ @param completion - Completion handler, called on the main thread, or nil
+ */
+-(void) migrateStoresInBackground:(NSArray *) stores progress:(StoreMigrationProgress) progress completion:(StoreMigrationCompletion) completion;
+
+/** URL of the versioned model with all versions.
+
+ The app bundle only compiles the recent versions of C2CallDataModel. The build copies the full model
+ from SocialCommunication.framework/Resources to SocialCommunication/C2CallDataModel.momd in the main
+ bundle, the app model is used if it is missing.
+
+ @return URL of the .momd directory
+ */
++(NSURL *) modelURL;
+
+/** @return shared instance for modelURL */
++(StoreMigrator *) instance;
+
+@end
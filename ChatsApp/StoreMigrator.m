@@ -0,0 +1,379 @@
+//
+//  StoreMigrator.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 14/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <SocialCommunication/debug.h>
+
+#import "StoreMigrator.h"
+
+#define MODEL_NAME          @"C2CallDataModel"
+#define SDK_MODEL_DIRECTORY @"SocialCommunication"
+#define MIGRATION_SUFFIX    @".migrating"
+#define SYNCHRONOUS_LIMIT   (8ull * 1024 * 1024)
+
+NSString * const StoreMigratorErrorDomain = @"StoreMigrator";
+
+static void *StoreMigratorProgressContext = &StoreMigratorProgressContext;
+
+@interface StoreMigrator ()
+
+@property(nonatomic, readwrite) NSManagedObjectModel *currentModel;
+@property(nonatomic, readwrite) NSArray *models;
+
+// Progress of the running NSMigrationManager step
+@property(nonatomic, copy) StoreMigrationProgress stepProgress;
+@property(nonatomic) float stepOffset, stepScale;
+
+@end
+
+@implementation StoreMigrator
+
+-(id) initWithModelURL:(NSURL *) modelURL
+{
+    self = [super init];
+    if (self) {
+        self.synchronousMigrationLimit = SYNCHRONOUS_LIMIT;
+        self.currentModel = [[NSManagedObjectModel alloc] initWithContentsOfURL:modelURL];
+
+        // Versions are named "Model", "Model 2" ... "Model 17"
+        NSArray *urls = [[NSFileManager defaultManager] contentsOfDirectoryAtURL:modelURL includingPropertiesForKeys:nil options:0 error:nil];
+        NSMutableArray *versions = [NSMutableArray array];
+        for (NSURL *url in urls) {
+            if (![[url pathExtension] isEqualToString:@"mom"])
+                continue;
+
+            NSManagedObjectModel *model = [[NSManagedObjectModel alloc] initWithContentsOfURL:url];
+            NSArray *words = [[[url lastPathComponent] stringByDeletingPathExtension] componentsSeparatedByString:@" "];
+            NSInteger version = [words count] > 1 ? [[words lastObject] integerValue] : 1;
+            if (model)
+                [versions addObject:@[@(version), model]];
+        }
+
+        [versions sortUsingComparator:^NSComparisonResult(NSArray *a, NSArray *b) {
+            return [a[0] compare:b[0]];
+        }];
+        NSMutableArray *models = [NSMutableArray arrayWithCapacity:[versions count]];
+        for (NSArray *version in versions) {
+            [models addObject:version[1]];
+        }
+        self.models = models;
+    }
+    return self;
+}
+
+-(BOOL) failWithCode:(StoreMigratorErrorT) code error:(NSError **) error
+{
+    if (error)
+        *error = [NSError errorWithDomain:StoreMigratorErrorDomain code:code userInfo:nil];
+
+    return NO;
+}
+
+#pragma mark Model Versions
+
+-(NSManagedObjectModel *) modelForStoreAtURL:(NSURL *) storeURL
+{
+    NSDictionary *metadata = [NSPersistentStoreCoordinator metadataForPersistentStoreOfType:NSSQLiteStoreType URL:storeURL error:nil];
+    if (!metadata)
+        return nil;
+
+    if ([self.currentModel isConfiguration:nil compatibleWithStoreMetadata:metadata])
+        return self.currentModel;
+
+    for (NSManagedObjectModel *model in self.models) {
+        if ([model isConfiguration:nil compatibleWithStoreMetadata:metadata])
+            return model;
+    }
+    return nil;
+}
+
+-(BOOL) requiresMigrationOfStoreAtURL:(NSURL *) storeURL
+{
+    NSManagedObjectModel *model = [self modelForStoreAtURL:storeURL];
+    return model && model != self.currentModel;
+}
+
+-(NSUInteger) indexOfModel:(NSManagedObjectModel *) model
+{
+    NSUInteger index = [self.models indexOfObjectIdenticalTo:model];
+    if (index != NSNotFound)
+        return index;
+
+    return [self.models indexOfObjectPassingTest:^BOOL(NSManagedObjectModel *version, NSUInteger idx, BOOL *stop) {
+        return [version.entityVersionHashesByName isEqualToDictionary:model.entityVersionHashesByName];
+    }];
+}
+
+#pragma mark Files
+
+-(NSArray *) fileURLsOfStore:(NSURL *) storeURL
+{
+    NSString *path = [storeURL path];
+    return @[storeURL,
+             [NSURL fileURLWithPath:[path stringByAppendingString:@"-wal"]],
+             [NSURL fileURLWithPath:[path stringByAppendingString:@"-shm"]]];
+}
+
+-(void) removeStoreAtURL:(NSURL *) storeURL
+{
+    for (NSURL *url in [self fileURLsOfStore:storeURL]) {
+        [[NSFileManager defaultManager] removeItemAtURL:url error:nil];
+    }
+}
+
+-(NSURL *) migrationURLForStore:(NSURL *) storeURL
+{
+    return [NSURL fileURLWithPath:[[storeURL path] stringByAppendingString:MIGRATION_SUFFIX]];
+}
+
+-(BOOL) checkpointStoreAtURL:(NSURL *) storeURL model:(NSManagedObjectModel *) model error:(NSError **) error
+{
+    // Switching to rollback journal writes the WAL into the store, the store is a single file afterwards
+    NSPersistentStoreCoordinator *coordinator = [[NSPersistentStoreCoordinator alloc] initWithManagedObjectModel:model];
+    NSDictionary *options = @{NSSQLitePragmasOption : @{@"journal_mode" : @"DELETE"}};
+
+    NSPersistentStore *store = [coordinator addPersistentStoreWithType:NSSQLiteStoreType configuration:nil URL:storeURL options:options error:error];
+    if (!store)
+        return NO;
+
+    return [coordinator removePersistentStore:store error:error];
+}
+
+-(BOOL) replaceStoreAtURL:(NSURL *) storeURL withStoreAtURL:(NSURL *) migratedURL error:(NSError **) error
+{
+    // Both stores are single files, the replacement is atomic
+    return [[NSFileManager defaultManager] replaceItemAtURL:storeURL withItemAtURL:migratedURL backupItemName:nil options:0 resultingItemURL:nil error:error];
+}
+
+#pragma mark Migration
+
+-(BOOL) migrateLightweightStoreAtURL:(NSURL *) storeURL migrationURL:(NSURL *) migrationURL progress:(StoreMigrationProgress) progress error:(NSError **) error
+{
+    if (![[NSFileManager defaultManager] copyItemAtURL:storeURL toURL:migrationURL error:error])
+        return NO;
+
+    if (progress)
+        progress(0.2f);
+
+    NSPersistentStoreCoordinator *coordinator = [[NSPersistentStoreCoordinator alloc] initWithManagedObjectModel:self.currentModel];
+    NSDictionary *options = @{NSMigratePersistentStoresAutomaticallyOption : @YES,
+                              NSInferMappingModelAutomaticallyOption : @YES,
+                              NSSQLitePragmasOption : @{@"journal_mode" : @"DELETE"}};
+
+    NSPersistentStore *store = [coordinator addPersistentStoreWithType:NSSQLiteStoreType configuration:nil URL:migrationURL options:options error:error];
+    if (!store || ![coordinator removePersistentStore:store error:error])
+        return NO;
+
+    if (progress)
+        progress(0.9f);
+
+    return [self replaceStoreAtURL:storeURL withStoreAtURL:migrationURL error:error];
+}
+
+-(BOOL) migrateStoreAtURL:(NSURL *) storeURL fromModel:(NSManagedObjectModel *) source toModel:(NSManagedObjectModel *) destination migrationURL:(NSURL *) migrationURL error:(NSError **) error
+{
+    NSMappingModel *mapping = [NSMappingModel mappingModelFromBundles:nil forSourceModel:source destinationModel:destination];
+    if (!mapping)
+        mapping = [NSMappingModel inferredMappingModelForSourceModel:source destinationModel:destination error:nil];
+
+    if (!mapping)
+        return [self failWithCode:StoreMigratorErrorNoMapping error:error];
+
+    NSMigrationManager *manager = [[NSMigrationManager alloc] initWithSourceModel:source destinationModel:destination];
+    [manager addObserver:self forKeyPath:@"migrationProgress" options:0 context:StoreMigratorProgressContext];
+
+    NSDictionary *options = @{NSSQLitePragmasOption : @{@"journal_mode" : @"DELETE"}};
+    BOOL success = [manager migrateStoreFromURL:storeURL type:NSSQLiteStoreType options:nil withMappingModel:mapping
+                               toDestinationURL:migrationURL destinationType:NSSQLiteStoreType destinationOptions:options error:error];
+
+    [manager removeObserver:self forKeyPath:@"migrationProgress" context:StoreMigratorProgressContext];
+    return success && [self replaceStoreAtURL:storeURL withStoreAtURL:migrationURL error:error];
+}
+
+-(void) observeValueForKeyPath:(NSString *) keyPath ofObject:(id) object change:(NSDictionary *) change context:(void *) context
+{
+    if (context != StoreMigratorProgressContext) {
+        [super observeValueForKeyPath:keyPath ofObject:object change:change context:context];
+        return;
+    }
+
+    if (self.stepProgress)
+        self.stepProgress(self.stepOffset + self.stepScale * [(NSMigrationManager *) object migrationProgress]);
+}
+
+-(BOOL) migrateStoreAtURL:(NSURL *) storeURL progress:(StoreMigrationProgress) progress error:(NSError **) error
+{
+    NSManagedObjectModel *source = [self modelForStoreAtURL:storeURL];
+    if (!source)
+        return [self failWithCode:StoreMigratorErrorUnknownModel error:error];
+
+    if (source == self.currentModel)
+        return YES;
+
+    // Left over from an interrupted migration, the store itself is untouched
+    NSURL *migrationURL = [self migrationURLForStore:storeURL];
+    [self removeStoreAtURL:migrationURL];
+
+    if (![self checkpointStoreAtURL:storeURL model:source error:error])
+        return NO;
+
+    if (progress)
+        progress(0.1f);
+
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    BOOL success;
+
+    if ([NSMappingModel inferredMappingModelForSourceModel:source destinationModel:self.currentModel error:nil]) {
+        success = [self migrateLightweightStoreAtURL:storeURL migrationURL:migrationURL progress:progress error:error];
+    } else {
+        NSUInteger first = [self indexOfModel:source], last = [self indexOfModel:self.currentModel];
+        if (first == NSNotFound || last == NSNotFound || first >= last)
+            return [self failWithCode:StoreMigratorErrorNoMapping error:error];
+
+        success = YES;
+        self.stepProgress = progress;
+        self.stepScale = 0.9f / (last - first);
+
+        for (NSUInteger i = first; i < last && success; i++) {
+            self.stepOffset = 0.1f + self.stepScale * (i - first);
+            success = [self migrateStoreAtURL:storeURL fromModel:self.models[i] toModel:self.models[i + 1] migrationURL:migrationURL error:error];
+        }
+        self.stepProgress = nil;
+    }
+
+    if (!success) {
+        [self removeStoreAtURL:migrationURL];
+        return NO;
+    }
+
+    DLog(@"StoreMigrator: migrated %@ in %.2fs", [storeURL lastPathComponent], CFAbsoluteTimeGetCurrent() - start);
+    if (progress)
+        progress(1.0f);
+
+    return YES;
+}
+
+-(NSArray *) storesRequiringMigrationInDirectory:(NSURL *) directory
+{
+    NSArray *urls = [[NSFileManager defaultManager] contentsOfDirectoryAtURL:directory includingPropertiesForKeys:nil options:NSDirectoryEnumerationSkipsHiddenFiles error:nil];
+    NSMutableArray *stores = [NSMutableArray array];
+
+    for (NSURL *url in urls) {
+        if (![[url pathExtension] isEqualToString:@"sqlite"])
+            continue;
+
+        NSManagedObjectModel *model = [self modelForStoreAtURL:url];
+        if (!model) {
+            DLog(@"StoreMigrator: %@ matches none of the %lu model versions, skipped", [url lastPathComponent], (unsigned long) [self.models count]);
+            continue;
+        }
+
+        if (model != self.currentModel)
+            [stores addObject:url];
+    }
+    return stores;
+}
+
+-(NSArray *) storesRequiringMigration
+{
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSArray *directories = @[[[fileManager URLsForDirectory:NSDocumentDirectory inDomains:NSUserDomainMask] firstObject],
+                             [[fileManager URLsForDirectory:NSApplicationSupportDirectory inDomains:NSUserDomainMask] firstObject]];
+
+    NSMutableArray *stores = [NSMutableArray array];
+    for (NSURL *directory in directories) {
+        [stores addObjectsFromArray:[self storesRequiringMigrationInDirectory:directory]];
+    }
+    return stores;
+}
+
+-(unsigned long long) sizeOfStores:(NSArray *) stores
+{
+    unsigned long long size = 0;
+    for (NSURL *store in stores) {
+        for (NSURL *url in [self fileURLsOfStore:store]) {
+            size += [[[NSFileManager defaultManager] attributesOfItemAtPath:[url path] error:nil] fileSize];
+        }
+    }
+    return size;
+}
+
+-(BOOL) canMigrateStoresSynchronously:(NSArray *) stores
+{
+    return [self sizeOfStores:stores] <= self.synchronousMigrationLimit;
+}
+
+-(BOOL) migrateStores:(NSArray *) stores progress:(StoreMigrationProgress) progress
+{
+    BOOL success = YES;
+    NSUInteger count = [stores count];
+
+    for (NSUInteger i = 0; i < count; i++) {
+        NSURL *store = stores[i];
+        StoreMigrationProgress storeProgress = nil;
+        if (progress) {
+            storeProgress = ^(float value) {
+                progress((i + value) / count);
+            };
+        }
+
+        NSError *error = nil;
+        if (![self migrateStoreAtURL:store progress:storeProgress error:&error]) {
+            DLog(@"StoreMigrator: migration of %@ failed: %@", [store lastPathComponent], error);
+            success = NO;
+        }
+    }
+
+    if (progress)
+        progress(1.0f);
+
+    return success;
+}
+
+-(void) migrateStoresInBackground:(NSArray *) stores progress:(StoreMigrationProgress) progress completion:(StoreMigrationCompletion) completion
+{
+    StoreMigrationProgress mainProgress = nil;
+    if (progress) {
+        mainProgress = ^(float value) {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                progress(value);
+            });
+        };
+    }
+
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^{
+        BOOL success = [self migrateStores:stores progress:mainProgress];
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (completion)
+                completion(success);
+        });
+    });
+}
+
++(NSURL *) modelURL
+{
+    // The app compiles only the recent versions, the SDK model has all of them
+    NSURL *url = [[NSBundle mainBundle] URLForResource:MODEL_NAME withExtension:@"momd" subdirectory:SDK_MODEL_DIRECTORY];
+    if (url)
+        return url;
+
+    DLog(@"StoreMigrator: %@ of the SDK is missing, stores of older versions are not migrated", MODEL_NAME);
+    return [[NSBundle mainBundle] URLForResource:MODEL_NAME withExtension:@"momd"];
+}
+
++(StoreMigrator *) instance
+{
+    static StoreMigrator *migrator = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        migrator = [[StoreMigrator alloc] initWithModelURL:[self modelURL]];
+    });
+    return migrator;
+}
+
+@end
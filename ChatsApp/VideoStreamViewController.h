@@ -0,0 +1,63 @@
+//
+//  VideoStreamViewController.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 27/05/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <SocialCommunication/EAGLViewController.h>
+
+typedef enum {
+    VideoVisibilityVisible,
+    VideoVisibilityThumbnail,
+    VideoVisibilityHidden
+} VideoVisibilityT;
+
+@class GroupVideoCompositor;
+
+/** EAGLViewController which spends rendering work only on what is on screen.
+
+ The EAGLViewController scene in Main.storyboard uses this class. C2CallAppDelegate
+ instantiateViewControllerWithIdentifier: finds it before the scene of the SDK storyboard, so the
+ video views created by the SDK call controllers are stream views.
+
+ Frames for a hidden stream are dropped before the texture upload, thumbnails are
+ rendered with thumbnailFrameRate. The visibility is derived from the view state
+ and size, unless it has been set explicitly.
+
+ With coalesceFrames, at most one frame per display refresh is uploaded. The first frame within a
+ refresh interval is uploaded directly from the decoder buffer, without a copy or added latency.
+ A second frame within the same interval, or one arriving while an upload is running, is copied
+ into a buffer owned by the view and uploaded by a display link at the next vsync, a frame replaced
+ before then is never uploaded. The display link is paused while no frame is waiting.
+
+ With a compositor, the stream view only defines the tile area, frames are drawn by the compositor.
+ A stream view shown in a group video call joins the compositor of the call when it appears.
+ Joining releases the GL context and drawable of the stream view for good, afterwards frames
+ are only drawn through a compositor.
+ */
+@interface VideoStreamViewController : EAGLViewController
+
+/** Current visibility of the stream. */
+@property(nonatomic) VideoVisibilityT visibility;
+
+/** Set YES to keep the visibility set by the application instead of deriving it from the view. */
+@property(nonatomic) BOOL manualVisibility;
+
+/** Frame rate used while the stream is shown as thumbnail. Default is 5. */
+@property(nonatomic) int thumbnailFrameRate;
+
+/** Views smaller than this fraction of the screen width are treated as thumbnail. Default is 0.35. */
+@property(nonatomic) CGFloat thumbnailWidthRatio;
+
+/** Upload at most one frame per display refresh while the view is on screen. Default is YES, set before the view appears. */
+@property(nonatomic) BOOL coalesceFrames;
+
+/** Compositor drawing this stream, nil to render the stream in its own view. */
+@property(nonatomic, weak) GroupVideoCompositor *compositor;
+
+/** Frames replaced by a newer frame before they were uploaded. */
+@property(nonatomic, readonly) NSUInteger coalescedFrames;
+
+@end
@@ -0,0 +1,388 @@
+//
+//  VideoStreamViewController.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 27/05/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <QuartzCore/QuartzCore.h>
+#import <libkern/OSAtomic.h>
+#import <SocialCommunication/EAGLView.h>
+#import <SocialCommunication/SCGroupVideoCallController.h>
+
+#import "VideoStreamViewController.h"
+#import "VideoVisibilityPolicy.h"
+#import "GroupVideoCompositor.h"
+
+// Refresh interval of the main screen, iOS 7 devices only run at 60 Hz
+#define DISPLAY_REFRESH_INTERVAL    (1. / 60.)
+
+@interface VideoStreamViewController () {
+    CFAbsoluteTime      lastRenderedFrame;
+    BOOL                contextReleased;
+
+    // Latest decoded frame not yet handed to the renderer, guarded by @synchronized(self)
+    NSMutableData       *pendingFrame;
+    BOOL                hasPendingFrame;
+    int                 pendingWidth, pendingHeight;
+    VideoVisibilityT    pendingVisibility;
+    BOOL                coalescing, displayLinkPaused;
+    CFTimeInterval      lastUploadTime;
+
+    // Frame being uploaded, swapped with pendingFrame while no upload is running
+    NSMutableData       *uploadFrame;
+    volatile int32_t    uploading;
+}
+
+@property(nonatomic, strong) CADisplayLink *displayLink;
+@property(nonatomic, strong) dispatch_queue_t uploadQueue;
+@property(nonatomic, readwrite) NSUInteger coalescedFrames;
+
+@end
+
+@implementation VideoStreamViewController
+
+-(void) setupVisibility
+{
+    _visibility = VideoVisibilityHidden;
+    self.thumbnailFrameRate = 5;
+    self.thumbnailWidthRatio = 0.35;
+    self.coalesceFrames = YES;
+    pendingFrame = [NSMutableData data];
+    uploadFrame = [NSMutableData data];
+    self.uploadQueue = dispatch_queue_create("VideoStreamViewController.upload", DISPATCH_QUEUE_SERIAL);
+}
+
+- (id)initWithNibName:(NSString *)nibNameOrNil bundle:(NSBundle *)nibBundleOrNil
+{
+    self = [super initWithNibName:nibNameOrNil bundle:nibBundleOrNil];
+    if (self) {
+        [self setupVisibility];
+    }
+    return self;
+}
+
+- (id)initWithCoder:(NSCoder *)aDecoder
+{
+    self = [super initWithCoder:aDecoder];
+    if (self) {
+        [self setupVisibility];
+    }
+    return self;
+}
+
+-(void) viewDidAppear:(BOOL)animated
+{
+    [super viewDidAppear:animated];
+
+    [[VideoVisibilityPolicy instance] addStreamView:self];
+    [self updateVisibility];
+    [self joinGroupVideoCall];
+    [self startDisplayLink];
+}
+
+-(void) viewWillDisappear:(BOOL)animated
+{
+    [super viewWillDisappear:animated];
+
+    if (!self.manualVisibility)
+        self.visibility = VideoVisibilityHidden;
+}
+
+-(void) viewDidDisappear:(BOOL)animated
+{
+    [super viewDidDisappear:animated];
+
+    [self stopDisplayLink];
+    [[VideoVisibilityPolicy instance] removeStreamView:self];
+}
+
+-(void) viewDidLayoutSubviews
+{
+    [super viewDidLayoutSubviews];
+
+    [self updateVisibility];
+    [self.compositor setNeedsCompose];
+}
+
+-(void) setCompositor:(GroupVideoCompositor *) compositor
+{
+    if (_compositor == compositor)
+        return;
+
+    [_compositor removeTile:self];
+    _compositor = compositor;
+
+    if (compositor) {
+        [self stopDisplayLink];
+        [self releaseRenderingContext];
+        [compositor addTile:self];
+    } else if (self.view.window) {
+        [self startDisplayLink];
+    }
+}
+
+-(void) joinGroupVideoCall
+{
+    if (self.compositor)
+        return;
+
+    // The controller presenting this view, whether or not it has been added as child view controller
+    UIResponder *responder = self.view.superview;
+    while (responder && ![responder isKindOfClass:[UIViewController class]]) {
+        responder = [responder nextResponder];
+    }
+
+    if ([responder isKindOfClass:[SCGroupVideoCallController class]])
+        self.compositor = [GroupVideoCompositor compositorForGroupVideoCall:(SCGroupVideoCallController *) responder];
+}
+
+-(void) releaseRenderingContext
+{
+    if (contextReleased)
+        return;
+
+    contextReleased = YES;
+
+    // The view only defines the tile area now, the compositor below shows through
+    UIView *view = self.view;
+    view.opaque = NO;
+    view.layer.opaque = NO;
+    view.backgroundColor = [UIColor clearColor];
+
+    EAGLView *glView = [view isKindOfClass:[EAGLView class]] ? (EAGLView *) view : nil;
+    dispatch_block_t release = ^{
+        EAGLContext *own = self.context;
+        EAGLContext *previous = [EAGLContext currentContext];
+        [glView deleteFramebuffer];
+        glView.context = nil;
+        self.context = nil;
+
+        // deleteFramebuffer makes the view context current
+        [EAGLContext setCurrentContext:previous == own ? nil : previous];
+    };
+
+    // The SDK renders on the OpenGL ES queue, don't pull the context away from a running render
+    if (self.openglesQueue) {
+        dispatch_async(self.openglesQueue, release);
+    } else {
+        release();
+    }
+}
+
+-(void) dispose
+{
+    self.compositor = nil;
+    [self stopDisplayLink];
+    [[VideoVisibilityPolicy instance] removeStreamView:self];
+    [super dispose];
+}
+
+#pragma mark Visibility
+
+-(void) updateVisibility
+{
+    if (self.manualVisibility)
+        return;
+
+    UIView *view = self.view;
+    if (!view.window || view.hidden || view.alpha == 0.) {
+        self.visibility = VideoVisibilityHidden;
+        return;
+    }
+
+    CGFloat screenWidth = MIN(view.window.bounds.size.width, view.window.bounds.size.height);
+    CGFloat viewWidth = MIN(view.bounds.size.width, view.bounds.size.height);
+    if (screenWidth > 0. && viewWidth < screenWidth * self.thumbnailWidthRatio) {
+        self.visibility = VideoVisibilityThumbnail;
+    } else {
+        self.visibility = VideoVisibilityVisible;
+    }
+}
+
+-(void) setVisibility:(VideoVisibilityT) visibility
+{
+    if (_visibility == visibility)
+        return;
+
+    _visibility = visibility;
+
+    if (![VideoVisibilityPolicy instance].inBackground)
+        self.background = visibility == VideoVisibilityHidden;
+
+    // Show the next frame immediately, don't wait for the thumbnail interval
+    lastRenderedFrame = 0;
+
+    [[VideoVisibilityPolicy instance] streamView:self didChangeVisibility:visibility];
+    [self.compositor setNeedsCompose];
+}
+
+#pragma mark Rendering
+
+-(void) startDisplayLink
+{
+    if (self.displayLink || !self.coalesceFrames || self.compositor || contextReleased)
+        return;
+
+    // The display link retains its target, stopDisplayLink breaks the cycle
+    self.displayLink = [CADisplayLink displayLinkWithTarget:self selector:@selector(presentPendingFrame:)];
+    self.displayLink.paused = YES;
+    [self.displayLink addToRunLoop:[NSRunLoop mainRunLoop] forMode:NSRunLoopCommonModes];
+
+    // The decoder thread only looks at this flag, never at the display link
+    @synchronized(self) {
+        coalescing = YES;
+        displayLinkPaused = YES;
+    }
+}
+
+-(void) stopDisplayLink
+{
+    // Frames arriving from now on are uploaded directly, drop the one still waiting
+    @synchronized(self) {
+        if (hasPendingFrame)
+            [[VideoVisibilityPolicy instance] recordFrameForVisibility:pendingVisibility rendered:NO];
+        hasPendingFrame = NO;
+        coalescing = NO;
+    }
+
+    [self.displayLink invalidate];
+    self.displayLink = nil;
+}
+
+-(void) resumeDisplayLink
+{
+    // Main thread, nil if the display link has been stopped in the meantime
+    self.displayLink.paused = NO;
+}
+
+-(void) presentPendingFrame:(CADisplayLink *) displayLink
+{
+    // Previous upload still running, keep the frame for the next vsync
+    if (!OSAtomicCompareAndSwap32Barrier(0, 1, &uploading))
+        return;
+
+    NSData *data = nil;
+    int width = 0, height = 0;
+    VideoVisibilityT visibility = VideoVisibilityHidden;
+    @synchronized(self) {
+        if (!hasPendingFrame) {
+            // Nothing to present, the next frame from the decoder resumes the display link
+            displayLinkPaused = YES;
+            displayLink.paused = YES;
+            uploading = 0;
+            return;
+        }
+
+        // No upload is running, so the upload buffer is free to take the next frame
+        NSMutableData *frame = pendingFrame;
+        pendingFrame = uploadFrame;
+        uploadFrame = frame;
+        hasPendingFrame = NO;
+        lastUploadTime = CACurrentMediaTime();
+
+        data = frame;
+        width = pendingWidth;
+        height = pendingHeight;
+        visibility = pendingVisibility;
+    }
+
+    dispatch_async(self.uploadQueue, ^{
+        [self uploadTextureData:data withWidth:width andHeight:height];
+        [[VideoVisibilityPolicy instance] recordFrameForVisibility:visibility rendered:YES];
+        OSAtomicCompareAndSwap32Barrier(1, 0, &uploading);
+    });
+}
+
+-(void) uploadTextureData:(NSData *)data withWidth:(int) width andHeight:(int) height
+{
+    [super setTextureData:data withWidth:width andHeight:height];
+}
+
+-(void) setTextureData:(NSData *)data withWidth:(int) width andHeight:(int) height
+{
+    VideoVisibilityT visibility = self.visibility;
+    VideoVisibilityPolicy *policy = [VideoVisibilityPolicy instance];
+
+    if (visibility == VideoVisibilityHidden || policy.inBackground) {
+        [policy recordFrameForVisibility:VideoVisibilityHidden rendered:NO];
+        return;
+    }
+
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    if (visibility == VideoVisibilityThumbnail && self.thumbnailFrameRate > 0) {
+        if (now - lastRenderedFrame < 1. / self.thumbnailFrameRate) {
+            [policy recordFrameForVisibility:visibility rendered:NO];
+            return;
+        }
+    }
+
+    lastRenderedFrame = now;
+
+    GroupVideoCompositor *compositor = self.compositor;
+    if (compositor) {
+        [compositor setTextureData:data withWidth:width andHeight:height forTile:self];
+        [policy recordFrameForVisibility:visibility rendered:YES];
+        return;
+    }
+
+    // Without a GL context only a compositor can draw the frame
+    if (contextReleased) {
+        [policy recordFrameForVisibility:visibility rendered:NO];
+        return;
+    }
+
+    // The first frame per vsync is uploaded directly from the decoder buffer. Only a second frame
+    // arriving within the same vsync, or while an upload is running, is copied and left to the display
+    // link, a frame replaced before the next vsync would never have been presented.
+    BOOL coalesced = NO, direct = NO, replaced = NO, resume = NO;
+    VideoVisibilityT replacedVisibility = visibility;
+    CFTimeInterval time = CACurrentMediaTime();
+    @synchronized(self) {
+        if (coalescing) {
+            replaced = hasPendingFrame;
+            replacedVisibility = pendingVisibility;
+
+            if (time - lastUploadTime >= DISPLAY_REFRESH_INTERVAL && OSAtomicCompareAndSwap32Barrier(0, 1, &uploading)) {
+                // A waiting frame is older than this one
+                direct = YES;
+                hasPendingFrame = NO;
+                lastUploadTime = time;
+            } else {
+                coalesced = YES;
+
+                // The decoder reuses its buffer for the next frame, keep a copy
+                [pendingFrame setData:data];
+                hasPendingFrame = YES;
+                pendingWidth = width;
+                pendingHeight = height;
+                pendingVisibility = visibility;
+                resume = displayLinkPaused;
+                displayLinkPaused = NO;
+            }
+        }
+    }
+
+    if (replaced) {
+        self.coalescedFrames++;
+        [policy recordFrameForVisibility:replacedVisibility rendered:NO];
+    }
+
+    if (coalesced) {
+        if (resume) {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [self resumeDisplayLink];
+            });
+        }
+        return;
+    }
+
+    [self uploadTextureData:data withWidth:width andHeight:height];
+    [policy recordFrameForVisibility:visibility rendered:YES];
+
+    if (direct)
+        OSAtomicCompareAndSwap32Barrier(1, 0, &uploading);
+}
+
+@end
@@ -0,0 +1,59 @@
+//
+//  VideoVisibilityPolicy.h
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 27/05/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "VideoStreamViewController.h"
+
+/** Tracks the visibility of all received video streams.
+
+ While no stream is visible, e.g. the group video screen has been toggled off or
+ the app is in background, the video handler is told to hide the video frame,
+ so received streams are not processed for display.
+ When a stream becomes visible again the video frame is shown. When the last stream view
+ is removed the video frame keeps its state, restoreVideoFrame shows it at the end of the call.
+
+ The SDK has no control to skip decoding of a stream, hidden streams are still decoded.
+ The policy saves the texture upload and rendering work of hidden and thumbnail streams only.
+
+ For every visibility state the number of rendered and skipped frames is counted, together
+ with the time the registered streams spent in that state, to compare the frame rates actually
+ processed per state. Time and frames in background are counted as hidden.
+ */
+@interface VideoVisibilityPolicy : NSObject
+
+/** YES while the application is in background. */
+@property(nonatomic, readonly) BOOL inBackground;
+
+/** Register a stream view. Views are held weakly. */
+-(void) addStreamView:(VideoStreamViewController *) streamView;
+
+/** Remove a stream view. */
+-(void) removeStreamView:(VideoStreamViewController *) streamView;
+
+/** Show the video frame if it has been hidden, called when the call ends. */
+-(void) restoreVideoFrame;
+
+/** Will be called by a stream view on visibility change. */
+-(void) streamView:(VideoStreamViewController *) streamView didChangeVisibility:(VideoVisibilityT) visibility;
+
+/** Will be called by a stream view for every received frame. */
+-(void) recordFrameForVisibility:(VideoVisibilityT) visibility rendered:(BOOL) rendered;
+
+/** Rendered frames per second of a stream while in a visibility state, since the last reset. */
+-(double) renderedFramesPerSecondForVisibility:(VideoVisibilityT) visibility;
+
+/** Skipped frames per second of a stream while in a visibility state, since the last reset. */
+-(double) skippedFramesPerSecondForVisibility:(VideoVisibilityT) visibility;
+
+/** Reset the frame statistics. */
+-(void) resetStatistics;
+
+/** @return shared instance */
++(VideoVisibilityPolicy *) instance;
+
+@end
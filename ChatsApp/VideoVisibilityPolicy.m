@@ -0,0 +1,274 @@
+//
+//  VideoVisibilityPolicy.m
+//  ChatsApp
+//
+//  Created by Ryan Opoku on 27/05/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <libkern/OSAtomic.h>
+#import <SocialCommunication/RTPVideoHandler.h>
+#import <SocialCommunication/debug.h>
+
+#import "VideoVisibilityPolicy.h"
+
+#define NUM_VISIBILITY_STATES   3
+
+@interface VideoVisibilityPolicy () {
+    volatile int64_t    renderedFrames[NUM_VISIBILITY_STATES];
+    volatile int64_t    skippedFrames[NUM_VISIBILITY_STATES];
+    CFTimeInterval      stateDuration[NUM_VISIBILITY_STATES];      // Stream seconds spent per state, closed intervals
+    BOOL                videoFrameHidden;
+}
+
+// Stream view -> @[state, start of the current interval]
+@property(nonatomic, strong) NSMapTable *streamViews;
+@property(nonatomic, readwrite) BOOL inBackground;
+
+@end
+
+@implementation VideoVisibilityPolicy
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.streamViews = [NSMapTable weakToStrongObjectsMapTable];
+
+        NSNotificationCenter *nc = [NSNotificationCenter defaultCenter];
+        [nc addObserver:self selector:@selector(didEnterBackground:) name:UIApplicationDidEnterBackgroundNotification object:nil];
+        [nc addObserver:self selector:@selector(willEnterForeground:) name:UIApplicationWillEnterForegroundNotification object:nil];
+    }
+    return self;
+}
+
+-(void) dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+#pragma mark Stream Views
+
+-(void) addStreamView:(VideoStreamViewController *) streamView
+{
+    @synchronized(self) {
+        [self openIntervalForStreamView:streamView at:CFAbsoluteTimeGetCurrent()];
+    }
+    [self updateVideoFrame];
+}
+
+-(void) removeStreamView:(VideoStreamViewController *) streamView
+{
+    @synchronized(self) {
+        [self closeIntervalForStreamView:streamView at:CFAbsoluteTimeGetCurrent()];
+        [self.streamViews removeObjectForKey:streamView];
+    }
+    [self updateVideoFrame];
+}
+
+-(void) streamView:(VideoStreamViewController *) streamView didChangeVisibility:(VideoVisibilityT) visibility
+{
+    DLog(@"VideoVisibilityPolicy: ssrc %lu visibility %d", streamView.ssrc, visibility);
+
+    @synchronized(self) {
+        if ([self.streamViews objectForKey:streamView]) {
+            CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+            [self closeIntervalForStreamView:streamView at:now];
+            [self openIntervalForStreamView:streamView at:now];
+        }
+    }
+    [self updateVideoFrame];
+}
+
+-(BOOL) hasVisibleStream
+{
+    // Under @synchronized(self)
+    if (self.inBackground)
+        return NO;
+
+    for (VideoStreamViewController *streamView in [self.streamViews keyEnumerator]) {
+        if (streamView.visibility != VideoVisibilityHidden)
+            return YES;
+    }
+    return NO;
+}
+
+-(void) setVideoFrameHidden:(BOOL) hide
+{
+    // Under @synchronized(self)
+    if (hide == videoFrameHidden)
+        return;
+
+    videoFrameHidden = hide;
+
+    RTPVideoHandler *videoHandler = [RTPVideoHandler videoHandler];
+    if (hide) {
+        [videoHandler hideVideoFrame];
+    } else {
+        [videoHandler showVideoFrame];
+    }
+}
+
+-(void) updateVideoFrame
+{
+    @synchronized(self) {
+        // The last view has been removed, e.g. after it has been hidden on disappear.
+        // Showing the frame now would flap, it is restored when a view registers or the call ends.
+        if ([self.streamViews count] == 0)
+            return;
+
+        [self setVideoFrameHidden:![self hasVisibleStream]];
+    }
+}
+
+-(void) restoreVideoFrame
+{
+    @synchronized(self) {
+        [self setVideoFrameHidden:NO];
+    }
+}
+
+#pragma mark Application State
+
+-(NSArray *) allStreamViews
+{
+    @synchronized(self) {
+        return [[self.streamViews keyEnumerator] allObjects];
+    }
+}
+
+-(void) didEnterBackground:(NSNotification *) notification
+{
+    [self restartIntervals:^{
+        self.inBackground = YES;
+    }];
+    for (VideoStreamViewController *streamView in [self allStreamViews]) {
+        streamView.background = YES;
+    }
+    [self updateVideoFrame];
+}
+
+-(void) willEnterForeground:(NSNotification *) notification
+{
+    [self restartIntervals:^{
+        self.inBackground = NO;
+    }];
+    for (VideoStreamViewController *streamView in [self allStreamViews]) {
+        streamView.background = streamView.visibility == VideoVisibilityHidden;
+    }
+    [self updateVideoFrame];
+}
+
+#pragma mark Statistics
+
+-(void) recordFrameForVisibility:(VideoVisibilityT) visibility rendered:(BOOL) rendered
+{
+    if (visibility >= NUM_VISIBILITY_STATES)
+        return;
+
+    if (rendered) {
+        OSAtomicIncrement64(&renderedFrames[visibility]);
+    } else {
+        OSAtomicIncrement64(&skippedFrames[visibility]);
+    }
+}
+
+#pragma mark State Durations
+
+-(VideoVisibilityT) effectiveVisibilityOfStreamView:(VideoStreamViewController *) streamView
+{
+    // In background every frame is counted as hidden
+    return self.inBackground ? VideoVisibilityHidden : streamView.visibility;
+}
+
+-(void) openIntervalForStreamView:(VideoStreamViewController *) streamView at:(CFAbsoluteTime) now
+{
+    // Under @synchronized(self)
+    [self.streamViews setObject:@[@([self effectiveVisibilityOfStreamView:streamView]), @(now)] forKey:streamView];
+}
+
+-(void) closeIntervalForStreamView:(VideoStreamViewController *) streamView at:(CFAbsoluteTime) now
+{
+    // Under @synchronized(self)
+    NSArray *interval = [self.streamViews objectForKey:streamView];
+    if (!interval)
+        return;
+
+    int state = [interval[0] intValue];
+    if (state < NUM_VISIBILITY_STATES)
+        stateDuration[state] += now - [interval[1] doubleValue];
+}
+
+-(void) restartIntervals:(dispatch_block_t) change
+{
+    @synchronized(self) {
+        CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+        NSArray *streamViews = [[self.streamViews keyEnumerator] allObjects];
+
+        for (VideoStreamViewController *streamView in streamViews) {
+            [self closeIntervalForStreamView:streamView at:now];
+        }
+        if (change)
+            change();
+        for (VideoStreamViewController *streamView in streamViews) {
+            [self openIntervalForStreamView:streamView at:now];
+        }
+    }
+}
+
+-(CFTimeInterval) durationOfVisibility:(VideoVisibilityT) visibility
+{
+    @synchronized(self) {
+        CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+        CFTimeInterval duration = stateDuration[visibility];
+
+        // Add the running intervals
+        for (VideoStreamViewController *streamView in [self.streamViews keyEnumerator]) {
+            NSArray *interval = [self.streamViews objectForKey:streamView];
+            if ([interval[0] intValue] == (int) visibility)
+                duration += now - [interval[1] doubleValue];
+        }
+        return duration;
+    }
+}
+
+-(double) renderedFramesPerSecondForVisibility:(VideoVisibilityT) visibility
+{
+    if (visibility >= NUM_VISIBILITY_STATES)
+        return 0.;
+
+    CFTimeInterval duration = [self durationOfVisibility:visibility];
+    return duration > 0. ? renderedFrames[visibility] / duration : 0.;
+}
+
+-(double) skippedFramesPerSecondForVisibility:(VideoVisibilityT) visibility
+{
+    if (visibility >= NUM_VISIBILITY_STATES)
+        return 0.;
+
+    CFTimeInterval duration = [self durationOfVisibility:visibility];
+    return duration > 0. ? skippedFrames[visibility] / duration : 0.;
+}
+
+-(void) resetStatistics
+{
+    [self restartIntervals:^{
+        for (int i = 0; i < NUM_VISIBILITY_STATES; i++) {
+            renderedFrames[i] = 0;
+            skippedFrames[i] = 0;
+            stateDuration[i] = 0.;
+        }
+    }];
+}
+
++(VideoVisibilityPolicy *) instance
+{
+    static VideoVisibilityPolicy *policy = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        policy = [[VideoVisibilityPolicy alloc] init];
+    });
+    return policy;
+}
+
+@end
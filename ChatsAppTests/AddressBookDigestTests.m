@@ -0,0 +1,85 @@
+//
+//  AddressBookDigestTests.m
+//  ChatsAppTests
+//
+//  Created by Ryan Opoku on 11/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "AddressBookDigest.h"
+
+@interface AddressBookDigestTests : XCTestCase
+
+@property(nonatomic, strong) NSString *path;
+
+@end
+
+@implementation AddressBookDigestTests
+
+- (void)setUp
+{
+    [super setUp];
+    self.path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:self.path error:nil];
+    [super tearDown];
+}
+
+- (void)testNormalizedIdentifier
+{
+    XCTAssertEqualObjects([AddressBookDigest normalizedIdentifier:@" Alice@Example.COM "], @"alice@example.com");
+    XCTAssertEqualObjects([AddressBookDigest normalizedIdentifier:@"+49 (30) 123-456"], @"+4930123456");
+    XCTAssertEqualObjects([AddressBookDigest normalizedIdentifier:@"0049 30 123456"], @"+4930123456");
+    XCTAssertEqualObjects([AddressBookDigest normalizedIdentifier:@"030 123456"], @"030123456");
+    XCTAssertNil([AddressBookDigest normalizedIdentifier:@"112"]);
+    XCTAssertNil([AddressBookDigest normalizedIdentifier:@"@example.com"]);
+    XCTAssertNil([AddressBookDigest normalizedIdentifier:@""]);
+}
+
+- (void)testFirstCompareAddsAll
+{
+    AddressBookDigest *digest = [[AddressBookDigest alloc] initWithPath:self.path];
+    XCTAssertFalse(digest.hasDigest);
+
+    NSUInteger removed = 1;
+    NSArray *added = [digest addedIdentifiers:@[@"a@example.com", @"+4930123456", @"a@example.com"] removedCount:&removed];
+    XCTAssertEqualObjects(added, (@[@"a@example.com", @"+4930123456"]));
+    XCTAssertEqual(removed, (NSUInteger) 0);
+}
+
+- (void)testDelta
+{
+    AddressBookDigest *digest = [[AddressBookDigest alloc] initWithPath:self.path];
+    XCTAssertTrue([digest commitIdentifiers:@[@"a@example.com", @"b@example.com", @"+4930123456"]]);
+    XCTAssertEqual(digest.count, (NSUInteger) 3);
+
+    NSUInteger removed = 0;
+    NSArray *added = [digest addedIdentifiers:@[@"a@example.com", @"+4930123456", @"c@example.com"] removedCount:&removed];
+    XCTAssertEqualObjects(added, (@[@"c@example.com"]));
+    XCTAssertEqual(removed, (NSUInteger) 1);
+
+    added = [digest addedIdentifiers:@[@"b@example.com", @"a@example.com", @"+4930123456"] removedCount:&removed];
+    XCTAssertEqual([added count], (NSUInteger) 0);
+    XCTAssertEqual(removed, (NSUInteger) 0);
+}
+
+- (void)testDigestIsPersistent
+{
+    AddressBookDigest *digest = [[AddressBookDigest alloc] initWithPath:self.path];
+    [digest commitIdentifiers:@[@"a@example.com", @"+4930123456"]];
+
+    AddressBookDigest *reloaded = [[AddressBookDigest alloc] initWithPath:self.path];
+    XCTAssertTrue(reloaded.hasDigest);
+    XCTAssertEqual(reloaded.count, (NSUInteger) 2);
+    XCTAssertTrue([reloaded containsIdentifier:@"+4930123456"]);
+    XCTAssertFalse([reloaded containsIdentifier:@"b@example.com"]);
+
+    [reloaded reset];
+    XCTAssertFalse([[AddressBookDigest alloc] initWithPath:self.path].hasDigest);
+}
+
+@end
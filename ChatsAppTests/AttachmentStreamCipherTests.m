@@ -0,0 +1,172 @@
+//
+//  AttachmentStreamCipherTests.m
+//  ChatsAppTests
+//
+//  Created by Ryan Opoku on 09/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "AttachmentStreamCipher.h"
+
+#define TEST_CHUNK_SIZE     1024
+#define ENCRYPTED_CHUNK     (TEST_CHUNK_SIZE + ATTACHMENT_STREAM_TAG_LENGTH)
+#define HEADER_LENGTH       16
+
+@interface AttachmentStreamCipherTests : XCTestCase
+
+@property(nonatomic, strong) AttachmentStreamCipher *cipher;
+@property(nonatomic, strong) NSString *plainPath;
+@property(nonatomic, strong) NSString *encryptedPath;
+@property(nonatomic, strong) NSString *decryptedPath;
+
+@end
+
+@implementation AttachmentStreamCipherTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.cipher = [[AttachmentStreamCipher alloc] initWithKey:[AttachmentStreamCipher generateKey] chunkSize:TEST_CHUNK_SIZE];
+    self.plainPath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"attachment.plain"];
+    self.encryptedPath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"attachment.encrypted"];
+    self.decryptedPath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"attachment.decrypted"];
+}
+
+- (void)tearDown
+{
+    for (NSString *path in @[self.plainPath, self.encryptedPath, self.decryptedPath]) {
+        [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    }
+    [super tearDown];
+}
+
+- (NSData *)writePlainFileWithLength:(NSUInteger) length
+{
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    uint8_t *bytes = [data mutableBytes];
+    for (NSUInteger i = 0; i < length; i++) {
+        bytes[i] = (uint8_t) (i * 31 + i / 251);
+    }
+    [data writeToFile:self.plainPath atomically:NO];
+    return data;
+}
+
+- (NSData *)encryptPlainFileWithLength:(NSUInteger) length
+{
+    NSData *plain = [self writePlainFileWithLength:length];
+    NSError *error = nil;
+    XCTAssertTrue([self.cipher encryptFile:self.plainPath toFile:self.encryptedPath error:&error], @"%@", error);
+    return plain;
+}
+
+- (NSInteger)decryptionError
+{
+    NSData *previous = [NSData dataWithContentsOfFile:self.decryptedPath];
+    NSError *error = nil;
+    BOOL success = [self.cipher decryptFile:self.encryptedPath toFile:self.decryptedPath error:&error];
+
+    // A failed decryption leaves the target as it was and no partial file behind
+    if (!success)
+        XCTAssertEqualObjects([NSData dataWithContentsOfFile:self.decryptedPath], previous);
+    NSArray *files = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:NSTemporaryDirectory() error:nil];
+    XCTAssertEqual([[files filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"self ENDSWITH '.partial'"]] count], (NSUInteger) 0);
+    return success ? 0 : error.code;
+}
+
+- (void)testRoundTrip
+{
+    for (NSNumber *length in @[@0, @1, @(TEST_CHUNK_SIZE), @(3 * TEST_CHUNK_SIZE + 100)]) {
+        NSData *plain = [self encryptPlainFileWithLength:[length unsignedIntegerValue]];
+
+        XCTAssertEqual([self decryptionError], (NSInteger) 0);
+        XCTAssertEqualObjects([NSData dataWithContentsOfFile:self.decryptedPath], plain, @"length %@", length);
+        XCTAssertEqual([self.cipher plainSizeOfFile:self.encryptedPath], (long long) [plain length]);
+    }
+}
+
+- (void)testDecryptRangeAcrossChunks
+{
+    NSData *plain = [self encryptPlainFileWithLength:3 * TEST_CHUNK_SIZE + 100];
+    NSRange range = NSMakeRange(TEST_CHUNK_SIZE - 10, TEST_CHUNK_SIZE + 20);
+
+    XCTAssertEqualObjects([self.cipher decryptRange:range ofFile:self.encryptedPath error:nil], [plain subdataWithRange:range]);
+
+    // Range beyond the end is clipped
+    NSData *tail = [self.cipher decryptRange:NSMakeRange(3 * TEST_CHUNK_SIZE, 1000) ofFile:self.encryptedPath error:nil];
+    XCTAssertEqualObjects(tail, [plain subdataWithRange:NSMakeRange(3 * TEST_CHUNK_SIZE, 100)]);
+}
+
+- (void)testTruncationAtChunkBoundaryIsRejected
+{
+    [self encryptPlainFileWithLength:3 * TEST_CHUNK_SIZE + 100];
+
+    NSData *encrypted = [NSData dataWithContentsOfFile:self.encryptedPath];
+    [[encrypted subdataWithRange:NSMakeRange(0, HEADER_LENGTH + 2 * ENCRYPTED_CHUNK)] writeToFile:self.encryptedPath atomically:NO];
+
+    XCTAssertEqual([self decryptionError], (NSInteger) AttachmentStreamErrorAuthentication);
+}
+
+- (void)testTruncationInsideChunkIsRejected
+{
+    [self encryptPlainFileWithLength:3 * TEST_CHUNK_SIZE + 100];
+
+    NSData *encrypted = [NSData dataWithContentsOfFile:self.encryptedPath];
+    [[encrypted subdataWithRange:NSMakeRange(0, [encrypted length] - 50)] writeToFile:self.encryptedPath atomically:NO];
+
+    XCTAssertEqual([self decryptionError], (NSInteger) AttachmentStreamErrorAuthentication);
+}
+
+- (void)testReorderedChunksAreRejected
+{
+    [self encryptPlainFileWithLength:3 * TEST_CHUNK_SIZE + 100];
+
+    NSMutableData *encrypted = [[NSData dataWithContentsOfFile:self.encryptedPath] mutableCopy];
+    NSRange first = NSMakeRange(HEADER_LENGTH, ENCRYPTED_CHUNK);
+    NSRange second = NSMakeRange(HEADER_LENGTH + ENCRYPTED_CHUNK, ENCRYPTED_CHUNK);
+    NSData *firstChunk = [encrypted subdataWithRange:first];
+    [encrypted replaceBytesInRange:first withBytes:[[encrypted subdataWithRange:second] bytes]];
+    [encrypted replaceBytesInRange:second withBytes:[firstChunk bytes]];
+    [encrypted writeToFile:self.encryptedPath atomically:NO];
+
+    XCTAssertEqual([self decryptionError], (NSInteger) AttachmentStreamErrorAuthentication);
+}
+
+- (void)testModifiedChunkIsRejected
+{
+    [self encryptPlainFileWithLength:2 * TEST_CHUNK_SIZE];
+
+    NSMutableData *encrypted = [[NSData dataWithContentsOfFile:self.encryptedPath] mutableCopy];
+    ((uint8_t *)[encrypted mutableBytes])[HEADER_LENGTH + ENCRYPTED_CHUNK + 5] ^= 0x80;
+    [encrypted writeToFile:self.encryptedPath atomically:NO];
+
+    XCTAssertEqual([self decryptionError], (NSInteger) AttachmentStreamErrorAuthentication);
+    XCTAssertNotNil([self.cipher decryptRange:NSMakeRange(0, 10) ofFile:self.encryptedPath error:nil]);
+    XCTAssertNil([self.cipher decryptRange:NSMakeRange(TEST_CHUNK_SIZE, 10) ofFile:self.encryptedPath error:nil]);
+}
+
+- (void)testFailedDecryptionKeepsTarget
+{
+    NSData *existing = [@"existing" dataUsingEncoding:NSUTF8StringEncoding];
+    [existing writeToFile:self.decryptedPath atomically:NO];
+
+    [self encryptPlainFileWithLength:3 * TEST_CHUNK_SIZE + 100];
+    NSMutableData *encrypted = [[NSData dataWithContentsOfFile:self.encryptedPath] mutableCopy];
+    ((uint8_t *)[encrypted mutableBytes])[HEADER_LENGTH + 2 * ENCRYPTED_CHUNK + 5] ^= 0x80;
+    [encrypted writeToFile:self.encryptedPath atomically:NO];
+
+    // The chunks before the modified one have been decrypted, but must not reach the target
+    XCTAssertEqual([self decryptionError], (NSInteger) AttachmentStreamErrorAuthentication);
+    XCTAssertEqualObjects([NSData dataWithContentsOfFile:self.decryptedPath], existing);
+}
+
+- (void)testOtherKeyIsRejected
+{
+    [self encryptPlainFileWithLength:100];
+    self.cipher = [[AttachmentStreamCipher alloc] initWithKey:[AttachmentStreamCipher generateKey] chunkSize:TEST_CHUNK_SIZE];
+
+    XCTAssertEqual([self decryptionError], (NSInteger) AttachmentStreamErrorAuthentication);
+}
+
+@end
@@ -0,0 +1,79 @@
+//
+//  CallStatsHistogramTests.m
+//  ChatsAppTests
+//
+//  Created by Ryan Opoku on 30/05/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "CallStatsHistogram.h"
+
+@interface CallStatsHistogramTests : XCTestCase
+
+@end
+
+@implementation CallStatsHistogramTests
+
+- (void)testBuckets
+{
+    CallStatsHistogram *histogram = [[CallStatsHistogram alloc] initWithUnit:@"ms"];
+    [histogram addValue:0.5];
+    [histogram addValue:1.];
+    [histogram addValue:3.];
+    [histogram addValue:3.9];
+    [histogram addValue:-1.];
+
+    NSDictionary *snapshot = [histogram snapshot];
+    NSArray *buckets = snapshot[@"buckets"];
+
+    XCTAssertEqual([snapshot[@"count"] longLongValue], 4LL);
+    XCTAssertEqualObjects(buckets, (@[@1, @1, @2]));
+    XCTAssertEqualWithAccuracy([snapshot[@"min"] doubleValue], 0.5, 0.001);
+    XCTAssertEqualWithAccuracy([snapshot[@"max"] doubleValue], 3.9, 0.001);
+    XCTAssertEqualWithAccuracy([snapshot[@"mean"] doubleValue], 2.1, 0.001);
+}
+
+- (void)testPercentile
+{
+    CallStatsHistogram *histogram = [[CallStatsHistogram alloc] initWithUnit:@"ms"];
+    for (int i = 0; i < 100; i++) {
+        [histogram addValue:i < 90 ? 10. : 200.];
+    }
+
+    XCTAssertEqualWithAccuracy([histogram percentile:50.], 16., 0.001);
+    XCTAssertEqualWithAccuracy([histogram percentile:95.], 200., 0.001);
+
+    [histogram reset];
+    XCTAssertEqual([histogram count], 0LL);
+    XCTAssertEqualWithAccuracy([histogram percentile:95.], 0., 0.001);
+}
+
+- (void)testConcurrentAdd
+{
+    CallStatsHistogram *histogram = [[CallStatsHistogram alloc] initWithUnit:@"ms"];
+    dispatch_apply(8, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t thread) {
+        for (int i = 0; i < 10000; i++) {
+            [histogram addValue:thread + 1];
+        }
+    });
+
+    NSDictionary *snapshot = [histogram snapshot];
+    XCTAssertEqual([snapshot[@"count"] longLongValue], 80000LL);
+    XCTAssertEqualWithAccuracy([snapshot[@"min"] doubleValue], 1., 0.001);
+    XCTAssertEqualWithAccuracy([snapshot[@"max"] doubleValue], 8., 0.001);
+    XCTAssertEqualWithAccuracy([snapshot[@"mean"] doubleValue], 4.5, 0.001);
+}
+
+- (void)testAddOverhead
+{
+    CallStatsHistogram *histogram = [[CallStatsHistogram alloc] initWithUnit:@"ms"];
+    [self measureBlock:^{
+        for (int i = 0; i < 100000; i++) {
+            [histogram addValue:i % 500];
+        }
+        [histogram snapshot];
+    }];
+}
+
+@end
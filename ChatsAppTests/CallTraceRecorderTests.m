@@ -0,0 +1,118 @@
+//
+//  CallTraceRecorderTests.m
+//  ChatsAppTests
+//
+//  Created by Ryan Opoku on 02/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "CallTraceRecorder.h"
+
+@interface CallTraceRecorderTests : XCTestCase {
+    BOOL wasEnabled;
+}
+
+@property(nonatomic, strong) CallTraceRecorder *recorder;
+@property(nonatomic, strong) NSString *tracePath;
+@property(nonatomic, strong) NSString *traceDirectory;
+
+@end
+
+@implementation CallTraceRecorderTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.recorder = [[CallTraceRecorder alloc] init];
+    wasEnabled = self.recorder.enabled;
+    self.recorder.enabled = YES;
+    self.tracePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"test.ctrace"];
+
+    // stopAndFlush writes and prunes here, not in the app's trace directory
+    self.traceDirectory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    self.recorder.traceDirectory = self.traceDirectory;
+}
+
+- (void)tearDown
+{
+    self.recorder.enabled = wasEnabled;
+    [[NSFileManager defaultManager] removeItemAtPath:self.tracePath error:nil];
+    [[NSFileManager defaultManager] removeItemAtPath:self.traceDirectory error:nil];
+    [super tearDown];
+}
+
+- (void)testRoundTrip
+{
+    [self.recorder start];
+    [self.recorder recordEvent:CallTraceEncoderAdjusted value:12 value:1 value:850];
+    [self.recorder recordEvent:CallTraceStatsSample value:15 value:14 value:3];
+
+    XCTAssertTrue([self.recorder writeTraceToFile:self.tracePath]);
+    [self.recorder stopAndFlush];
+
+    NSArray *records = [CallTraceRecorder recordsFromTraceFile:self.tracePath];
+    XCTAssertEqual([records count], (NSUInteger) 3);
+    XCTAssertEqualObjects(records[0][@"type"], @(CallTraceCallConnected));
+    XCTAssertEqualObjects(records[1][@"type"], @(CallTraceEncoderAdjusted));
+    XCTAssertEqualObjects(records[1][@"values"], (@[@12, @1, @850]));
+    XCTAssertEqualObjects(records[2][@"values"], (@[@15, @14, @3]));
+}
+
+- (void)testRingKeepsNewestRecords
+{
+    self.recorder.capacity = 4;
+    [self.recorder start];
+    for (int i = 0; i < 9; i++) {
+        [self.recorder recordEvent:CallTraceKeyframeDistance value:i value:0 value:0];
+    }
+
+    XCTAssertTrue([self.recorder writeTraceToFile:self.tracePath]);
+    [self.recorder stopAndFlush];
+
+    NSArray *records = [CallTraceRecorder recordsFromTraceFile:self.tracePath];
+    XCTAssertEqual([records count], (NSUInteger) 4);
+    for (int i = 0; i < 4; i++) {
+        XCTAssertEqualObjects(records[i][@"values"][0], @(5 + i));
+    }
+}
+
+- (void)testDisabledRecorderIgnoresEvents
+{
+    self.recorder.enabled = NO;
+    [self.recorder start];
+    [self.recorder recordEvent:CallTraceStatsSample value:1 value:2 value:3];
+
+    XCTAssertFalse([self.recorder writeTraceToFile:self.tracePath]);
+}
+
+- (void)testPruneKeepsNewestTraceFiles
+{
+    NSString *dir = [NSTemporaryDirectory() stringByAppendingPathComponent:@"CallTracesTest"];
+    NSFileManager *fm = [NSFileManager defaultManager];
+    [fm createDirectoryAtPath:dir withIntermediateDirectories:YES attributes:nil error:nil];
+
+    NSDate *now = [NSDate date];
+    for (int i = 0; i < 5; i++) {
+        NSString *path = [dir stringByAppendingPathComponent:[NSString stringWithFormat:@"%d.ctrace", i]];
+        [[NSData data] writeToFile:path atomically:YES];
+        [fm setAttributes:@{NSFileModificationDate : [now dateByAddingTimeInterval:i]} ofItemAtPath:path error:nil];
+    }
+    [[NSData data] writeToFile:[dir stringByAppendingPathComponent:@"other.txt"] atomically:YES];
+
+    [CallTraceRecorder pruneTraceFilesInDirectory:dir keepingNewest:2];
+
+    NSArray *left = [[fm contentsOfDirectoryAtPath:dir error:nil] sortedArrayUsingSelector:@selector(compare:)];
+    XCTAssertEqualObjects(left, (@[@"3.ctrace", @"4.ctrace", @"other.txt"]));
+
+    [fm removeItemAtPath:dir error:nil];
+}
+
+- (void)testInvalidFile
+{
+    [[@"not a trace" dataUsingEncoding:NSUTF8StringEncoding] writeToFile:self.tracePath atomically:YES];
+    XCTAssertNil([CallTraceRecorder recordsFromTraceFile:self.tracePath]);
+}
+
+@end
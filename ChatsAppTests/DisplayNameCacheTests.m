@@ -0,0 +1,137 @@
+//
+//  DisplayNameCacheTests.m
+//  ChatsAppTests
+//
+//  Created by Ryan Opoku on 13/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import <libkern/OSAtomic.h>
+#import "DisplayNameCache.h"
+
+@interface DisplayNameCacheTests : XCTestCase
+
+@property(nonatomic, strong) DisplayNameCache *cache;
+@property(nonatomic, strong) NSMutableDictionary *directory;
+
+@end
+
+@implementation DisplayNameCacheTests
+{
+    volatile int32_t resolveCount;
+}
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.directory = [NSMutableDictionary dictionary];
+    for (int i = 0; i < 1000; i++) {
+        self.directory[[NSString stringWithFormat:@"user%d", i]] = [NSString stringWithFormat:@"User %d", i % 100];
+    }
+    NSDictionary *directory = [self.directory copy];
+
+    resolveCount = 0;
+    self.cache = [[DisplayNameCache alloc] init];
+
+    __weak DisplayNameCacheTests *weakself = self;
+    self.cache.resolver = ^NSString *(NSString *userid) {
+        DisplayNameCacheTests *strongself = weakself;
+        if (strongself)
+            OSAtomicIncrement32(&strongself->resolveCount);
+        return directory[userid];
+    };
+}
+
+- (void)testNameIsResolvedOnce
+{
+    XCTAssertEqualObjects([self.cache nameForUserid:@"user1"], @"User 1");
+    XCTAssertEqualObjects([self.cache nameForUserid:@"user1"], @"User 1");
+    XCTAssertEqual(resolveCount, 1);
+
+    XCTAssertNil([self.cache nameForUserid:@"unknown"]);
+    XCTAssertEqual(self.cache.count, (NSUInteger) 1);
+}
+
+- (void)testUnknownUserIsResolvedOnce
+{
+    XCTAssertNil([self.cache nameForUserid:@"unknown"]);
+    XCTAssertNil([self.cache nameForUserid:@"unknown"]);
+    XCTAssertEqual(resolveCount, 1);
+
+    // Inserting the user invalidates the negative entry
+    [self.cache invalidateUserids:@[@"unknown"]];
+    XCTAssertNil([self.cache nameForUserid:@"unknown"]);
+    XCTAssertEqual(resolveCount, 2);
+}
+
+- (void)testColdLookupsAreResolvedOnce
+{
+    NSArray *userids = [self.directory allKeys];
+    for (NSString *userid in userids) {
+        XCTAssertEqualObjects([self.cache nameForUserid:userid], self.directory[userid]);
+    }
+    for (NSString *userid in userids) {
+        [self.cache nameForUserid:userid];
+    }
+
+    XCTAssertEqual(resolveCount, (int32_t) [userids count]);
+    XCTAssertEqual(self.cache.count, [userids count]);
+    XCTAssertEqual(self.cache.internedCount, (NSUInteger) 100);
+}
+
+- (void)testEqualNamesAreInterned
+{
+    [self.cache prefetchUserids:@[@"user1", @"user101"]];
+    XCTAssertEqual(resolveCount, 2);
+    XCTAssertTrue([self.cache nameForUserid:@"user1"] == [self.cache nameForUserid:@"user101"]);
+}
+
+- (void)testInvalidation
+{
+    [self.cache prefetchUserids:@[@"user1", @"user2"]];
+    [self.cache invalidateUserids:@[@"user1"]];
+    XCTAssertEqual(self.cache.count, (NSUInteger) 1);
+
+    [self.cache nameForUserid:@"user1"];
+    [self.cache nameForUserid:@"user2"];
+    XCTAssertEqual(resolveCount, 3);
+
+    [self.cache invalidateAll];
+    XCTAssertEqual(self.cache.count, (NSUInteger) 0);
+}
+
+- (void)testInvalidationReleasesUnusedNames
+{
+    [self.cache prefetchUserids:@[@"user1", @"user101", @"user2"]];
+    XCTAssertEqual(self.cache.internedCount, (NSUInteger) 2);
+
+    // "User 1" is still used by user101
+    [self.cache invalidateUserids:@[@"user1", @"user2"]];
+    XCTAssertEqual(self.cache.internedCount, (NSUInteger) 1);
+
+    [self.cache invalidateUserids:@[@"user101"]];
+    XCTAssertEqual(self.cache.internedCount, (NSUInteger) 0);
+}
+
+- (void)testConcurrentReaders
+{
+    [self.cache prefetchUserids:[self.directory allKeys]];
+    NSArray *userids = [self.directory allKeys];
+
+    // 8 readers, one of them invalidates every 1000 lookups
+    [self measureBlock:^{
+        dispatch_apply(8, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t reader) {
+            for (NSUInteger i = 0; i < 20000; i++) {
+                NSString *userid = userids[(i * 31 + reader) % [userids count]];
+                if (reader == 0 && i % 1000 == 0)
+                    [self.cache invalidateUserids:@[userid]];
+
+                XCTAssertNotNil([self.cache nameForUserid:userid]);
+            }
+        });
+    }];
+}
+
+@end
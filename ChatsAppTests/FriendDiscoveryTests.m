@@ -0,0 +1,153 @@
+//
+//  FriendDiscoveryTests.m
+//  ChatsAppTests
+//
+//  Created by Ryan Opoku on 12/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "FriendDiscovery.h"
+
+@interface MockFriendDirectory : NSObject<FriendDiscoveryDirectory>
+
+@property(nonatomic, strong) NSMutableArray *requests;
+
+@end
+
+@implementation MockFriendDirectory
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.requests = [NSMutableArray array];
+    }
+    return self;
+}
+
+-(void) findFriends:(NSArray *) identifiers
+{
+    [self.requests addObject:identifiers];
+}
+
+@end
+
+@interface FriendDiscoveryTests : XCTestCase
+
+@property(nonatomic, strong) FriendDiscovery *discovery;
+@property(nonatomic, strong) MockFriendDirectory *directory;
+@property(nonatomic, strong) NSString *path;
+
+@end
+
+@implementation FriendDiscoveryTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    self.directory = [[MockFriendDirectory alloc] init];
+    self.discovery = [self discoveryWithPath:self.path];
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:self.path error:nil];
+    [super tearDown];
+}
+
+-(FriendDiscovery *) discoveryWithPath:(NSString *) path
+{
+    FriendDiscovery *discovery = [[FriendDiscovery alloc] initWithPath:path];
+    discovery.directory = self.directory;
+    discovery.countryCode = @"49";
+    return discovery;
+}
+
+// 5000 contacts, every number stored once in national and once in international format
+-(NSArray *) addressBookFixture
+{
+    NSMutableArray *identifiers = [NSMutableArray arrayWithCapacity:10000];
+    for (int i = 0; i < 5000; i++) {
+        [identifiers addObject:[NSString stringWithFormat:@"0170 %07d", i]];
+        [identifiers addObject:[NSString stringWithFormat:@"+49 170 %07d", i]];
+    }
+    return identifiers;
+}
+
+- (void)testNormalizedIdentifier
+{
+    XCTAssertEqualObjects([FriendDiscovery normalizedIdentifier:@"030 123456" countryCode:@"49"], @"+4930123456");
+    XCTAssertEqualObjects([FriendDiscovery normalizedIdentifier:@"0049 30 123456" countryCode:@"49"], @"+4930123456");
+    XCTAssertEqualObjects([FriendDiscovery normalizedIdentifier:@"030 123456" countryCode:nil], @"030123456");
+    XCTAssertEqualObjects([FriendDiscovery normalizedIdentifier:@"Bob@Example.com" countryCode:@"49"], @"bob@example.com");
+
+    // Only the trunk prefix 0 is converted
+    XCTAssertEqualObjects([FriendDiscovery normalizedIdentifier:@"8 495 1234567" countryCode:@"7"], @"84951234567");
+}
+
+- (void)testIdentifiersLookedUpElsewhereAreCached
+{
+    [self.discovery cacheIdentifiersAsLookedUp:@[@"030 123456", @"a@example.com"]];
+
+    XCTAssertTrue([self.discovery isCachedAsUnregistered:@"+49 30 123456"]);
+    XCTAssertEqual([self.discovery discoverIdentifiers:@[@"030 123456", @"a@example.com", @"b@example.com"]], (NSUInteger) 1);
+    XCTAssertEqualObjects([self.directory.requests lastObject], (@[@"b@example.com"]));
+}
+
+- (void)testFullScanIsBatchedAndDeduplicated
+{
+    NSUInteger sent = [self.discovery discoverIdentifiers:[self addressBookFixture]];
+
+    XCTAssertEqual(sent, (NSUInteger) 5000);
+    XCTAssertEqual(self.discovery.requestCount, (NSUInteger) 50);
+    XCTAssertEqual(self.discovery.skippedCount, (NSUInteger) 5000);
+    XCTAssertEqual([self.directory.requests[0] count], (NSUInteger) 100);
+}
+
+- (void)testRescanUsesNegativeCache
+{
+    [self.discovery discoverIdentifiers:[self addressBookFixture]];
+    XCTAssertEqual([self.discovery discoverIdentifiers:[self addressBookFixture]], (NSUInteger) 0);
+    XCTAssertEqual(self.discovery.requestCount, (NSUInteger) 50);
+
+    // The cache survives a restart
+    FriendDiscovery *restarted = [self discoveryWithPath:self.path];
+    XCTAssertTrue([restarted isCachedAsUnregistered:@"0170 0000001"]);
+    XCTAssertEqual([restarted discoverIdentifiers:[self addressBookFixture]], (NSUInteger) 0);
+    XCTAssertEqual(restarted.requestCount, (NSUInteger) 0);
+}
+
+- (void)testCacheFileHoldsNoIdentifiers
+{
+    [self.discovery discoverIdentifiers:@[@"a@example.com", @"030 123456"]];
+
+    NSString *file = [[NSString alloc] initWithData:[NSData dataWithContentsOfFile:self.path] encoding:NSUTF8StringEncoding];
+    XCTAssertNotNil(file);
+    XCTAssertEqual([file rangeOfString:@"@example.com"].location, (NSUInteger) NSNotFound);
+    XCTAssertEqual([file rangeOfString:@"+4930123456"].location, (NSUInteger) NSNotFound);
+    XCTAssertTrue([[self discoveryWithPath:self.path] isCachedAsUnregistered:@"A@example.com"]);
+}
+
+- (void)testExpiredEntriesAreLookedUpAgain
+{
+    self.discovery.negativeTTL = 0.;
+    [self.discovery discoverIdentifiers:@[@"a@example.com"]];
+    XCTAssertFalse([self.discovery isCachedAsUnregistered:@"a@example.com"]);
+    XCTAssertEqual([self.discovery discoverIdentifiers:@[@"a@example.com"]], (NSUInteger) 1);
+}
+
+- (void)testFriendsAreNotLookedUp
+{
+    [self.discovery discoverIdentifiers:@[@"a@example.com", @"030 123456"]];
+    [self.discovery addFriendIdentifiers:@[@"A@example.com", @"+49 30 123456"]];
+
+    XCTAssertFalse([self.discovery isCachedAsUnregistered:@"a@example.com"]);
+    [self.discovery invalidateAll];
+    XCTAssertEqual([self.discovery discoverIdentifiers:@[@"a@example.com", @"030 123456", @"b@example.com"]], (NSUInteger) 1);
+    XCTAssertEqualObjects([self.directory.requests lastObject], (@[@"b@example.com"]));
+}
+
+@end
@@ -0,0 +1,214 @@
+//
+//  KeyDirectoryCacheTests.m
+//  ChatsAppTests
+//
+//  Created by Ryan Opoku on 10/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "KeyDirectoryCache.h"
+
+// Test directory CA, certificate of alice issued by it, and an unrelated CA, valid 2014 to 2114
+static NSString * const TestDirectoryCA =
+    @"MIIDCTCCAfGgAwIBAgIBATANBgkqhkiG9w0BAQsFADAlMSMwIQYDVQQDDBpDaGF0c0FwcCBUZXN0IERpcmVjdG9yeSBDQTAgFw0x"
+    @"NDA2MDEwMDAwMDBaGA8yMTE0MDYwMTAwMDAwMFowJTEjMCEGA1UEAwwaQ2hhdHNBcHAgVGVzdCBEaXJlY3RvcnkgQ0EwggEiMA0G"
+    @"CSqGSIb3DQEBAQUAA4IBDwAwggEKAoIBAQC2LBkpk5In3ScO+D8DozowWglBN1JjaABi4hG+kSu4ZncVMBoBbiXYxvcvjkUWHELN"
+    @"z2363VLwqQ1whGN5OESU/VvqI64ZL9GQZBaqYriXIEs5WK70DG78/IrD1Ah3RchuAa74i6zY7TY/TlUxE6OVyr98AJ6tugZ9V/x0"
+    @"vpVurnnGAjOPDDERy43oT4fg/MAJc/Nu2sffYcGcKCerxM9bTMNvWVVJzP+8ttgJDIdWnwAPm8txb26zmXiHFg1AQDBIIdtwyZ5Y"
+    @"7vryyHxGJawvmBCS3kmlZcEO3UpV1rdNXzz3FScyU0Wie8ftHnK0zzLneia4LXvkoC3YLKTnlO35AgMBAAGjQjBAMA8GA1UdEwEB"
+    @"/wQFMAMBAf8wDgYDVR0PAQH/BAQDAgEGMB0GA1UdDgQWBBSLGSk96TW8fCryhZoI48kC7Hro6TANBgkqhkiG9w0BAQsFAAOCAQEA"
+    @"PSDPu5mhReK3IToGFwuZtWynMVPAta1UTtmBKvAwNEl9lbXE4BrnviUsaJ3xa6fim4kBlLJ+uSGHqz6bIuU9hC8eYXasy37fxHKQ"
+    @"uTl0CVo75MQrmiCSzi6w/VNBq0WWuKYSoJ8tK2gHFaQTiLzw4K9jaXzdRM3sDpNhLP2TKu2JChsN0nwLGQQBZLyfVkm6mLVL5G27"
+    @"B3fbICsstiTJKixm8dtKQJwRqALh84WTv8fao72ydIBTt5h37WcyhYI7O6ECTyPGLfva4ImarAsSXFB+L5DXe1UVwyGWXU43OI9+"
+    @"BuI9Ay75L484n1uyTptS/Rh9j+e6YVSHS4qY5thhxw==";
+
+static NSString * const TestAliceCertificate =
+    @"MIIDEjCCAfqgAwIBAgIBAjANBgkqhkiG9w0BAQsFADAlMSMwIQYDVQQDDBpDaGF0c0FwcCBUZXN0IERpcmVjdG9yeSBDQTAgFw0x"
+    @"NDA2MDEwMDAwMDBaGA8yMTE0MDYwMTAwMDAwMFowEDEOMAwGA1UEAwwFYWxpY2UwggEiMA0GCSqGSIb3DQEBAQUAA4IBDwAwggEK"
+    @"AoIBAQC/JNeWL/uogFFhZETOwtdCHI+iwlHLPZuLX52KuIfKyeWSSJXuAiIbiIizMk9HzzKIqQCXeVPCRIRJOK1PnTM57kNaFGxZ"
+    @"0ZE9+Ikrd2nL1/sCeBH/u0Oe8q6cml4G1uoVCYpYC6dPZ2cYtdMcM29QyrpHsGQpciFmwpFF1TGNp8iXiRxsolHOUHsmA129XjXF"
+    @"GChTAjpErX+PlFaUmg3QCGUKvW76nPPQnXON2weWfdgpks+HEwjq7n/zCkXrqWy+EyxaRICd5glzpITg1Hmx66bQl4jo5rQ1xEkr"
+    @"GLMru+/GQ3Stn+iCLo6MhA7JgVGQnSnV5UN486PRpKfO+TfDAgMBAAGjYDBeMAwGA1UdEwEB/wQCMAAwDgYDVR0PAQH/BAQDAgWg"
+    @"MB0GA1UdDgQWBBQQTritpD8YxunYKCroQoS+eYdF0zAfBgNVHSMEGDAWgBSLGSk96TW8fCryhZoI48kC7Hro6TANBgkqhkiG9w0B"
+    @"AQsFAAOCAQEAC8Q6JQz/BmQ2GjepWt9O1c1zfdSrHC8KowT9Zr6Dj7vaLGl2/yD3MgErHWZyUAzglo+aAqnBsKltWWkW2hAOuVF0"
+    @"wMtgFeGamx6rYFn3LAaIKqd2jlAxScE5BNI/optMj7cyTLqdkLQskwKJBEi4nTO9/PRW7L/+XvITIGn/ikh3p5MoXXz/P+IscOoJ"
+    @"bxAqI+xEzID4REetqv7Dq5w4jDep/cVFEkdiQJocAWN7wWWjOi3PIe9j8m4l/SMRza+lEbUrIBq9kT+DDn+1oWP+85lIflXiWr3I"
+    @"yKp0EN0iR80oHb1twaK3wwti+9QQJc8ltGcfqbqyceskVh6SMBWFIA==";
+
+static NSString * const TestOtherCA =
+    @"MIIC5TCCAc2gAwIBAgIBAzANBgkqhkiG9w0BAQsFADATMREwDwYDVQQDDAhPdGhlciBDQTAgFw0xNDA2MDEwMDAwMDBaGA8yMTE0"
+    @"MDYwMTAwMDAwMFowEzERMA8GA1UEAwwIT3RoZXIgQ0EwggEiMA0GCSqGSIb3DQEBAQUAA4IBDwAwggEKAoIBAQDA1G55tRAY+9PE"
+    @"ICd9yO9LOfBMJ3RpbFP3I4kr+AVbNuFEVes4RsPQt6EolU8+XDmhSAWuTsVhvQT1pRUDzXG116hhXhL0a9gc0kt4cOqlvGN8W8oi"
+    @"dsKxyjpgKqXxZqbId0c8uE39KQFcU2Kif+pQt3sqswtrGnxbmRFYGQ3yOZF0ae1WYT12E4k3rWU8cLbAhqc3ou6Qa2/o6AKba3cj"
+    @"AY73gAulSJJ6QHgAfeKYOUOvLY547JhvOgLnRqzLSbIgC8n6koFsPuxu5tB+RuAV996txfdLQFEHTctJBDUDMOyFz244/ZLzePZe"
+    @"J43L68DCwGq7ZDnEXXgXvqb6OjGfAgMBAAGjQjBAMA8GA1UdEwEB/wQFMAMBAf8wDgYDVR0PAQH/BAQDAgEGMB0GA1UdDgQWBBRq"
+    @"cCVphhg7BQgJ7C7IUqwjc19YSjANBgkqhkiG9w0BAQsFAAOCAQEACxFIRfPEbtJzoUqnXPqiQ0mkr8jQAzNTn1ckkRZcKCm1KXzu"
+    @"+VeOybJjYq68Ve6e/1eywPgL4WTcyKUca3h2QUffVSO5JtrMwMontQjgVTrSl77geRyAhfXUoQMDBUll23uaVdckaXFZzusnkEIG"
+    @"CSyjC4BrZq96ODqJWaXb95vnrh//AxX9PLsFJgMw47BBzy6mCLHsF20b8JXkCyXDKnfUKF1YDbLRBuNFdzGr+9K1ap8x78Dho9X8"
+    @"WAzB3VS7bhlJqwluURIyDomYV52Y2BVG7v7ulazergWb+9QxL6V83LKVWmCIf+aVA8EjdES+PsWGVFMddyKLiwQmdo8Izw==";
+
+@interface MockKeyDirectory : NSObject<KeyDirectorySource>
+
+@property(nonatomic, strong) NSMutableDictionary *certificates;
+@property(nonatomic, strong) NSMutableDictionary *versions;
+@property(nonatomic, strong) NSMutableArray *requests;
+@property(nonatomic) BOOL unresponsive;
+
+@end
+
+@implementation MockKeyDirectory
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.certificates = [NSMutableDictionary dictionary];
+        self.versions = [NSMutableDictionary dictionary];
+        self.requests = [NSMutableArray array];
+    }
+    return self;
+}
+
+-(void) fetchCertificatesForUserids:(NSArray *) userids completion:(void (^)(NSDictionary *certificates, NSDictionary *versions)) completion
+{
+    [self.requests addObject:userids];
+    if (!self.unresponsive)
+        completion([self.certificates copy], [self.versions copy]);
+}
+
+-(SecKeyRef) copyPrivateKey
+{
+    return NULL;
+}
+
+@end
+
+@interface KeyDirectoryCacheTests : XCTestCase
+
+@property(nonatomic, strong) KeyDirectoryCache *cache;
+@property(nonatomic, strong) MockKeyDirectory *directory;
+
+@end
+
+@implementation KeyDirectoryCacheTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.directory = [[MockKeyDirectory alloc] init];
+    self.directory.certificates[@"alice"] = [@"alice-cert" dataUsingEncoding:NSUTF8StringEncoding];
+    self.directory.certificates[@"bob"] = [@"bob-cert" dataUsingEncoding:NSUTF8StringEncoding];
+    self.directory.versions[@"alice"] = @"1";
+
+    self.cache = [[KeyDirectoryCache alloc] init];
+    self.cache.source = self.directory;
+    self.cache.batchDelay = 0.;
+}
+
+- (void)testLookupDoesNotBlock
+{
+    XCTAssertEqual([self.cache stateForUserid:@"alice"], KeyDirectoryUnknown);
+    XCTAssertNil([self.cache certificateForUserid:@"bob"]);
+
+    // The scheduled fetch runs before the next lookup
+    XCTAssertEqual([self.cache stateForUserid:@"alice"], KeyDirectoryAvailable);
+    XCTAssertEqualObjects([self.cache certificateForUserid:@"bob"], self.directory.certificates[@"bob"]);
+}
+
+- (void)testPrefetchIsBatched
+{
+    self.cache.batchSize = 2;
+    [self.cache prefetchUserids:@[@"alice", @"bob", @"carol", @"alice"]];
+
+    XCTAssertEqual([self.cache stateForUserid:@"carol"], KeyDirectoryNoKey);
+    XCTAssertEqual(self.cache.fetchCount, (NSUInteger) 2);
+    XCTAssertEqualObjects(self.directory.requests[0], (@[@"alice", @"bob"]));
+    XCTAssertEqualObjects(self.directory.requests[1], (@[@"carol"]));
+}
+
+- (void)testNegativeResultIsCached
+{
+    [self.cache stateForUserid:@"carol"];
+    XCTAssertEqual([self.cache stateForUserid:@"carol"], KeyDirectoryNoKey);
+    XCTAssertEqual([self.cache stateForUserid:@"carol"], KeyDirectoryNoKey);
+    XCTAssertEqual(self.cache.fetchCount, (NSUInteger) 1);
+}
+
+- (void)testExpiredEntryIsRefetched
+{
+    self.cache.negativeTTL = 0.;
+    [self.cache stateForUserid:@"carol"];
+    XCTAssertEqual([self.cache stateForUserid:@"carol"], KeyDirectoryNoKey);
+
+    // Expired entries are still answered, the refetch picks up the new certificate
+    self.directory.certificates[@"carol"] = [@"carol-cert" dataUsingEncoding:NSUTF8StringEncoding];
+    XCTAssertEqual([self.cache stateForUserid:@"carol"], KeyDirectoryAvailable);
+    XCTAssertEqual(self.cache.fetchCount, (NSUInteger) 2);
+}
+
+- (void)testUnansweredFetchTimesOut
+{
+    self.directory.unresponsive = YES;
+    self.cache.fetchTimeout = 0.05;
+
+    [self.cache stateForUserid:@"alice"];
+    XCTAssertEqual([self.cache stateForUserid:@"alice"], KeyDirectoryUnknown);
+    XCTAssertEqual(self.cache.fetchCount, (NSUInteger) 1);
+
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.2]];
+
+    self.directory.unresponsive = NO;
+    [self.cache stateForUserid:@"alice"];
+    XCTAssertEqual([self.cache stateForUserid:@"alice"], KeyDirectoryAvailable);
+    XCTAssertEqual(self.cache.fetchCount, (NSUInteger) 2);
+}
+
+- (NSData *)certificate:(NSString *) base64
+{
+    return [[NSData alloc] initWithBase64EncodedString:base64 options:0];
+}
+
+- (void)testCertificateIssuedByAnchorProvidesKey
+{
+    self.directory.certificates[@"alice"] = [self certificate:TestAliceCertificate];
+    self.cache.anchorCertificates = @[[self certificate:TestDirectoryCA]];
+    [self.cache prefetchUserids:@[@"alice"]];
+
+    SecKeyRef publicKey = [self.cache copyPublicKeyForUserid:@"alice"];
+    XCTAssertTrue(publicKey != NULL);
+    if (publicKey) {
+        XCTAssertEqual(SecKeyGetBlockSize(publicKey), (size_t) 256);
+        CFRelease(publicKey);
+    }
+}
+
+- (void)testCertificateOfOtherIssuerIsRejected
+{
+    self.directory.certificates[@"alice"] = [self certificate:TestAliceCertificate];
+    [self.cache prefetchUserids:@[@"alice"]];
+
+    // Without anchors nothing is trusted, not even a certificate a system root would accept
+    XCTAssertTrue([self.cache copyPublicKeyForUserid:@"alice"] == NULL);
+
+    self.cache.anchorCertificates = @[[self certificate:TestOtherCA]];
+    XCTAssertTrue([self.cache copyPublicKeyForUserid:@"alice"] == NULL);
+    XCTAssertEqual([self.cache stateForUserid:@"alice"], KeyDirectoryAvailable);
+}
+
+- (void)testVersionChangeInvalidates
+{
+    [self.cache prefetchUserids:@[@"alice"]];
+    XCTAssertEqual([self.cache stateForUserid:@"alice"], KeyDirectoryAvailable);
+
+    [self.cache setVersion:@"1" forUserid:@"alice"];
+    XCTAssertEqual(self.cache.fetchCount, (NSUInteger) 1);
+
+    self.directory.versions[@"alice"] = @"2";
+    [self.cache setVersion:@"2" forUserid:@"alice"];
+    XCTAssertEqual([self.cache stateForUserid:@"alice"], KeyDirectoryAvailable);
+    XCTAssertEqual(self.cache.fetchCount, (NSUInteger) 2);
+}
+
+@end
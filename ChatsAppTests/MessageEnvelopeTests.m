@@ -0,0 +1,123 @@
+//
+//  MessageEnvelopeTests.m
+//  ChatsAppTests
+//
+//  Created by Ryan Opoku on 08/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "MessageEnvelope.h"
+
+@interface MessageEnvelopeTests : XCTestCase
+
+@property(nonatomic, strong) MessageSessionKey *key;
+@property(nonatomic, strong) NSData *message;
+
+@end
+
+@implementation MessageEnvelopeTests
+
+- (MessageSessionKey *)keyWithSeed:(uint8_t) seed
+{
+    uint8_t keyId[MESSAGE_KEY_ID_LENGTH], material[MESSAGE_SESSION_KEY_LENGTH];
+    memset(keyId, seed, sizeof(keyId));
+    for (int i = 0; i < MESSAGE_SESSION_KEY_LENGTH; i++) {
+        material[i] = seed + i;
+    }
+
+    NSData *wrapped = [@"wrapped" dataUsingEncoding:NSUTF8StringEncoding];
+    return [[MessageSessionKey alloc] initWithKeyId:[NSData dataWithBytes:keyId length:sizeof(keyId)] keyMaterial:[NSData dataWithBytes:material length:sizeof(material)] wrappedKey:wrapped];
+}
+
+- (void)setUp
+{
+    [super setUp];
+    self.key = [self keyWithSeed:1];
+    self.message = [@"Hello, this is a test message" dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+- (void)testRoundTrip
+{
+    NSData *envelope = [self.key seal:self.message];
+
+    XCTAssertNotNil(envelope);
+    XCTAssertEqualObjects([self.key open:envelope], self.message);
+    XCTAssertEqual(self.key.messageCount, (NSUInteger) 1);
+}
+
+- (void)testEnvelopeCarriesKeyIdAndWrappedKey
+{
+    NSData *envelope = [self.key seal:self.message];
+
+    XCTAssertEqualObjects([MessageSessionKey keyIdOfEnvelope:envelope], self.key.keyId);
+    XCTAssertEqualObjects([MessageSessionKey wrappedKeyOfEnvelope:envelope], self.key.wrappedKey);
+}
+
+- (void)testSameMessageSealsDifferently
+{
+    XCTAssertNotEqualObjects([self.key seal:self.message], [self.key seal:self.message]);
+}
+
+- (void)testModifiedEnvelopeIsRejected
+{
+    NSData *envelope = [self.key seal:self.message];
+
+    for (NSUInteger i = 0; i < [envelope length]; i += 7) {
+        NSMutableData *modified = [envelope mutableCopy];
+        ((uint8_t *)[modified mutableBytes])[i] ^= 0x01;
+        XCTAssertNil([self.key open:modified], @"modified byte %lu accepted", (unsigned long) i);
+    }
+}
+
+- (void)testTruncatedEnvelopeIsRejected
+{
+    NSData *envelope = [self.key seal:self.message];
+
+    XCTAssertNil([self.key open:[envelope subdataWithRange:NSMakeRange(0, [envelope length] - 1)]]);
+    XCTAssertNil([self.key open:[envelope subdataWithRange:NSMakeRange(0, 10)]]);
+}
+
+- (void)testOtherKeyIsRejected
+{
+    NSData *envelope = [self.key seal:self.message];
+
+    XCTAssertNil([[self keyWithSeed:2] open:envelope]);
+}
+
+- (void)testGroupEnvelopeCarriesWrappedKeyPerMember
+{
+    uint8_t material[MESSAGE_SESSION_KEY_LENGTH] = {0};
+    NSDictionary *wrappedKeys = @{@"member1" : [@"key1" dataUsingEncoding:NSUTF8StringEncoding],
+                                  @"member2" : [@"key2" dataUsingEncoding:NSUTF8StringEncoding]};
+    MessageSessionKey *groupKey = [[MessageSessionKey alloc] initWithKeyId:self.key.keyId keyMaterial:[NSData dataWithBytes:material length:sizeof(material)] wrappedKeys:wrappedKeys];
+
+    NSData *envelope = [groupKey seal:self.message];
+    NSData *table = [MessageSessionKey wrappedKeyOfEnvelope:envelope];
+
+    XCTAssertTrue(groupKey.group);
+    XCTAssertTrue([MessageSessionKey isGroupEnvelope:envelope]);
+    XCTAssertFalse([MessageSessionKey isGroupEnvelope:[self.key seal:self.message]]);
+    XCTAssertEqualObjects([MessageSessionKey wrappedKeyForRecipient:@"member1" inWrappedKeys:table], wrappedKeys[@"member1"]);
+    XCTAssertEqualObjects([MessageSessionKey wrappedKeyForRecipient:@"member2" inWrappedKeys:table], wrappedKeys[@"member2"]);
+    XCTAssertNil([MessageSessionKey wrappedKeyForRecipient:@"member3" inWrappedKeys:table]);
+    XCTAssertEqualObjects([groupKey open:envelope], self.message);
+}
+
+- (void)testTruncatedRecipientTableIsRejected
+{
+    uint8_t material[MESSAGE_SESSION_KEY_LENGTH] = {0};
+    NSDictionary *wrappedKeys = @{@"member1" : [@"key1" dataUsingEncoding:NSUTF8StringEncoding]};
+    MessageSessionKey *groupKey = [[MessageSessionKey alloc] initWithKeyId:self.key.keyId keyMaterial:[NSData dataWithBytes:material length:sizeof(material)] wrappedKeys:wrappedKeys];
+
+    NSData *table = groupKey.wrappedKey;
+    XCTAssertNil([MessageSessionKey wrappedKeyForRecipient:@"member1" inWrappedKeys:[table subdataWithRange:NSMakeRange(0, [table length] - 1)]]);
+}
+
+- (void)testEnvelopePrefix
+{
+    XCTAssertTrue([MessageEnvelope isEnvelope:[MESSAGE_ENVELOPE_PREFIX stringByAppendingString:@"AAAA"]]);
+    XCTAssertFalse([MessageEnvelope isEnvelope:@"Hello"]);
+}
+
+@end
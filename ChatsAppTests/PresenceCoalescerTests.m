@@ -0,0 +1,96 @@
+//
+//  PresenceCoalescerTests.m
+//  ChatsAppTests
+//
+//  Created by Ryan Opoku on 12/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import <SocialCommunication/SIPConstants.h>
+#import "PresenceCoalescer.h"
+
+@interface PresenceCoalescerTests : XCTestCase
+
+@property(nonatomic, strong) PresenceCoalescer *coalescer;
+@property(nonatomic, strong) NSMutableArray *batches;
+
+@end
+
+@implementation PresenceCoalescerTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.batches = [NSMutableArray array];
+    self.coalescer = [[PresenceCoalescer alloc] init];
+    self.coalescer.window = 60.;
+
+    __weak PresenceCoalescerTests *weakself = self;
+    [self.coalescer addHandler:^(NSDictionary *changes) {
+        [weakself.batches addObject:changes];
+    }];
+}
+
+- (void)testPresenceStormIsDeliveredOnce
+{
+    // 1000 friends come online at login, each reported three times
+    for (int n = 0; n < 3; n++) {
+        for (int i = 0; i < 1000; i++) {
+            [self.coalescer setOnlineStatus:OS_ONLINE forUserid:[NSString stringWithFormat:@"user%d", i]];
+        }
+    }
+    XCTAssertEqual([self.batches count], (NSUInteger) 0);
+
+    [self.coalescer flush];
+    XCTAssertEqual(self.coalescer.updateCount, (NSUInteger) 3000);
+    XCTAssertEqual(self.coalescer.deliveryCount, (NSUInteger) 1);
+    XCTAssertEqual([self.batches count], (NSUInteger) 1);
+    XCTAssertEqual([self.batches[0] count], (NSUInteger) 1000);
+    XCTAssertEqual([self.coalescer onlineStatusForUserid:@"user999"], (NSInteger) OS_ONLINE);
+}
+
+- (void)testUnchangedStatusIsNotDelivered
+{
+    [self.coalescer setOnlineStatus:OS_ONLINE forUserid:@"alice"];
+    [self.coalescer flush];
+
+    // Flap within the window and a repeated status
+    [self.coalescer setOnlineStatus:OS_OFFLINE forUserid:@"alice"];
+    [self.coalescer setOnlineStatus:OS_ONLINE forUserid:@"alice"];
+    [self.coalescer setOnlineStatus:OS_OFFLINE forUserid:@"bob"];
+    [self.coalescer flush];
+
+    XCTAssertEqual([self.batches count], (NSUInteger) 1);
+    XCTAssertEqual(self.coalescer.deliveryCount, (NSUInteger) 1);
+}
+
+- (void)testOnlyChangesAreDelivered
+{
+    [self.coalescer setOnlineStatus:OS_ONLINE forUserid:@"alice"];
+    [self.coalescer setOnlineStatus:OS_ONLINE forUserid:@"bob"];
+    [self.coalescer flush];
+
+    [self.coalescer setOnlineStatus:OS_ONLINE forUserid:@"alice"];
+    [self.coalescer setOnlineStatus:OS_AWAY forUserid:@"bob"];
+    [self.coalescer flush];
+
+    XCTAssertEqualObjects([self.batches lastObject], (@{@"bob" : @(OS_AWAY)}));
+}
+
+- (void)testRemovedHandlerIsNotCalled
+{
+    __block NSUInteger calls = 0;
+    id token = [self.coalescer addHandler:^(NSDictionary *changes) {
+        calls++;
+    }];
+    [self.coalescer removeHandler:token];
+
+    [self.coalescer setOnlineStatus:OS_ONLINE forUserid:@"alice"];
+    [self.coalescer flush];
+    XCTAssertEqual(calls, (NSUInteger) 0);
+    XCTAssertEqual([self.batches count], (NSUInteger) 1);
+}
+
+@end
@@ -0,0 +1,111 @@
+//
+//  RateTableTests.m
+//  ChatsAppTests
+//
+//  Created by Ryan Opoku on 13/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "RateTable.h"
+
+@interface RateTableTests : XCTestCase
+
+@property(nonatomic, strong) RateTable *table;
+@property(nonatomic, strong) NSString *path;
+
+@end
+
+@implementation RateTableTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    self.table = [[RateTable alloc] initWithPath:self.path];
+    self.table.countryCode = @"49";
+
+    NSString *text = @"version\t1\t\n"
+                      "49\t0.02\t0.09\n"
+                      "4915\t0.15\t0.09\n"
+                      "49151\t0.12\t\n"
+                      "1\t0.01\t0.05\n";
+    XCTAssertTrue([self.table loadData:[RateTable compressedTable:text]]);
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:self.path error:nil];
+    [super tearDown];
+}
+
+- (void)testLongestPrefix
+{
+    XCTAssertEqual(self.table.prefixCount, (NSUInteger) 4);
+    XCTAssertEqualObjects([self.table priceForNumber:@"+49 30 123456" isSMS:NO], @"0.02");
+    XCTAssertEqualObjects([self.table priceForNumber:@"+49 152 123456" isSMS:NO], @"0.15");
+    XCTAssertEqualObjects([self.table priceForNumber:@"+49 151 123456" isSMS:NO], @"0.12");
+    XCTAssertEqualObjects([self.table priceForNumber:@"+1 408 1234567" isSMS:YES], @"0.05");
+    XCTAssertNil([self.table priceForNumber:@"+44 20 123456" isSMS:NO]);
+}
+
+- (void)testSMSPriceFallsBackToShorterPrefix
+{
+    XCTAssertEqualObjects([self.table priceForNumber:@"+49 151 123456" isSMS:YES], @"0.09");
+}
+
+- (void)testNumberFormats
+{
+    XCTAssertEqualObjects([self.table priceForNumber:@"0151 123456" isSMS:NO], @"0.12");
+    XCTAssertEqualObjects([self.table priceForNumber:@"0049 (151) 123-456" isSMS:NO], @"0.12");
+
+    self.table.countryCode = nil;
+    XCTAssertNil([self.table priceForNumber:@"0151 123456" isSMS:NO]);
+}
+
+- (void)testDelta
+{
+    NSString *delta = @"version\t2\t1\n"
+                       "49151\n"
+                       "44\t0.03\t0.08\n";
+    XCTAssertTrue([self.table loadData:[RateTable compressedTable:delta]]);
+
+    XCTAssertEqualObjects(self.table.version, @"2");
+    XCTAssertEqual(self.table.prefixCount, (NSUInteger) 4);
+    XCTAssertEqualObjects([self.table priceForNumber:@"+49 151 123456" isSMS:NO], @"0.15");
+    XCTAssertEqualObjects([self.table priceForNumber:@"+44 20 123456" isSMS:NO], @"0.03");
+
+    // The same delta no longer matches the table version
+    XCTAssertFalse([self.table loadData:[RateTable compressedTable:delta]]);
+    XCTAssertFalse([self.table loadData:[@"garbage" dataUsingEncoding:NSUTF8StringEncoding]]);
+    XCTAssertEqualObjects(self.table.version, @"2");
+}
+
+- (void)testTableIsPersistent
+{
+    RateTable *reloaded = [[RateTable alloc] initWithPath:self.path];
+    XCTAssertEqualObjects(reloaded.version, @"1");
+    XCTAssertEqual(reloaded.prefixCount, (NSUInteger) 4);
+    XCTAssertEqualObjects([reloaded priceForNumber:@"+49 151 123456" isSMS:NO], @"0.12");
+}
+
+- (void)testLookupPerformance
+{
+    // 100k prefixes of 4 to 8 digits
+    NSMutableString *text = [NSMutableString stringWithString:@"version\t1\t\n"];
+    for (int i = 0; i < 100000; i++) {
+        [text appendFormat:@"%d\t0.%02d\t0.%02d\n", 1000 + i * 7919 % 99999000, i % 100, (i + 1) % 100];
+    }
+    RateTable *table = [[RateTable alloc] initWithPath:nil];
+    XCTAssertTrue([table loadData:[RateTable compressedTable:text]]);
+    XCTAssertGreaterThan(table.prefixCount, (NSUInteger) 90000);
+
+    [self measureBlock:^{
+        for (int i = 0; i < 10000; i++) {
+            [table priceForNumber:@"+49 151 1234567" isSMS:NO];
+        }
+    }];
+}
+
+@end
@@ -0,0 +1,76 @@
+//
+//  ScreenTileHasherTests.m
+//  ChatsAppTests
+//
+//  Created by Ryan Opoku on 04/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "ScreenTileHasher.h"
+
+#define IMAGE_WIDTH     100
+#define IMAGE_HEIGHT    70
+
+@interface ScreenTileHasherTests : XCTestCase {
+    uint32_t pixels[IMAGE_WIDTH * IMAGE_HEIGHT];
+}
+
+@end
+
+@implementation ScreenTileHasherTests
+
+- (void)setUp
+{
+    [super setUp];
+    for (int i = 0; i < IMAGE_WIDTH * IMAGE_HEIGHT; i++) {
+        pixels[i] = 0xff000000 | i;
+    }
+}
+
+- (int)update:(ScreenTileHasher *) hasher
+{
+    return [hasher updateWithPixels:(const uint8_t *) pixels width:IMAGE_WIDTH height:IMAGE_HEIGHT bytesPerRow:IMAGE_WIDTH * 4];
+}
+
+- (void)testFirstFrameIsFullyChanged
+{
+    ScreenTileHasher *hasher = [[ScreenTileHasher alloc] initWithTileSize:32];
+
+    XCTAssertEqual([self update:hasher], 4 * 3);
+    XCTAssertEqual(hasher.tilesPerRow, 4);
+    XCTAssertEqual(hasher.tilesPerColumn, 3);
+}
+
+- (void)testStaticFrameIsUnchanged
+{
+    ScreenTileHasher *hasher = [[ScreenTileHasher alloc] initWithTileSize:32];
+    [self update:hasher];
+
+    XCTAssertEqual([self update:hasher], 0);
+    XCTAssertFalse([hasher isTileChangedAtColumn:0 row:0]);
+}
+
+- (void)testSinglePixelChange
+{
+    ScreenTileHasher *hasher = [[ScreenTileHasher alloc] initWithTileSize:32];
+    [self update:hasher];
+
+    // Pixel in the partial tile at the bottom right
+    pixels[65 * IMAGE_WIDTH + 99] ^= 1;
+
+    XCTAssertEqual([self update:hasher], 1);
+    XCTAssertTrue([hasher isTileChangedAtColumn:3 row:2]);
+    XCTAssertFalse([hasher isTileChangedAtColumn:2 row:2]);
+}
+
+- (void)testResetReportsAllTiles
+{
+    ScreenTileHasher *hasher = [[ScreenTileHasher alloc] initWithTileSize:32];
+    [self update:hasher];
+    [hasher reset];
+
+    XCTAssertEqual([self update:hasher], 12);
+}
+
+@end
@@ -0,0 +1,184 @@
+//
+//  StoreMigratorTests.m
+//  ChatsAppTests
+//
+//  Created by Ryan Opoku on 14/06/2014.
+//  Copyright (c) 2014 Ryan Opoku. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "StoreMigrator.h"
+
+@interface StoreMigratorTests : XCTestCase
+
+@property(nonatomic, strong) StoreMigrator *migrator;
+@property(nonatomic, strong) NSURL *directory;
+
+@end
+
+@implementation StoreMigratorTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.migrator = [StoreMigrator instance];
+    self.directory = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]]];
+    [[NSFileManager defaultManager] createDirectoryAtURL:self.directory withIntermediateDirectories:YES attributes:nil error:nil];
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtURL:self.directory error:nil];
+    [super tearDown];
+}
+
+// Fixture store of an old model version with events
+-(NSURL *) storeWithModel:(NSManagedObjectModel *) model events:(NSUInteger) count
+{
+    NSURL *url = [self.directory URLByAppendingPathComponent:[[[NSUUID UUID] UUIDString] stringByAppendingPathExtension:@"sqlite"]];
+    NSPersistentStoreCoordinator *coordinator = [[NSPersistentStoreCoordinator alloc] initWithManagedObjectModel:model];
+    XCTAssertNotNil([coordinator addPersistentStoreWithType:NSSQLiteStoreType configuration:nil URL:url options:nil error:nil]);
+
+    NSManagedObjectContext *context = [[NSManagedObjectContext alloc] init];
+    context.persistentStoreCoordinator = coordinator;
+
+    NSDate *now = [NSDate date];
+    NSDictionary *attributes = [[model entitiesByName][@"MOC2CallEvent"] attributesByName];
+    for (NSUInteger i = 0; i < count; i++) {
+        NSDictionary *values = @{@"contact" : [NSString stringWithFormat:@"user%lu", (unsigned long) (i % 100)],
+                                 @"eventId" : [NSString stringWithFormat:@"event%lu", (unsigned long) i],
+                                 @"eventType" : @"MessageIn",
+                                 @"text" : @"Hello",
+                                 @"missed" : @NO,
+                                 @"missedDisplay" : @NO,
+                                 @"timeGroup" : now,
+                                 @"timeStamp" : now};
+
+        // Only the attributes of this model version
+        NSManagedObject *event = [NSEntityDescription insertNewObjectForEntityForName:@"MOC2CallEvent" inManagedObjectContext:context];
+        [values enumerateKeysAndObjectsUsingBlock:^(NSString *key, id value, BOOL *stop) {
+            if (attributes[key])
+                [event setValue:value forKey:key];
+        }];
+
+        if (i % 5000 == 4999) {
+            XCTAssertTrue([context save:nil]);
+            [context reset];
+        }
+    }
+    XCTAssertTrue([context save:nil]);
+    return url;
+}
+
+-(NSUInteger) eventCountInStoreAtURL:(NSURL *) url
+{
+    NSPersistentStoreCoordinator *coordinator = [[NSPersistentStoreCoordinator alloc] initWithManagedObjectModel:self.migrator.currentModel];
+    if (![coordinator addPersistentStoreWithType:NSSQLiteStoreType configuration:nil URL:url options:nil error:nil])
+        return NSNotFound;
+
+    NSManagedObjectContext *context = [[NSManagedObjectContext alloc] init];
+    context.persistentStoreCoordinator = coordinator;
+    return [context countForFetchRequest:[NSFetchRequest fetchRequestWithEntityName:@"MOC2CallEvent"] error:nil];
+}
+
+- (void)testModelVersions
+{
+    // All versions of the SDK model, not only those compiled by the app
+    XCTAssertEqual([self.migrator.models count], (NSUInteger) 17);
+    XCTAssertEqualObjects([[self.migrator.models lastObject] entityVersionHashesByName], self.migrator.currentModel.entityVersionHashesByName);
+}
+
+- (void)testMigratesOldVersions
+{
+    NSArray *models = self.migrator.models;
+    NSArray *versions = @[models[1], models[[models count] / 2], models[[models count] - 2]];
+
+    for (NSManagedObjectModel *model in versions) {
+        NSURL *store = [self storeWithModel:model events:100];
+        XCTAssertTrue([self.migrator requiresMigrationOfStoreAtURL:store]);
+
+        __block float lastProgress = 0.f;
+        NSError *error = nil;
+        XCTAssertTrue([self.migrator migrateStoreAtURL:store progress:^(float progress) {
+            XCTAssertGreaterThanOrEqual(progress, lastProgress);
+            lastProgress = progress;
+        } error:&error], @"%@", error);
+
+        XCTAssertEqual(lastProgress, 1.0f);
+        XCTAssertFalse([self.migrator requiresMigrationOfStoreAtURL:store]);
+        XCTAssertEqual([self eventCountInStoreAtURL:store], (NSUInteger) 100);
+    }
+}
+
+- (void)testInterruptedMigrationIsRestarted
+{
+    NSURL *store = [self storeWithModel:self.migrator.models[1] events:10];
+    NSURL *leftover = [NSURL fileURLWithPath:[[store path] stringByAppendingString:@".migrating"]];
+    [[@"partial" dataUsingEncoding:NSUTF8StringEncoding] writeToURL:leftover atomically:YES];
+
+    XCTAssertEqualObjects([self.migrator storesRequiringMigrationInDirectory:self.directory], (@[store]));
+    XCTAssertTrue([self.migrator migrateStoreAtURL:store progress:nil error:nil]);
+    XCTAssertEqual([self eventCountInStoreAtURL:store], (NSUInteger) 10);
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:[leftover path]]);
+    XCTAssertEqual([[self.migrator storesRequiringMigrationInDirectory:self.directory] count], (NSUInteger) 0);
+}
+
+- (void)testUnknownStoreIsRejected
+{
+    NSURL *store = [self.directory URLByAppendingPathComponent:@"unknown.sqlite"];
+    [[@"not a store" dataUsingEncoding:NSUTF8StringEncoding] writeToURL:store atomically:YES];
+
+    NSError *error = nil;
+    XCTAssertFalse([self.migrator migrateStoreAtURL:store progress:nil error:&error]);
+    XCTAssertEqualObjects(error.domain, StoreMigratorErrorDomain);
+    XCTAssertEqual([[self.migrator storesRequiringMigrationInDirectory:self.directory] count], (NSUInteger) 0);
+}
+
+- (void)testLargeStoresAreMigratedInBackground
+{
+    NSURL *store = [self storeWithModel:self.migrator.models[1] events:100];
+    unsigned long long size = [self.migrator sizeOfStores:@[store]];
+    XCTAssertGreaterThan(size, 0ull);
+
+    StoreMigrator *migrator = [[StoreMigrator alloc] initWithModelURL:[StoreMigrator modelURL]];
+    migrator.synchronousMigrationLimit = size - 1;
+    XCTAssertFalse([migrator canMigrateStoresSynchronously:@[store]]);
+    XCTAssertTrue([migrator canMigrateStoresSynchronously:@[]]);
+
+    __block float lastProgress = 0.f;
+    __block BOOL completed = NO, migrated = NO;
+    [migrator migrateStoresInBackground:@[store] progress:^(float progress) {
+        XCTAssertTrue([NSThread isMainThread]);
+        lastProgress = progress;
+    } completion:^(BOOL success) {
+        XCTAssertTrue([NSThread isMainThread]);
+        completed = YES;
+        migrated = success;
+    }];
+
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:10];
+    while (!completed && [timeout timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+    }
+
+    XCTAssertTrue(migrated);
+    XCTAssertEqual(lastProgress, 1.0f);
+    XCTAssertEqual([self eventCountInStoreAtURL:store], (NSUInteger) 100);
+}
+
+- (void)testMigrationPerformance
+{
+    // 100k events from the oldest migratable version, the fixture is created outside the measurement
+    [self measureMetrics:[[self class] defaultPerformanceMetrics] automaticallyStartMeasuring:NO forBlock:^{
+        NSURL *store = [self storeWithModel:self.migrator.models[1] events:100000];
+
+        [self startMeasuring];
+        XCTAssertTrue([self.migrator migrateStoreAtURL:store progress:nil error:nil]);
+        [self stopMeasuring];
+
+        XCTAssertEqual([self eventCountInStoreAtURL:store], (NSUInteger) 100000);
+    }];
+}
+
+@end